@@ -0,0 +1,496 @@
+/**
+ * @file  shared_ptr_bench.cpp
+ * @brief Benchmark of this shared_ptr and unique_ptr minimal implementation against std (and boost) using Google Benchmark.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include "shared_ptr.hpp"
+#include "compact_shared_ptr.hpp"
+#ifdef SHARED_PTR_THREAD_SAFE
+#include "atomic_shared_ptr.hpp"
+#endif
+#include "object_pool.hpp"
+#include "unique_ptr.hpp"
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+
+#ifdef SHARED_PTR_BENCH_BOOST
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#endif
+
+#include <benchmark/benchmark.h>
+
+/// Number of pointers in the containers
+static const int NB_PTRS = 1000;
+
+struct Base
+{
+    explicit Base(int aVal = 0) :
+        mVal(aVal)
+    {
+    }
+    virtual ~Base(void)
+    {
+    }
+
+    int mVal;
+};
+
+struct Derived : public Base
+{
+    explicit Derived(int aVal = 0) :
+        Base(aVal)
+    {
+    }
+};
+
+// compare the pointed values, for sorting the containers
+template<class Ptr>
+static bool less_value(const Ptr& aLeft, const Ptr& aRight)
+{
+    return (aLeft->mVal < aRight->mVal);
+}
+
+// pseudo-random values, so that sorting has to move the pointers around
+static int value(int aIndex)
+{
+    return static_cast<int>((static_cast<unsigned>(aIndex) * 2654435761u) % 1000003u);
+}
+
+
+/// This minimal shared_ptr
+struct Minimal
+{
+    template<class T> struct ptr { typedef ::shared_ptr<T> type; };
+
+    template<class T>
+    static ::shared_ptr<T> make(int aVal)
+    {
+        return ::make_shared<T>(aVal);
+    }
+    template<class T, class U>
+    static ::shared_ptr<T> static_cast_ptr(const ::shared_ptr<U>& aPtr)
+    {
+        return ::static_pointer_cast<T>(aPtr);
+    }
+    template<class T, class U>
+    static ::shared_ptr<T> dynamic_cast_ptr(const ::shared_ptr<U>& aPtr)
+    {
+        return ::dynamic_pointer_cast<T>(aPtr);
+    }
+};
+
+/// The single word compact_shared_ptr (no cast)
+struct Compact
+{
+    template<class T> struct ptr { typedef ::compact_shared_ptr<T> type; };
+
+    template<class T>
+    static ::compact_shared_ptr<T> make(int aVal)
+    {
+        return ::make_compact_shared<T>(aVal);
+    }
+};
+
+/// The C++11 std::shared_ptr
+struct Std
+{
+    template<class T> struct ptr { typedef std::shared_ptr<T> type; };
+
+    template<class T>
+    static std::shared_ptr<T> make(int aVal)
+    {
+        return std::make_shared<T>(aVal);
+    }
+    template<class T, class U>
+    static std::shared_ptr<T> static_cast_ptr(const std::shared_ptr<U>& aPtr)
+    {
+        return std::static_pointer_cast<T>(aPtr);
+    }
+    template<class T, class U>
+    static std::shared_ptr<T> dynamic_cast_ptr(const std::shared_ptr<U>& aPtr)
+    {
+        return std::dynamic_pointer_cast<T>(aPtr);
+    }
+};
+
+#ifdef SHARED_PTR_BENCH_BOOST
+/// The boost::shared_ptr
+struct Boost
+{
+    template<class T> struct ptr { typedef boost::shared_ptr<T> type; };
+
+    template<class T>
+    static boost::shared_ptr<T> make(int aVal)
+    {
+        return boost::make_shared<T>(aVal);
+    }
+    template<class T, class U>
+    static boost::shared_ptr<T> static_cast_ptr(const boost::shared_ptr<U>& aPtr)
+    {
+        return boost::static_pointer_cast<T>(aPtr);
+    }
+    template<class T, class U>
+    static boost::shared_ptr<T> dynamic_cast_ptr(const boost::shared_ptr<U>& aPtr)
+    {
+        return boost::dynamic_pointer_cast<T>(aPtr);
+    }
+};
+#endif
+
+
+// shared pointers
+
+template<class Impl>
+static void shared_new(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        typename Impl::template ptr<Base>::type ptr(new Base(1));
+        benchmark::DoNotOptimize(ptr.get());
+    }
+}
+
+template<class Impl>
+static void shared_make(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        typename Impl::template ptr<Base>::type ptr = Impl::template make<Base>(1);
+        benchmark::DoNotOptimize(ptr.get());
+    }
+}
+
+template<class Impl>
+static void shared_copy(benchmark::State& state)
+{
+    const typename Impl::template ptr<Base>::type ptr = Impl::template make<Base>(1);
+    for (auto _ : state)
+    {
+        typename Impl::template ptr<Base>::type copy(ptr);
+        benchmark::DoNotOptimize(copy.get());
+    }
+}
+
+template<class Impl>
+static void shared_assign(benchmark::State& state)
+{
+    const typename Impl::template ptr<Base>::type ptr1 = Impl::template make<Base>(1);
+    const typename Impl::template ptr<Base>::type ptr2 = Impl::template make<Base>(2);
+    typename Impl::template ptr<Base>::type copy;
+    for (auto _ : state)
+    {
+        copy = ptr1;
+        benchmark::DoNotOptimize(copy.get());
+        copy = ptr2;
+        benchmark::DoNotOptimize(copy.get());
+    }
+}
+
+template<class Impl>
+static void shared_reset(benchmark::State& state)
+{
+    typename Impl::template ptr<Base>::type ptr;
+    for (auto _ : state)
+    {
+        ptr.reset(new Base(1));
+        benchmark::DoNotOptimize(ptr.get());
+        ptr.reset();
+    }
+}
+
+template<class Impl>
+static void shared_use_count(benchmark::State& state)
+{
+    const typename Impl::template ptr<Base>::type ptr = Impl::template make<Base>(1);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(ptr.use_count());
+    }
+}
+
+template<class Impl>
+static void shared_static_cast(benchmark::State& state)
+{
+    const typename Impl::template ptr<Derived>::type ptr = Impl::template make<Derived>(1);
+    for (auto _ : state)
+    {
+        typename Impl::template ptr<Base>::type base = Impl::template static_cast_ptr<Base>(ptr);
+        benchmark::DoNotOptimize(base.get());
+    }
+}
+
+template<class Impl>
+static void shared_dynamic_cast(benchmark::State& state)
+{
+    const typename Impl::template ptr<Base>::type ptr = Impl::template make<Derived>(1);
+    for (auto _ : state)
+    {
+        typename Impl::template ptr<Derived>::type derived = Impl::template dynamic_cast_ptr<Derived>(ptr);
+        benchmark::DoNotOptimize(derived.get());
+    }
+}
+
+template<class Impl>
+static void shared_push_back(benchmark::State& state)
+{
+    const typename Impl::template ptr<Base>::type ptr = Impl::template make<Base>(1);
+    for (auto _ : state)
+    {
+        std::vector<typename Impl::template ptr<Base>::type> ptrs;
+        for (int i = 0; i < NB_PTRS; ++i)
+        {
+            ptrs.push_back(ptr);
+        }
+        benchmark::DoNotOptimize(ptrs.data());
+    }
+    state.SetItemsProcessed(state.iterations() * NB_PTRS);
+}
+
+template<class Impl>
+static void shared_sort(benchmark::State& state)
+{
+    std::vector<typename Impl::template ptr<Base>::type> ptrs;
+    for (int i = 0; i < NB_PTRS; ++i)
+    {
+        ptrs.push_back(Impl::template make<Base>(value(i)));
+    }
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        std::vector<typename Impl::template ptr<Base>::type> sorted(ptrs);
+        state.ResumeTiming();
+        std::sort(sorted.begin(), sorted.end(), less_value<typename Impl::template ptr<Base>::type>);
+        benchmark::DoNotOptimize(sorted.data());
+    }
+    state.SetItemsProcessed(state.iterations() * NB_PTRS);
+}
+
+/// Each thread copies its own pointer (valid without thread-safe reference counting)
+template<class Impl>
+static void shared_copy_local(benchmark::State& state)
+{
+    const typename Impl::template ptr<Base>::type ptr = Impl::template make<Base>(1);
+    for (auto _ : state)
+    {
+        typename Impl::template ptr<Base>::type copy(ptr);
+        benchmark::DoNotOptimize(copy.get());
+    }
+}
+
+/// Acquire an object from an object_pool, recycling its node on release, compared to shared_make
+static void shared_pool_acquire(benchmark::State& state)
+{
+    object_pool<Base> pool;
+    for (auto _ : state)
+    {
+        ::shared_ptr<Base> ptr = pool.acquire(1);
+        benchmark::DoNotOptimize(ptr.get());
+    }
+}
+BENCHMARK(shared_pool_acquire);
+
+/// Fan a message out to NB_PTRS subscribers and drain them, one copy at a time, compared to shared_push_back
+static void shared_fan_out(benchmark::State& state)
+{
+    const ::shared_ptr<Base> ptr = ::make_shared<Base>(1);
+    std::vector< ::shared_ptr<Base> > ptrs;
+    ptrs.reserve(NB_PTRS);
+    for (auto _ : state)
+    {
+        for (int i = 0; i < NB_PTRS; ++i)
+        {
+            ptrs.push_back(ptr);
+        }
+        benchmark::DoNotOptimize(ptrs.data());
+        ptrs.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * NB_PTRS);
+}
+BENCHMARK(shared_fan_out);
+
+/// Fan a message out to NB_PTRS subscribers and drain them with a single update of the reference counter each way
+static void shared_fan_out_bulk(benchmark::State& state)
+{
+    const ::shared_ptr<Base> ptr = ::make_shared<Base>(1);
+    std::vector< ::shared_ptr<Base> > ptrs;
+    ptrs.reserve(NB_PTRS);
+    for (auto _ : state)
+    {
+        ::share_n(ptr, NB_PTRS, std::back_inserter(ptrs));
+        benchmark::DoNotOptimize(ptrs.data());
+        ::release_all(ptrs);
+        ptrs.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * NB_PTRS);
+}
+BENCHMARK(shared_fan_out_bulk);
+
+#define SHARED_PTR_BENCHMARKS(Impl)                                             \
+    BENCHMARK_TEMPLATE(shared_new,          Impl);                              \
+    BENCHMARK_TEMPLATE(shared_make,         Impl);                              \
+    BENCHMARK_TEMPLATE(shared_copy,         Impl);                              \
+    BENCHMARK_TEMPLATE(shared_assign,       Impl);                              \
+    BENCHMARK_TEMPLATE(shared_reset,        Impl);                              \
+    BENCHMARK_TEMPLATE(shared_use_count,    Impl);                              \
+    BENCHMARK_TEMPLATE(shared_static_cast,  Impl);                              \
+    BENCHMARK_TEMPLATE(shared_dynamic_cast, Impl);                              \
+    BENCHMARK_TEMPLATE(shared_push_back,    Impl);                              \
+    BENCHMARK_TEMPLATE(shared_sort,         Impl);                              \
+    BENCHMARK_TEMPLATE(shared_copy_local,   Impl)->ThreadRange(1, 8)->UseRealTime()
+
+SHARED_PTR_BENCHMARKS(Minimal);
+SHARED_PTR_BENCHMARKS(Std);
+BENCHMARK_TEMPLATE(shared_make,         Compact);
+BENCHMARK_TEMPLATE(shared_copy,         Compact);
+BENCHMARK_TEMPLATE(shared_assign,       Compact);
+BENCHMARK_TEMPLATE(shared_use_count,    Compact);
+BENCHMARK_TEMPLATE(shared_push_back,    Compact);
+BENCHMARK_TEMPLATE(shared_sort,         Compact);
+#ifdef SHARED_PTR_BENCH_BOOST
+SHARED_PTR_BENCHMARKS(Boost);
+#endif
+
+#ifdef SHARED_PTR_THREAD_SAFE
+/// All the threads copy the same pointer, thus sharing the same reference counter
+template<class Impl>
+static void shared_copy_shared(benchmark::State& state)
+{
+    static typename Impl::template ptr<Base>::type ptr;
+    if (0 == state.thread_index())
+    {
+        ptr = Impl::template make<Base>(1);
+    }
+    for (auto _ : state)
+    {
+        typename Impl::template ptr<Base>::type copy(ptr);
+        benchmark::DoNotOptimize(copy.get());
+    }
+    if (0 == state.thread_index())
+    {
+        ptr.reset();
+    }
+}
+BENCHMARK_TEMPLATE(shared_copy_shared, Minimal)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(shared_copy_shared, Std)->ThreadRange(1, 8)->UseRealTime();
+#ifdef SHARED_PTR_BENCH_BOOST
+BENCHMARK_TEMPLATE(shared_copy_shared, Boost)->ThreadRange(1, 8)->UseRealTime();
+#endif
+
+/// All the threads load a snapshot from the same atomic_shared_ptr
+static void atomic_load_minimal(benchmark::State& state)
+{
+    static atomic_shared_ptr<Base> ptr(::make_shared<Base>(1));
+    for (auto _ : state)
+    {
+        const ::shared_ptr<Base> snapshot = ptr.load();
+        benchmark::DoNotOptimize(snapshot.get());
+    }
+}
+/// All the threads load a snapshot from the same std::shared_ptr with the std::atomic_load() free function
+static void atomic_load_std(benchmark::State& state)
+{
+    static std::shared_ptr<Base> ptr(std::make_shared<Base>(1));
+    for (auto _ : state)
+    {
+        const std::shared_ptr<Base> snapshot = std::atomic_load(&ptr);
+        benchmark::DoNotOptimize(snapshot.get());
+    }
+}
+BENCHMARK(atomic_load_minimal)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(atomic_load_std)->ThreadRange(1, 8)->UseRealTime();
+#endif // SHARED_PTR_THREAD_SAFE
+
+
+// unique pointers
+
+template<class Ptr>
+static void unique_new(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        Ptr ptr(new Base(1));
+        benchmark::DoNotOptimize(ptr.get());
+    }
+}
+
+template<class Ptr>
+static void unique_move(benchmark::State& state)
+{
+    Ptr ptr(new Base(1));
+    for (auto _ : state)
+    {
+        Ptr moved(std::move(ptr));
+        benchmark::DoNotOptimize(moved.get());
+        ptr = std::move(moved);
+    }
+}
+
+template<class Ptr>
+static void unique_reset(benchmark::State& state)
+{
+    Ptr ptr;
+    for (auto _ : state)
+    {
+        ptr.reset(new Base(1));
+        benchmark::DoNotOptimize(ptr.get());
+        ptr.reset();
+    }
+}
+
+template<class Ptr>
+static void unique_push_back(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        std::vector<Ptr> ptrs;
+        for (int i = 0; i < NB_PTRS; ++i)
+        {
+            ptrs.push_back(Ptr(new Base(i)));
+        }
+        benchmark::DoNotOptimize(ptrs.data());
+    }
+    state.SetItemsProcessed(state.iterations() * NB_PTRS);
+}
+
+template<class Ptr>
+static void unique_sort(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        std::vector<Ptr> ptrs;
+        for (int i = 0; i < NB_PTRS; ++i)
+        {
+            ptrs.push_back(Ptr(new Base(value(i))));
+        }
+        state.ResumeTiming();
+        std::sort(ptrs.begin(), ptrs.end(), less_value<Ptr>);
+        benchmark::DoNotOptimize(ptrs.data());
+        state.PauseTiming();
+        ptrs.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * NB_PTRS);
+}
+
+#define UNIQUE_PTR_BENCHMARKS(Ptr)                                              \
+    BENCHMARK_TEMPLATE(unique_new,          Ptr);                               \
+    BENCHMARK_TEMPLATE(unique_move,         Ptr);                               \
+    BENCHMARK_TEMPLATE(unique_reset,        Ptr);                               \
+    BENCHMARK_TEMPLATE(unique_push_back,    Ptr);                               \
+    BENCHMARK_TEMPLATE(unique_sort,         Ptr);                               \
+    BENCHMARK_TEMPLATE(unique_new,          Ptr)->ThreadRange(1, 8)->UseRealTime()
+
+UNIQUE_PTR_BENCHMARKS(unique_ptr<Base>);
+UNIQUE_PTR_BENCHMARKS(std::unique_ptr<Base>);
+
+BENCHMARK_MAIN();
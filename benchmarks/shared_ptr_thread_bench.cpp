@@ -0,0 +1,374 @@
+/**
+ * @file  shared_ptr_thread_bench.cpp
+ * @brief Multi-threaded stress and scaling benchmark of the reference counting of shared_ptr against std using Google Benchmark.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#ifndef SHARED_PTR_THREAD_SAFE
+#error "this benchmark must be compiled with SHARED_PTR_THREAD_SAFE defined"
+#endif
+
+#include "shared_ptr.hpp"
+#include "reclamation_domain.hpp"
+
+#include <atomic>
+#include <cstddef>      // std::size_t
+#include <memory>
+#include <new>          // std::bad_alloc
+
+#include <benchmark/benchmark.h>
+
+/// Maximum number of threads of the scaling benchmarks
+static const int MAX_THREADS = 16;
+/// Size of a cache line (and twice it, to defeat the adjacent line prefetcher)
+static const std::size_t CACHE_LINE = 64;
+
+struct Base
+{
+    explicit Base(int aVal = 0) :
+        mVal(aVal)
+    {
+    }
+    virtual ~Base(void)
+    {
+    }
+
+    int mVal;
+};
+
+
+/**
+ * @brief arena placing the control blocks of the different threads next to each other, or on their own cache lines.
+ *
+ * The blocks are never freed: the arena is rewound once all the threads are done with them.
+ */
+class arena
+{
+public:
+    /// @brief reserve the next block, aligned on the provided boundary
+    static void* allocate(std::size_t aSize, std::size_t aAlignment) // may throw std::bad_alloc
+    {
+        const std::size_t size = (aSize + aAlignment - 1) & ~(aAlignment - 1);
+        const std::size_t offset = next().fetch_add(size, std::memory_order_relaxed);
+        if (offset + size > sizeof(buffer().bytes))
+        {
+            throw std::bad_alloc();
+        }
+        return buffer().bytes + offset;
+    }
+    /// @brief start again from the beginning of the arena (no block shall be used anymore)
+    static void rewind(void) noexcept // never throws
+    {
+        next().store(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct storage
+    {
+        alignas(2 * CACHE_LINE) char bytes[MAX_THREADS * 4 * CACHE_LINE];
+    };
+    static storage& buffer(void) noexcept // never throws
+    {
+        static storage bytes;
+        return bytes;
+    }
+    static std::atomic<std::size_t>& next(void) noexcept // never throws
+    {
+        static std::atomic<std::size_t> offset(0);
+        return offset;
+    }
+};
+
+/// Allocator of the control blocks in the arena, packed at 16 bytes boundaries, or padded to Alignment
+template<class T, std::size_t Alignment>
+struct arena_allocator
+{
+    typedef T value_type;
+    template<class U> struct rebind { typedef arena_allocator<U, Alignment> other; };
+
+    arena_allocator(void) noexcept // never throws
+    {
+    }
+    template<class U>
+    arena_allocator(const arena_allocator<U, Alignment>&) noexcept // never throws
+    {
+    }
+    T* allocate(std::size_t n) // may throw std::bad_alloc
+    {
+        return static_cast<T*>(arena::allocate(n * sizeof(T), Alignment));
+    }
+    void deallocate(T*, std::size_t) noexcept // never throws
+    {
+    }
+    template<class U>
+    bool operator==(const arena_allocator<U, Alignment>&) const noexcept // never throws
+    {
+        return true;
+    }
+    template<class U>
+    bool operator!=(const arena_allocator<U, Alignment>&) const noexcept // never throws
+    {
+        return false;
+    }
+};
+
+/// Counters of each thread next to the ones of the other threads, sharing their cache lines
+struct Packed
+{
+    static const std::size_t alignment = 16;
+};
+/// Counters of each thread on their own pair of cache lines
+struct Padded
+{
+    static const std::size_t alignment = 2 * CACHE_LINE;
+};
+
+
+/// This minimal shared_ptr, with atomic (or biased) reference counting
+struct Minimal
+{
+    template<class T> struct ptr { typedef ::shared_ptr<T> type; };
+    template<class T> struct weak { typedef ::weak_ptr<T> type; };
+
+    template<class T>
+    static ::shared_ptr<T> make(int aVal)
+    {
+        return ::make_shared<T>(aVal);
+    }
+    template<class T, class A>
+    static ::shared_ptr<T> allocate(const A& aAlloc, int aVal)
+    {
+        return ::allocate_shared<T>(aAlloc, aVal);
+    }
+};
+
+/// This minimal shared_ptr with the single_threaded policy, only valid for the objects copied by a single thread
+struct MinimalLocal
+{
+    template<class T> struct ptr { typedef ::shared_ptr<T, single_threaded> type; };
+
+    template<class T, class A>
+    static ::shared_ptr<T, single_threaded> allocate(const A& aAlloc, int aVal)
+    {
+        return ::shared_ptr<T, single_threaded>(::allocate_shared<T>(aAlloc, aVal));
+    }
+};
+
+/// The C++11 std::shared_ptr
+struct Std
+{
+    template<class T> struct ptr { typedef std::shared_ptr<T> type; };
+    template<class T> struct weak { typedef std::weak_ptr<T> type; };
+
+    template<class T>
+    static std::shared_ptr<T> make(int aVal)
+    {
+        return std::make_shared<T>(aVal);
+    }
+    template<class T, class A>
+    static std::shared_ptr<T> allocate(const A& aAlloc, int aVal)
+    {
+        return std::allocate_shared<T>(aAlloc, aVal);
+    }
+};
+
+
+/// @brief report the total number of operations per second, and the mean number per thread (thus per core)
+static void report_ops(benchmark::State& state, int aOpsPerIteration)
+{
+    const double ops = static_cast<double>(state.iterations() * aOpsPerIteration);
+    state.SetItemsProcessed(state.iterations() * aOpsPerIteration);
+    state.counters["ops_per_core"] = benchmark::Counter(ops, benchmark::Counter::kIsRate | benchmark::Counter::kAvgThreads);
+}
+
+/// All the threads copy and drop the same pointer, thus sharing the same reference counter
+template<class Impl>
+static void copy_drop_shared(benchmark::State& state)
+{
+    static typename Impl::template ptr<Base>::type ptr;
+    if (0 == state.thread_index())
+    {
+        ptr = Impl::template make<Base>(1);
+    }
+    for (auto _ : state)
+    {
+        typename Impl::template ptr<Base>::type copy(ptr);
+        benchmark::DoNotOptimize(copy.get());
+    }
+    report_ops(state, 2);
+    if (0 == state.thread_index())
+    {
+        ptr.reset();
+    }
+}
+
+/// Each thread copies and drops its own pointer, the counters of the threads being packed or padded in the arena
+template<class Impl, class Layout>
+static void copy_drop_local(benchmark::State& state)
+{
+    {
+        const typename Impl::template ptr<Base>::type ptr = Impl::template allocate<Base>(arena_allocator<Base, Layout::alignment>(), 1);
+        for (auto _ : state)
+        {
+            typename Impl::template ptr<Base>::type copy(ptr);
+            benchmark::DoNotOptimize(copy.get());
+        }
+        report_ops(state, 2);
+    }
+    // all the threads have left the benchmark loop, thus are not creating blocks anymore
+    if (0 == state.thread_index())
+    {
+        arena::rewind();
+    }
+}
+
+/// The even threads lock a weak_ptr while the odd ones copy and drop the same object, racing on its reference counter
+template<class Impl>
+static void weak_lock_shared(benchmark::State& state)
+{
+    static typename Impl::template ptr<Base>::type ptr;
+    static typename Impl::template weak<Base>::type weak;
+    if (0 == state.thread_index())
+    {
+        ptr = Impl::template make<Base>(1);
+        weak = ptr;
+    }
+    if (0 == (state.thread_index() % 2))
+    {
+        for (auto _ : state)
+        {
+            const typename Impl::template ptr<Base>::type locked = weak.lock();
+            benchmark::DoNotOptimize(locked.get());
+        }
+    }
+    else
+    {
+        for (auto _ : state)
+        {
+            typename Impl::template ptr<Base>::type copy(ptr);
+            benchmark::DoNotOptimize(copy.get());
+        }
+    }
+    report_ops(state, 2);
+    if (0 == state.thread_index())
+    {
+        weak.reset();
+        ptr.reset();
+    }
+}
+
+/// Each thread creates objects, locks them through a weak_ptr, then fails to lock them once expired (the weak counter outliving the object)
+template<class Impl>
+static void weak_lock_expire(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        typename Impl::template weak<Base>::type weak;
+        {
+            const typename Impl::template ptr<Base>::type ptr = Impl::template make<Base>(1);
+            weak = ptr;
+            const typename Impl::template ptr<Base>::type locked = weak.lock();
+            benchmark::DoNotOptimize(locked.get());
+        }
+        const typename Impl::template ptr<Base>::type expired = weak.lock();
+        benchmark::DoNotOptimize(expired.get());
+    }
+    report_ops(state, 1);
+}
+
+/// The even threads read the object while the odd ones copy and drop it, the counters sharing its cache line or not
+template<class Layout>
+static void read_while_copied(benchmark::State& state)
+{
+    static ::shared_ptr<Base> ptr;
+    if (0 == state.thread_index())
+    {
+        ptr = ::allocate_shared_layout<Base, Layout>(std::allocator<Base>(), 1);
+    }
+    if (0 == (state.thread_index() % 2))
+    {
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(ptr->mVal);
+            benchmark::ClobberMemory();
+        }
+    }
+    else
+    {
+        for (auto _ : state)
+        {
+            ::shared_ptr<Base> copy(ptr);
+            benchmark::DoNotOptimize(copy.get());
+        }
+    }
+    report_ops(state, 1);
+    if (0 == state.thread_index())
+    {
+        ptr.reset();
+    }
+}
+
+/// All the threads read the same object, holding it by a copy of its shared_ptr (sharing its reference counter)
+static void read_shared_copy(benchmark::State& state)
+{
+    static ::shared_ptr<Base> ptr;
+    if (0 == state.thread_index())
+    {
+        ptr = ::make_shared<Base>(1);
+    }
+    for (auto _ : state)
+    {
+        const ::shared_ptr<Base> copy(ptr);
+        benchmark::DoNotOptimize(copy->mVal);
+    }
+    report_ops(state, 1);
+    if (0 == state.thread_index())
+    {
+        ptr.reset();
+    }
+}
+
+/// All the threads read the same object, holding it by a guarded_ptr (pinning their own epoch, without reference counting)
+static void read_guarded(benchmark::State& state)
+{
+    static ::shared_ptr<Base> ptr;
+    static std::atomic<Base*> published(NULL);
+    if (0 == state.thread_index())
+    {
+        ptr = ::make_shared<Base>(1);
+        published.store(ptr.get());
+    }
+    for (auto _ : state)
+    {
+        const guarded_ptr<Base> guarded(published);
+        benchmark::DoNotOptimize(guarded->mVal);
+    }
+    report_ops(state, 1);
+    if (0 == state.thread_index())
+    {
+        published.store(NULL);
+        reclamation_domain::retire(ptr);
+    }
+}
+
+#define SHARED_PTR_THREAD_BENCHMARKS(Impl)                                                                  \
+    BENCHMARK_TEMPLATE(copy_drop_shared, Impl)->ThreadRange(1, MAX_THREADS)->UseRealTime();                 \
+    BENCHMARK_TEMPLATE(copy_drop_local,  Impl, Packed)->ThreadRange(1, MAX_THREADS)->UseRealTime();         \
+    BENCHMARK_TEMPLATE(copy_drop_local,  Impl, Padded)->ThreadRange(1, MAX_THREADS)->UseRealTime();         \
+    BENCHMARK_TEMPLATE(weak_lock_shared, Impl)->ThreadRange(1, MAX_THREADS)->UseRealTime();                 \
+    BENCHMARK_TEMPLATE(weak_lock_expire, Impl)->ThreadRange(1, MAX_THREADS)->UseRealTime()
+
+SHARED_PTR_THREAD_BENCHMARKS(Minimal);
+SHARED_PTR_THREAD_BENCHMARKS(Std);
+BENCHMARK_TEMPLATE(copy_drop_local, MinimalLocal, Packed)->ThreadRange(1, MAX_THREADS)->UseRealTime();
+BENCHMARK_TEMPLATE(copy_drop_local, MinimalLocal, Padded)->ThreadRange(1, MAX_THREADS)->UseRealTime();
+BENCHMARK_TEMPLATE(read_while_copied, packed_layout)->ThreadRange(2, MAX_THREADS)->UseRealTime();
+BENCHMARK_TEMPLATE(read_while_copied, padded_layout)->ThreadRange(2, MAX_THREADS)->UseRealTime();
+BENCHMARK(read_shared_copy)->ThreadRange(1, MAX_THREADS)->UseRealTime();
+BENCHMARK(read_guarded)->ThreadRange(1, MAX_THREADS)->UseRealTime();
+
+BENCHMARK_MAIN();
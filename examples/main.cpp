@@ -16,17 +16,21 @@
 #include "shared_ptr.hpp"
 #include "unique_ptr.hpp"
 
+#ifdef SHARED_PTR_CPP11
+using std::move; // else unique_ptr.hpp provides a fake move() for older compilers
+#endif
+
 class Xxx
 {
 public:
     explicit Xxx(size_t len = 0) :
         size(len),
-        buffer(NULL)
+        buffer()
     {
         if (0 < size)
         {
-            buffer = new char[len];
-            memset(buffer, 0, size);
+            buffer.reset(new char[len]); // deleted with delete[] by the unique_ptr<char[]>
+            memset(buffer.get(), 0, size);
             std::cout << "new buffer(" << size << ")\n";
         }
     };
@@ -34,7 +38,6 @@ public:
     {
         if (0 < size)
         {
-            delete [] buffer;
             std::cout << "delete buffer(" << size << ")\n";
         }
     }
@@ -42,7 +45,7 @@ public:
     {
         if (0 < size)
         {
-            memset(buffer, 'x', size);
+            memset(buffer.get(), 'x', size);
             std::cout << "doSomething buffer(" << size << ")\n";
         }
     };
@@ -52,8 +55,8 @@ private:
     Xxx& operator=(Xxx&);
 
 private:
-    size_t  size;
-    char*   buffer;
+    size_t              size;
+    unique_ptr<char[]>  buffer;
 };
 
 void shared_ptr_test(void)
@@ -145,19 +148,20 @@ void unique_ptr_test(void)
             abort(); // impossible
         }
 
-        // Transfer ownership by making a copy of the unique_ptr
+        // Transfer ownership by moving the unique_ptr
         xPtr = move(yPtr);
         std::cout << "xPtr=" << xPtr.get() << std::endl;
         std::cout << "yPtr=" << yPtr.get() << std::endl;
 
         std::vector<unique_ptr<Xxx> > PtrVec;
-        PtrVec.push_back(xPtr);
+        PtrVec.push_back(move(xPtr)); // Transfer ownership to the vector
         std::cout << "xPtr=" << xPtr.get() << std::endl;
 
-    } // yPtr is destroyed, but xPtr retains the ownership of the object
+    } // PtrVec is destroyed, thus the object it owns is destroyed
 
     std::cout << "xPtr=" << xPtr.get() << std::endl;
 
+    xPtr.reset(new Xxx(512));
     {
         std::vector<unique_ptr<Xxx> > PtrList;
         PtrList.push_back(move(xPtr)); // Transfer ownership to the vector
@@ -165,7 +169,7 @@ void unique_ptr_test(void)
         std::cout << "PtrList.back=" << PtrList.back().get() << std::endl;
         std::cout << "xPtr=" << xPtr.get() << std::endl;
 
-        xPtr = PtrList.back(); // Get back ownership from the vector
+        xPtr = move(PtrList.back()); // Get back ownership from the vector
 
         std::cout << "xPtr=" << xPtr.get() << std::endl;
     }
@@ -178,11 +182,35 @@ void unique_ptr_test(void)
     //xPtr.reset();
 } // xPtr is destroyed, thus the object is destroyed and the memory freed
 
+void shared_array_test(void)
+{
+    std::cout << "shared_array_test: in\n";
+
+    // Create a buffer of 1024 bytes, allocated with its reference counter in a single memory block
+    shared_ptr<char[]> xPtr = make_shared<char[]>(1024);
+    std::cout << "xPtr=" << static_cast<void*>(xPtr.get()) << std::endl;
+    memset(xPtr.get(), 'x', 1024);
+    xPtr[1023] = '\0';
+
+    // Share the buffer
+    std::vector<shared_ptr<char[]> > PtrVec;
+    PtrVec.push_back(xPtr);
+    std::cout << "PtrVec.back=" << static_cast<void*>(PtrVec.back().get()) << " use_count=" << xPtr.use_count() << std::endl;
+
+    // Manage an array allocated with new[], deleted with delete[]
+    shared_ptr<Xxx[]> yPtr(new Xxx[2]);
+    yPtr[0].doSomething();
+
+    std::cout << "shared_array_test: out\n";
+} // the Xxx array is deleted with delete[], and the buffer is destroyed with its reference counter
+
 int main(void)
 {
     shared_ptr_test();
     std::cout << std::endl;
     unique_ptr_test();
+    std::cout << std::endl;
+    shared_array_test();
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,204 @@
+/**
+ * @file  atomic_count.hpp
+ * @brief atomic_count is the atomic reference counter used by the thread-safe smart pointers (SHARED_PTR_THREAD_SAFE).
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+// detect a C++11 compiler (MSVC does not report its real __cplusplus value by default)
+#if !defined(SHARED_PTR_CPP11) && ((__cplusplus >= 201103L) || (defined(_MSC_VER) && (_MSC_VER >= 1900)))
+#define SHARED_PTR_CPP11
+#endif
+
+// noexcept and constexpr with a C++11 compiler, fallback to a dynamic exception specification on older compilers
+#ifndef SHARED_NOEXCEPT
+#ifdef SHARED_PTR_CPP11
+#define SHARED_NOEXCEPT     noexcept
+#define SHARED_CONSTEXPR    constexpr
+#else
+#define SHARED_NOEXCEPT     throw()
+#define SHARED_CONSTEXPR
+#endif
+#endif
+
+// GCC and Clang __atomic builtins operate on a plain long, that the single_threaded policy can update like any other variable
+#if defined(__GNUC__) && defined(__ATOMIC_RELAXED)
+#define SHARED_PTR_ATOMIC_BUILTINS
+#elif defined(SHARED_PTR_CPP11)
+#include <atomic>
+#elif defined(_MSC_VER)
+#include <intrin.h>     // _InterlockedIncrement, _InterlockedDecrement, _InterlockedExchangeAdd, _InterlockedCompareExchange
+#elif !defined(__GNUC__)
+#error "atomic_count requires C++11 <atomic> or GCC/Clang/MSVC atomic intrinsics"
+#endif
+
+
+/**
+ * @brief atomic reference counter, used by the smart pointers when SHARED_PTR_THREAD_SAFE is defined,
+ *        and by the control blocks of shared_ptr (each threading policy choosing between atomic and plain updates).
+ *
+ * Increments are relaxed, since a new reference can only be obtained from an existing one,
+ * and decrements are acquire-release so that the thread releasing the last reference
+ * sees all the writes made to the object by the other threads before destroying it.
+ * It uses the GCC/Clang __atomic builtins on a plain long when available, so that the unsynchronized accesses
+ * of get_plain() and set_plain() can be combined and optimized away by the compiler like any other variable,
+ * and falls back to C++11 <atomic> (where these are relaxed atomic accesses) or to the older compiler intrinsics otherwise.
+ */
+class atomic_count
+{
+public:
+    explicit atomic_count(long value) SHARED_NOEXCEPT : // never throws
+        count(value)
+    {
+    }
+    /// @brief increment the counter
+    void increment(void) SHARED_NOEXCEPT // never throws
+    {
+#if defined(SHARED_PTR_ATOMIC_BUILTINS)
+        __atomic_fetch_add(&count, 1, __ATOMIC_RELAXED);
+#elif defined(SHARED_PTR_CPP11)
+        count.fetch_add(1, std::memory_order_relaxed);
+#elif defined(_MSC_VER)
+        _InterlockedIncrement(&count);
+#else
+        __sync_fetch_and_add(&count, 1);
+#endif
+    }
+    /// @brief decrement the counter and return its new value
+    long decrement(void) SHARED_NOEXCEPT // never throws
+    {
+#if defined(SHARED_PTR_ATOMIC_BUILTINS)
+        return __atomic_sub_fetch(&count, 1, __ATOMIC_ACQ_REL);
+#elif defined(SHARED_PTR_CPP11)
+        return (count.fetch_sub(1, std::memory_order_acq_rel) - 1);
+#elif defined(_MSC_VER)
+        return _InterlockedDecrement(&count);
+#else
+        return __sync_sub_and_fetch(&count, 1);
+#endif
+    }
+    /// @brief add n references with a single atomic operation
+    void add(long n) SHARED_NOEXCEPT // never throws
+    {
+#if defined(SHARED_PTR_ATOMIC_BUILTINS)
+        __atomic_fetch_add(&count, n, __ATOMIC_RELAXED);
+#elif defined(SHARED_PTR_CPP11)
+        count.fetch_add(n, std::memory_order_relaxed);
+#elif defined(_MSC_VER)
+        _InterlockedExchangeAdd(&count, n);
+#else
+        __sync_fetch_and_add(&count, n);
+#endif
+    }
+    /// @brief remove n references with a single atomic operation, and return the new value of the counter
+    long subtract(long n) SHARED_NOEXCEPT // never throws
+    {
+#if defined(SHARED_PTR_ATOMIC_BUILTINS)
+        return __atomic_sub_fetch(&count, n, __ATOMIC_ACQ_REL);
+#elif defined(SHARED_PTR_CPP11)
+        return (count.fetch_sub(n, std::memory_order_acq_rel) - n);
+#elif defined(_MSC_VER)
+        return (_InterlockedExchangeAdd(&count, -n) - n);
+#else
+        return __sync_sub_and_fetch(&count, n);
+#endif
+    }
+    /// @brief increment the counter only if it is not already zero, using a lock-free compare-and-swap loop
+    bool increment_if_not_zero(void) SHARED_NOEXCEPT // never throws
+    {
+        long value = get();
+        while (0 != value)
+        {
+#if defined(SHARED_PTR_ATOMIC_BUILTINS)
+            if (__atomic_compare_exchange_n(&count, &value, value + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                return true;
+            }
+#elif defined(SHARED_PTR_CPP11)
+            if (count.compare_exchange_weak(value, value + 1, std::memory_order_relaxed))
+            {
+                return true;
+            }
+#elif defined(_MSC_VER)
+            const long previous = _InterlockedCompareExchange(&count, value + 1, value);
+            if (previous == value)
+            {
+                return true;
+            }
+            value = previous;
+#else
+            const long previous = __sync_val_compare_and_swap(&count, value, value + 1);
+            if (previous == value)
+            {
+                return true;
+            }
+            value = previous;
+#endif
+        }
+        return false;
+    }
+    /// @brief getter of the current value of the counter
+    long get(void) const SHARED_NOEXCEPT // never throws
+    {
+#if defined(SHARED_PTR_ATOMIC_BUILTINS)
+        return __atomic_load_n(&count, __ATOMIC_RELAXED);
+#elif defined(SHARED_PTR_CPP11)
+        return count.load(std::memory_order_relaxed);
+#else
+        return count; // volatile read
+#endif
+    }
+    /// @brief getter of the current value of the counter, acquiring the writes made before the last decrements by the other threads
+    long get_acquire(void) const SHARED_NOEXCEPT // never throws
+    {
+#if defined(SHARED_PTR_ATOMIC_BUILTINS)
+        return __atomic_load_n(&count, __ATOMIC_ACQUIRE);
+#elif defined(SHARED_PTR_CPP11)
+        return count.load(std::memory_order_acquire);
+#elif defined(_MSC_VER)
+        return count; // volatile read, with acquire semantics
+#else
+        const long value = count; // volatile read
+        __sync_synchronize();
+        return value;
+#endif
+    }
+    /// @brief unsynchronized getter of the counter, for a single thread (a plain read with the __atomic builtins)
+    long get_plain(void) const SHARED_NOEXCEPT // never throws
+    {
+#if defined(SHARED_PTR_ATOMIC_BUILTINS)
+        return count;
+#else
+        return get();
+#endif
+    }
+    /// @brief unsynchronized setter of the counter, for a single thread (a plain write with the __atomic builtins)
+    void set_plain(long value) SHARED_NOEXCEPT // never throws
+    {
+#if defined(SHARED_PTR_ATOMIC_BUILTINS)
+        count = value;
+#elif defined(SHARED_PTR_CPP11)
+        count.store(value, std::memory_order_relaxed);
+#else
+        count = value; // volatile write
+#endif
+    }
+
+private:
+#if defined(SHARED_PTR_ATOMIC_BUILTINS)
+    long                count;  //!< Reference counter, accessed through the __atomic builtins except by get_plain() and set_plain()
+#elif defined(SHARED_PTR_CPP11)
+    std::atomic<long>   count;  //!< Atomic reference counter
+#else
+    volatile long       count;  //!< Reference counter manipulated only through atomic intrinsics
+#endif
+
+private:
+    // non-copyable
+    atomic_count(const atomic_count&);
+    atomic_count& operator=(const atomic_count&);
+};
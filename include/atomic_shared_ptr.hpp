@@ -0,0 +1,303 @@
+/**
+ * @file  atomic_shared_ptr.hpp
+ * @brief atomic_shared_ptr is a lock-free shared_ptr that can be loaded and stored concurrently, a subset of the C++20 std::atomic<std::shared_ptr>.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include "shared_ptr.hpp"
+
+#if !defined(SHARED_PTR_CPP11)
+#error "atomic_shared_ptr requires C++11 <atomic>"
+#endif
+#if !defined(SHARED_PTR_THREAD_SAFE)
+#error "atomic_shared_ptr requires SHARED_PTR_THREAD_SAFE to be defined before including shared_ptr.hpp"
+#endif
+
+#include <atomic>
+#include <cstdint>      // std::uintptr_t
+#include <cstdlib>      // std::abort
+
+
+/**
+ * @brief shared_ptr holder that can be shared concurrently by loads and stores of atomic_shared_ptr.
+ *
+ * Each store publishes a new node, owning a copy of the stored shared_ptr, so that the atomic_shared_ptr
+ * can switch from one value to the next by swapping a single word (the shared_ptr itself being two words).
+ * Nodes are immutable, and never published twice: while a thread references a node, its address cannot be reused.
+ *
+ * The reference of the atomic_shared_ptr is worth a large bias, so that the readers whose local references
+ * are transferred by retire() can release them before or after it, without reaching zero too early.
+ */
+template<class T>
+class atomic_shared_ptr_node
+{
+public:
+    explicit atomic_shared_ptr_node(const shared_ptr<T>& p) noexcept : // never throws
+        refs(installed),
+        ptr(p)
+    {
+    }
+    /// @brief release the reference of the atomic_shared_ptr, transferred to the n readers still using the node
+    void retire(long n) noexcept // never throws
+    {
+        if ((installed - n) == refs.fetch_sub(installed - n, std::memory_order_acq_rel))
+        {
+            delete this;
+        }
+    }
+    /// @brief release a reference transferred by retire(), deleting the node (thus releasing its shared_ptr) with the last one
+    void release(void) noexcept // never throws
+    {
+        if (1 == refs.fetch_sub(1, std::memory_order_acq_rel))
+        {
+            delete this;
+        }
+    }
+
+private:
+    static const long   installed = 1L << 20;   //!< Reference of the atomic_shared_ptr, beyond the 65535 local references
+
+    std::atomic<long>   refs;   //!< Reference counter of the node itself
+
+public:
+    const shared_ptr<T> ptr;    //!< Stored value
+};
+
+
+/**
+ * @brief lock-free shared_ptr that can be loaded, stored and exchanged concurrently by different threads.
+ *
+ * It uses a split reference count: the word holding the address of the current node
+ * also counts, in its upper 16 bits, the "local" references of the readers currently copying its value.
+ * - load() takes a local reference with a single wait-free fetch_add, copies the shared_ptr of the node,
+ *   then gives back its local reference with a compare-and-swap loop (which fails only if the word changed meanwhile).
+ * - store() swaps in a new node, and transfers the local references of the old one to its own counter,
+ *   so that the readers still copying it keep it alive, and release it when done.
+ * Nothing is locked, but load() is lock-free rather than wait-free: its compare-and-swap is retried only when
+ * another load() or store() succeeded in the meantime, so some thread always makes progress, but a reader
+ * can in theory be delayed for as long as the other ones keep updating the word.
+ * All the threads touch the same cache line: load() costs about three atomic operations on shared cache lines
+ * (the word, and the counters of the shared_ptr).
+ *
+ * At most 65535 threads can be inside load() or compare_exchange_strong() at the same time: beyond that,
+ * the 16 bits count of local references would wrap around to zero, letting a store() delete the node
+ * while it is still being copied, so the program is aborted instead (checked at every SHARED_ASSERT_LEVEL).
+ *
+ * Requires a 64 bits platform with at most 48 significant bits of virtual address (x86-64, AArch64).
+ */
+template<class T>
+class atomic_shared_ptr
+{
+    static_assert(sizeof(std::uintptr_t) == 8, "atomic_shared_ptr requires a 64 bits platform");
+
+public:
+    /// The type of the managed object, aliased as member type
+    typedef T element_type;
+    /// The type of the stored value
+    typedef shared_ptr<T> value_type;
+
+    /// @brief Default constructor, storing an empty shared_ptr
+    constexpr atomic_shared_ptr(void) noexcept : // never throws
+        word(0)
+    {
+    }
+    /// @brief Constructor storing the provided shared_ptr (not atomic)
+    atomic_shared_ptr(const shared_ptr<T>& ptr) : // may throw std::bad_alloc
+        word(pack(create(ptr)))
+    {
+    }
+    /// @brief the destructor releases the stored value (no other thread shall access it anymore)
+    ~atomic_shared_ptr(void) noexcept // never throws
+    {
+        retire(word.load(std::memory_order_acquire));
+    }
+
+    /// @brief always lock-free, if the platform has lock-free atomic words
+    bool is_lock_free(void) const noexcept // never throws
+    {
+        return word.is_lock_free();
+    }
+
+    /// @brief atomically get a copy of the stored shared_ptr
+    shared_ptr<T> load(void) const noexcept // never throws
+    {
+        std::uintptr_t current = acquire_local();
+        atomic_shared_ptr_node<T>* node = node_of(current);
+        shared_ptr<T> value;
+        if (NULL != node)
+        {
+            value = node->ptr; // protected by the local reference
+        }
+        release_local(node, current);
+        return value;
+    }
+    /// @brief atomically get a copy of the stored shared_ptr
+    operator shared_ptr<T>() const noexcept // never throws
+    {
+        return load();
+    }
+
+    /// @brief atomically replace the stored shared_ptr
+    void store(const shared_ptr<T>& ptr) // may throw std::bad_alloc
+    {
+        const std::uintptr_t previous = word.exchange(pack(create(ptr)), std::memory_order_acq_rel);
+        retire(previous);
+    }
+    /// @brief atomically replace the stored shared_ptr
+    atomic_shared_ptr& operator=(const shared_ptr<T>& ptr) // may throw std::bad_alloc
+    {
+        store(ptr);
+        return *this;
+    }
+
+    /// @brief atomically replace the stored shared_ptr, returning the previous one
+    shared_ptr<T> exchange(const shared_ptr<T>& ptr) // may throw std::bad_alloc
+    {
+        const std::uintptr_t previous = word.exchange(pack(create(ptr)), std::memory_order_acq_rel);
+        atomic_shared_ptr_node<T>* node = node_of(previous);
+        shared_ptr<T> value;
+        if (NULL != node)
+        {
+            value = node->ptr; // protected by the reference of the atomic_shared_ptr not yet retired
+        }
+        retire(previous);
+        return value;
+    }
+
+    /**
+     * @brief atomically replace the stored shared_ptr by desired if it is equivalent to expected
+     *
+     * Two shared_ptr are equivalent if they store the same pointer and share the same control block.
+     *
+     * @param[in,out] expected  expected value, updated with the stored value on failure
+     * @param[in]     desired   new value to store
+     *
+     * @return true if the stored value was replaced, false otherwise
+     */
+    bool compare_exchange_strong(shared_ptr<T>& expected, const shared_ptr<T>& desired) // may throw std::bad_alloc
+    {
+        atomic_shared_ptr_node<T>* desired_node = create(desired); // may throw std::bad_alloc
+        for (;;)
+        {
+            std::uintptr_t current = acquire_local();
+            atomic_shared_ptr_node<T>* node = node_of(current);
+            if (!equivalent(node, expected))
+            {
+                expected = (NULL != node) ? node->ptr : shared_ptr<T>(); // protected by the local reference
+                release_local(node, current);
+                if (NULL != desired_node)
+                {
+                    desired_node->retire(0); // never published
+                }
+                return false;
+            }
+            // replace the node if it has not changed, then our local reference is not needed anymore
+            while ((node_of(current) == node) && (0 != count_of(current)))
+            {
+                if (word.compare_exchange_weak(current, pack(desired_node), std::memory_order_acq_rel, std::memory_order_acquire))
+                {
+                    retire(current - local_one);
+                    return true;
+                }
+            }
+            // another thread replaced the node first, transferring our local reference: release it and try again
+            if (NULL != node)
+            {
+                node->release();
+            }
+        }
+    }
+    /// @brief same as compare_exchange_strong() (never fails spuriously)
+    bool compare_exchange_weak(shared_ptr<T>& expected, const shared_ptr<T>& desired) // may throw std::bad_alloc
+    {
+        return compare_exchange_strong(expected, desired);
+    }
+
+private:
+    static const int            local_shift = 48;                                   //!< The count of local references is in the upper bits
+    static const std::uintptr_t local_one   = static_cast<std::uintptr_t>(1) << local_shift;
+    static const std::uintptr_t node_mask   = local_one - 1;
+
+    /// @brief create the node holding a copy of a non-empty shared_ptr
+    static atomic_shared_ptr_node<T>* create(const shared_ptr<T>& ptr) // may throw std::bad_alloc
+    {
+        return ptr ? new atomic_shared_ptr_node<T>(ptr) : NULL;
+    }
+    static std::uintptr_t pack(atomic_shared_ptr_node<T>* node) noexcept // never throws
+    {
+        const std::uintptr_t value = reinterpret_cast<std::uintptr_t>(node);
+        SHARED_ASSERT_FULL(0 == (value & ~node_mask)); // 48 bits virtual address space
+        return value;
+    }
+    static atomic_shared_ptr_node<T>* node_of(std::uintptr_t value) noexcept // never throws
+    {
+        return reinterpret_cast<atomic_shared_ptr_node<T>*>(value & node_mask);
+    }
+    static long count_of(std::uintptr_t value) noexcept // never throws
+    {
+        return static_cast<long>(value >> local_shift);
+    }
+
+    /// @brief take a local reference on the current node, protecting it from being deleted (wait-free)
+    std::uintptr_t acquire_local(void) const noexcept // never throws
+    {
+        const std::uintptr_t current = word.fetch_add(local_one, std::memory_order_acquire) + local_one;
+        if (SHARED_EXPECT_FALSE(0 == count_of(current))) SHARED_UNLIKELY
+        {
+            // more than 65535 concurrent readers: the count has wrapped around, and cannot protect the node anymore
+#if SHARED_ASSERT_LEVEL > 0
+            shared_assertion_failed("0 != count_of(current)", SHARED_CURRENT_FUNCTION, __FILE__, __LINE__);
+#endif
+            std::abort(); // even if the handler returns
+        }
+        return current;
+    }
+    /// @brief give back the local reference on the node, or release the reference it has been transferred to (lock-free)
+    void release_local(atomic_shared_ptr_node<T>* node, std::uintptr_t current) const noexcept // never throws
+    {
+        while ((node_of(current) == node) && (0 != count_of(current)))
+        {
+            if (word.compare_exchange_weak(current, current - local_one, std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                return;
+            }
+        }
+        // the node has been replaced, and our local reference transferred to its counter
+        if (NULL != node)
+        {
+            node->release();
+        }
+    }
+    /// @brief release the reference of the atomic_shared_ptr on a node it does not hold anymore,
+    ///        transferring the local references of the readers still using it
+    static void retire(std::uintptr_t previous) noexcept // never throws
+    {
+        atomic_shared_ptr_node<T>* node = node_of(previous);
+        if (NULL != node)
+        {
+            node->retire(count_of(previous));
+        }
+    }
+    /// @brief same pointer and same control block
+    static bool equivalent(const atomic_shared_ptr_node<T>* node, const shared_ptr<T>& ptr) noexcept // never throws
+    {
+        if (NULL == node)
+        {
+            return !ptr;
+        }
+        return (node->ptr.get() == ptr.get()) && !node->ptr.owner_before(ptr) && !ptr.owner_before(node->ptr);
+    }
+
+private:
+    // non-copyable, like std::atomic
+    atomic_shared_ptr(const atomic_shared_ptr&);
+    atomic_shared_ptr& operator=(const atomic_shared_ptr&);
+
+private:
+    mutable std::atomic<std::uintptr_t> word; //!< Address of the current node, and count of local references
+};
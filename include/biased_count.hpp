@@ -0,0 +1,306 @@
+/**
+ * @file  biased_count.hpp
+ * @brief biased_count is the biased reference counter of the control blocks of shared_ptr (SHARED_PTR_BIASED).
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+// detect a C++11 compiler (MSVC does not report its real __cplusplus value by default)
+#if !defined(SHARED_PTR_CPP11) && ((__cplusplus >= 201103L) || (defined(_MSC_VER) && (_MSC_VER >= 1900)))
+#define SHARED_PTR_CPP11
+#endif
+
+#ifndef SHARED_PTR_CPP11
+#error "SHARED_PTR_BIASED requires C++11"
+#endif
+
+#include <cstddef>      // NULL
+#include <new>          // std::nothrow
+#include <atomic>
+
+
+/**
+ * @brief biased reference counter, favoring the thread that created the object ("Biased Reference Counting", Choi et al. 2018).
+ *
+ * The owner thread updates a local counter without any atomic read-modify-write operation,
+ * while the other threads use an atomic shared counter. The object is alive while the sum of both is not zero:
+ * - when the owner releases its last local reference, it merges the shared counter (a single atomic operation),
+ *   and from then on all the threads use the shared counter;
+ * - when another thread releases a reference obtained from the owner, the shared counter gets negative:
+ *   the object is then queued to the owner thread, which merges it later, when it next creates or releases
+ *   a biased object, calls merge_queued(), or exits.
+ *
+ * It is a base class, calling biased_release() when the last reference of an object queued for merge is released.
+ * Each thread creating biased objects allocates a small record, kept until the end of the program.
+ */
+class biased_count
+{
+public:
+    /// @brief increment the counter
+    void increment(void) noexcept // never throws
+    {
+        if (is_owner())
+        {
+            local.store(local.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        else
+        {
+            shared.fetch_add(one, std::memory_order_relaxed);
+        }
+    }
+    /// @brief add n references with a single operation
+    void increment(long n) noexcept // never throws
+    {
+        if (is_owner())
+        {
+            local.store(local.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+        else
+        {
+            shared.fetch_add(n * one, std::memory_order_relaxed);
+        }
+    }
+    /// @brief decrement the counter, returning 0 if this was the last reference so that the object is to be destroyed
+    long decrement(void) noexcept // never throws
+    {
+        if (is_owner())
+        {
+            biased_thread* self = home;
+            long count = local.load(std::memory_order_relaxed) - 1;
+            local.store(count, std::memory_order_relaxed);
+            if (0 == count)
+            {
+                // last local reference: merge with the shared counter (unless the object waits in the queue of the owner)
+                merged = true;
+                count = shared.fetch_or(merged_flag, std::memory_order_acq_rel);
+            }
+            if ((0 != count) && (NULL != self->queue.load(std::memory_order_relaxed)))
+            {
+                merge_queued(); // may destroy this object if it was queued: do not touch it anymore
+            }
+            return count;
+        }
+        long value = shared.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            long next = value - one;
+            if ((0 == (value & (merged_flag | queued_flag))) && (next < 0))
+            {
+                next |= queued_flag; // reference of the owner released by another thread
+            }
+            if (shared.compare_exchange_weak(value, next, std::memory_order_acq_rel, std::memory_order_relaxed))
+            {
+                if ((0 != (next & queued_flag)) && (0 == (value & queued_flag)))
+                {
+                    return enqueue() ? 0 : 1;
+                }
+                return (merged_flag == next) ? 0 : 1;
+            }
+        }
+    }
+    /// @brief increment the counter only if it is not already zero (used by weak_ptr::lock())
+    ///
+    /// An object whose last reference has been released by another thread is expired, even though it still waits
+    /// in the queue of its owner thread to be destroyed (the shared counter cancelling out the local one).
+    bool increment_if_not_zero(void) noexcept // never throws
+    {
+        if (is_owner())
+        {
+            // no other thread can destroy the object before the owner merges it
+            const long local_count = local.load(std::memory_order_relaxed);
+            if (0 >= total(local_count, shared.load(std::memory_order_relaxed)))
+            {
+                return false;
+            }
+            increment();
+            return true;
+        }
+        long local_count = local.load(std::memory_order_relaxed);
+        long value = shared.load(std::memory_order_relaxed);
+        while (0 < total(local_count, value))
+        {
+            if (shared.compare_exchange_weak(value, value + one, std::memory_order_relaxed))
+            {
+                return true;
+            }
+            local_count = local.load(std::memory_order_relaxed);
+            value = shared.load(std::memory_order_relaxed);
+        }
+        return false;
+    }
+    /// @brief current value of the counter (an approximation when read by another thread than the owner)
+    long get(void) const noexcept // never throws
+    {
+        const long count = total(local.load(std::memory_order_relaxed), shared.load(std::memory_order_relaxed));
+        return (0 < count) ? count : 0;
+    }
+
+    /// @brief merge the objects queued to the current thread by the other threads (destroying the ones without references)
+    static void merge_queued(void) noexcept // never throws
+    {
+        biased_thread* self = local_thread();
+        if (NULL != self)
+        {
+            merge_list(self->queue.exchange(NULL, std::memory_order_acquire));
+        }
+    }
+
+protected:
+    /// @brief the object is owned by the current thread, with one reference
+    biased_count(void) noexcept : // never throws
+        home(current_thread()),
+        local((NULL != home) ? 1 : 0),
+        shared((NULL != home) ? 0 : (one | merged_flag)), // without thread record, use only the shared counter
+        merged(NULL == home),
+        next_queued(NULL)
+    {
+        if ((NULL != home) && (NULL != home->queue.load(std::memory_order_relaxed)))
+        {
+            merge_queued();
+        }
+    }
+    virtual ~biased_count(void) noexcept // never throws
+    {
+    }
+    /// @brief release the object when its last reference has been released during a merge
+    virtual void biased_release(void) noexcept = 0; // never throws
+
+private:
+    /// record of a thread owning biased objects
+    struct biased_thread
+    {
+        std::atomic<biased_count*>  queue;  //!< Objects to merge, queued by the other threads
+        biased_thread*              next;   //!< Next thread in the global list, keeping the records reachable
+    };
+    /// create the record of the current thread, and close it at the exit of the thread
+    struct thread_holder
+    {
+        thread_holder(void) noexcept // never throws
+        {
+            biased_thread* self = new(std::nothrow) biased_thread;
+            if (NULL != self)
+            {
+                self->queue.store(NULL, std::memory_order_relaxed);
+                std::atomic<biased_thread*>& head = all_threads();
+                self->next = head.load(std::memory_order_relaxed);
+                while (!head.compare_exchange_weak(self->next, self, std::memory_order_release, std::memory_order_relaxed))
+                {
+                }
+            }
+            local_thread() = self;
+        }
+        ~thread_holder(void) noexcept // never throws
+        {
+            biased_thread* self = local_thread();
+            local_thread() = NULL;
+            exited() = true;
+            if (NULL != self)
+            {
+                // from now on, the other threads merge the objects of this thread themselves
+                merge_list(self->queue.exchange(closed(), std::memory_order_acq_rel));
+            }
+        }
+    };
+
+    static const long one           = 4;    //!< One reference in the shared counter
+    static const long merged_flag   = 1;    //!< The local counter has been merged in the shared counter
+    static const long queued_flag   = 2;    //!< The object is queued for a merge by its owner thread
+
+    /// @brief number of references, from the values of the local counter and of the shared counter
+    ///
+    /// Once merged, the local counter is not counted anymore: merge() leaves it untouched (the other threads releasing
+    /// the merged references may destroy the object right after), so that it is never missed by a concurrent reader.
+    static long total(long local_count, long value) noexcept // never throws
+    {
+        const long shared_count = (value - (value & (merged_flag | queued_flag))) / one;
+        return (0 != (value & merged_flag)) ? shared_count : (local_count + shared_count);
+    }
+    /// @brief the current thread is the owner of the object and has not merged it yet
+    bool is_owner(void) const noexcept // never throws
+    {
+        return (home == local_thread()) && !merged;
+    }
+    /// @brief queue the object to its owner thread, or merge it directly if the owner has exited
+    /// @return true if the object is to be destroyed
+    bool enqueue(void) noexcept // never throws
+    {
+        biased_count* head = home->queue.load(std::memory_order_acquire);
+        do
+        {
+            if (closed() == head)
+            {
+                return merge();
+            }
+            next_queued = head;
+        } while (!home->queue.compare_exchange_weak(head, this, std::memory_order_release, std::memory_order_acquire));
+        return false;
+    }
+    /// @brief merge the local counter of a queued object in the shared counter (by the owner, or after its exit)
+    /// @return true if the object is to be destroyed
+    bool merge(void) noexcept // never throws
+    {
+        const long count = local.load(std::memory_order_relaxed);
+        merged = true;
+        long value = shared.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            const long next = ((value + count * one) | merged_flag) & ~queued_flag;
+            if (shared.compare_exchange_weak(value, next, std::memory_order_acq_rel, std::memory_order_relaxed))
+            {
+                return (merged_flag == next);
+            }
+        }
+    }
+    static void merge_list(biased_count* list) noexcept // never throws
+    {
+        while (NULL != list)
+        {
+            biased_count* next = list->next_queued;
+            if (list->merge())
+            {
+                list->biased_release();
+            }
+            list = next;
+        }
+    }
+
+    static biased_thread* current_thread(void) noexcept // never throws
+    {
+        if ((NULL == local_thread()) && !exited())
+        {
+            static thread_local thread_holder holder;
+        }
+        return local_thread();
+    }
+    static biased_thread*& local_thread(void) noexcept // never throws
+    {
+        static thread_local biased_thread* self = NULL;
+        return self;
+    }
+    static bool& exited(void) noexcept // never throws
+    {
+        static thread_local bool has_exited = false;
+        return has_exited;
+    }
+    static biased_count* closed(void) noexcept // never throws
+    {
+        static char sentinel;
+        return reinterpret_cast<biased_count*>(&sentinel);
+    }
+    static std::atomic<biased_thread*>& all_threads(void) noexcept // never throws
+    {
+        static std::atomic<biased_thread*> head(NULL);
+        return head;
+    }
+
+private:
+    biased_thread* const    home;           //!< Record of the owner thread
+    std::atomic<long>       local;          //!< Local counter, only modified by the owner thread
+    std::atomic<long>       shared;         //!< Shared counter (times "one") and flags
+    bool                    merged;         //!< The local counter has been merged (only used by the owner thread)
+    biased_count*           next_queued;    //!< Next object in the queue of the owner thread
+};
@@ -0,0 +1,250 @@
+/**
+ * @file  compact_shared_ptr.hpp
+ * @brief compact_shared_ptr is a shared smart pointer the size of a raw pointer, for objects created by make_compact_shared().
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include "shared_ptr.hpp"
+
+
+/**
+ * @brief shared smart pointer storing only the address of a control block created by make_compact_shared().
+ *
+ * The object is constructed in place inside its control block (like with make_shared()),
+ * at a fixed offset known at compile-time, so the address of the object is not stored but computed:
+ * a compact_shared_ptr has the size of a raw pointer, half the size of a shared_ptr,
+ * doubling the density of containers of handles.
+ *
+ * The price is that it cannot point to anything else than the whole object owned by the control block:
+ * no aliasing, no custom deleter, no conversion to a base class.
+ * Convert it to a shared_ptr<T> for that (sharing the same control block, so this costs only a reference).
+ */
+template<class T>
+class compact_shared_ptr
+{
+public:
+    /// The type of the managed object, aliased as member type
+    typedef T element_type;
+    /// The type of the control block, with the object at a fixed offset
+    typedef count_inplace<T, typename count_default_allocator<T>::type> block_type;
+
+    /// @brief Default constructor
+    SHARED_CONSTEXPR compact_shared_ptr(void) SHARED_NOEXCEPT : // never throws
+        pn(NULL)
+    {
+    }
+    /// @brief Copy constructor (used by the copy-and-swap idiom)
+    compact_shared_ptr(const compact_shared_ptr& ptr) SHARED_NOEXCEPT : // never throws
+        pn(ptr.pn)
+    {
+        if (NULL != pn)
+        {
+            pn->add_ref();
+        }
+    }
+#ifdef SHARED_PTR_CPP11
+    /// @brief Move constructor, stealing the ownership without touching the reference counter
+    compact_shared_ptr(compact_shared_ptr&& ptr) SHARED_NOEXCEPT : // never throws
+        pn(ptr.pn)
+    {
+        ptr.pn = NULL;
+    }
+    /// @brief Assignment operator using the copy-and-swap idiom (copy constructor and swap method)
+    compact_shared_ptr& operator=(const compact_shared_ptr& ptr) SHARED_NOEXCEPT // never throws
+    {
+        compact_shared_ptr(ptr).swap(*this);
+        return *this;
+    }
+    /// @brief Move assignment operator, stealing the ownership without touching the reference counter
+    compact_shared_ptr& operator=(compact_shared_ptr&& ptr) SHARED_NOEXCEPT // never throws
+    {
+        compact_shared_ptr(std::move(ptr)).swap(*this);
+        return *this;
+    }
+#else
+    /// @brief Assignment operator using the copy-and-swap idiom (copy constructor and swap method)
+    compact_shared_ptr& operator=(compact_shared_ptr ptr) SHARED_NOEXCEPT // never throws
+    {
+        swap(ptr);
+        return *this;
+    }
+#endif
+    /// @brief the destructor releases its ownership
+    ~compact_shared_ptr(void) SHARED_NOEXCEPT // never throws
+    {
+        release();
+    }
+    /// @brief this reset releases its ownership
+    void reset(void) SHARED_NOEXCEPT // never throws
+    {
+        release();
+    }
+
+    /// @brief Swap method for the copy-and-swap idiom (copy constructor and swap method)
+    void swap(compact_shared_ptr& lhs) SHARED_NOEXCEPT // never throws
+    {
+        std::swap(pn, lhs.pn);
+    }
+
+    /// @brief share the ownership with a shared_ptr, which can then be converted or aliased
+    operator shared_ptr<T>() const SHARED_NOEXCEPT // never throws
+    {
+        if (NULL != pn)
+        {
+            pn->add_ref();
+            return shared_ptr<T>(static_cast<count_base*>(pn), pn->get()); // adopt the new reference
+        }
+        return shared_ptr<T>();
+    }
+
+    // reference counter operations :
+    operator bool() const SHARED_NOEXCEPT // never throws
+    {
+        return (NULL != pn);
+    }
+    bool unique(void)  const SHARED_NOEXCEPT // never throws
+    {
+        return (1 == use_count());
+    }
+    long use_count(void)  const SHARED_NOEXCEPT // never throws
+    {
+        return (NULL != pn) ? pn->use_count() : 0;
+    }
+
+    // underlying pointer operations :
+    T& operator*()  const SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT(NULL != pn);
+        return *pn->get();
+    }
+    T* operator->() const SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT(NULL != pn);
+        return pn->get();
+    }
+    T* get(void)  const SHARED_NOEXCEPT // never throws
+    {
+        // no assert, can return NULL
+        return (NULL != pn) ? pn->get() : NULL;
+    }
+
+private:
+    /// @brief Constructor stealing the ownership of a newly created shared_ptr (used by make_compact_shared())
+    /// @note the shared_ptr must come from make_shared<T>(), which creates a block_type control block
+    explicit compact_shared_ptr(shared_ptr<T>& ptr) SHARED_NOEXCEPT : // never throws
+        pn(static_cast<block_type*>(ptr.pn.pn))
+    {
+        SHARED_ASSERT_FULL((NULL == pn) || (pn->get() == ptr.px)); // must point to the object owned by the control block
+        ptr.pn.pn = NULL;
+        ptr.px = NULL;
+    }
+
+    /// @brief release the ownership of the object, destroying it when appropriate
+    void release(void) SHARED_NOEXCEPT // never throws
+    {
+        if (NULL != pn)
+        {
+            pn->release();
+            pn = NULL;
+        }
+    }
+
+private:
+    // only the factory functions can create the first compact_shared_ptr of an object
+#ifdef SHARED_PTR_CPP11
+    template<class U, class... Args> friend compact_shared_ptr<U> make_compact_shared(Args&&... args);
+#else
+    template<class U> friend compact_shared_ptr<U> make_compact_shared(void);
+    template<class U, class A1> friend compact_shared_ptr<U> make_compact_shared(const A1& a1);
+    template<class U, class A1, class A2> friend compact_shared_ptr<U> make_compact_shared(const A1& a1, const A2& a2);
+    template<class U, class A1, class A2, class A3>
+    friend compact_shared_ptr<U> make_compact_shared(const A1& a1, const A2& a2, const A3& a3);
+    template<class U, class A1, class A2, class A3, class A4>
+    friend compact_shared_ptr<U> make_compact_shared(const A1& a1, const A2& a2, const A3& a3, const A4& a4);
+#endif
+
+    block_type* pn; //!< Control block holding the reference counter and the object
+};
+
+
+// comparaison operators
+template<class T, class U> bool operator==(const compact_shared_ptr<T>& l, const compact_shared_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() == r.get());
+}
+template<class T, class U> bool operator!=(const compact_shared_ptr<T>& l, const compact_shared_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() != r.get());
+}
+template<class T, class U> bool operator<=(const compact_shared_ptr<T>& l, const compact_shared_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() <= r.get());
+}
+template<class T, class U> bool operator<(const compact_shared_ptr<T>& l, const compact_shared_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() < r.get());
+}
+template<class T, class U> bool operator>=(const compact_shared_ptr<T>& l, const compact_shared_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() >= r.get());
+}
+template<class T, class U> bool operator>(const compact_shared_ptr<T>& l, const compact_shared_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() > r.get());
+}
+
+
+#ifdef SHARED_PTR_CPP11
+/**
+ * @brief create an object managed by a compact_shared_ptr, using a single allocation for the object and its reference counter.
+ *
+ * @param[in] args  arguments forwarded to the constructor of T
+ */
+template<class T, class... Args>
+compact_shared_ptr<T> make_compact_shared(Args&&... args) // may throw std::bad_alloc or any exception of the T constructor
+{
+    shared_ptr<T> ptr = ::make_shared<T>(std::forward<Args>(args)...);
+    return compact_shared_ptr<T>(ptr);
+}
+#else
+/**
+ * @brief create an object managed by a compact_shared_ptr, using a single allocation for the object and its reference counter.
+ *
+ * Without C++11 variadic templates, up to four arguments are supported, passed by const reference.
+ */
+template<class T>
+compact_shared_ptr<T> make_compact_shared(void) // may throw std::bad_alloc or any exception of the T constructor
+{
+    shared_ptr<T> ptr = ::make_shared<T>();
+    return compact_shared_ptr<T>(ptr);
+}
+template<class T, class A1>
+compact_shared_ptr<T> make_compact_shared(const A1& a1)
+{
+    shared_ptr<T> ptr = ::make_shared<T>(a1);
+    return compact_shared_ptr<T>(ptr);
+}
+template<class T, class A1, class A2>
+compact_shared_ptr<T> make_compact_shared(const A1& a1, const A2& a2)
+{
+    shared_ptr<T> ptr = ::make_shared<T>(a1, a2);
+    return compact_shared_ptr<T>(ptr);
+}
+template<class T, class A1, class A2, class A3>
+compact_shared_ptr<T> make_compact_shared(const A1& a1, const A2& a2, const A3& a3)
+{
+    shared_ptr<T> ptr = ::make_shared<T>(a1, a2, a3);
+    return compact_shared_ptr<T>(ptr);
+}
+template<class T, class A1, class A2, class A3, class A4>
+compact_shared_ptr<T> make_compact_shared(const A1& a1, const A2& a2, const A3& a3, const A4& a4)
+{
+    shared_ptr<T> ptr = ::make_shared<T>(a1, a2, a3, a4);
+    return compact_shared_ptr<T>(ptr);
+}
+#endif
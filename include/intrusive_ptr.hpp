@@ -0,0 +1,296 @@
+/**
+ * @file  intrusive_ptr.hpp
+ * @brief intrusive_ptr is a minimal implementation of intrusive smart pointer, a subset of boost::intrusive_ptr.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <cstddef>      // NULL
+#include <algorithm>    // std::swap
+
+// checks with a configurable level and handler (SHARED_ASSERT_LEVEL, SHARED_ASSERT_HANDLER)
+#include "shared_assert.hpp"
+
+// detect a C++11 compiler (MSVC does not report its real __cplusplus value by default)
+#if !defined(SHARED_PTR_CPP11) && ((__cplusplus >= 201103L) || (defined(_MSC_VER) && (_MSC_VER >= 1900)))
+#define SHARED_PTR_CPP11
+#endif
+
+// noexcept and constexpr with a C++11 compiler, fallback to a dynamic exception specification on older compilers
+#ifndef SHARED_NOEXCEPT
+#ifdef SHARED_PTR_CPP11
+#define SHARED_NOEXCEPT     noexcept
+#define SHARED_CONSTEXPR    constexpr
+#else
+#define SHARED_NOEXCEPT     throw()
+#define SHARED_CONSTEXPR
+#endif
+#endif
+
+// opt-in thread-safe reference counting: define SHARED_PTR_THREAD_SAFE before including this header
+#ifdef SHARED_PTR_THREAD_SAFE
+#include "atomic_count.hpp"
+#endif
+
+
+/**
+ * @brief minimal implementation of intrusive smart pointer, a subset of boost::intrusive_ptr.
+ *
+ * intrusive_ptr is a smart pointer to an object embedding its own reference counter,
+ * so that it needs neither a separate allocation nor a separate control block:
+ * it has the same size as a raw pointer.
+ *
+ * It manages the reference counter by calling the free functions intrusive_ptr_add_ref(T*) and intrusive_ptr_release(T*),
+ * found by argument-dependent lookup; ref_counted<T> is a base class providing them.
+ */
+template<class T>
+class intrusive_ptr
+{
+public:
+    /// The type of the managed object, aliased as member type
+    typedef T element_type;
+
+    /// @brief Default constructor
+    SHARED_CONSTEXPR intrusive_ptr(void) SHARED_NOEXCEPT : // never throws
+        px(NULL)
+    {
+    }
+    /// @brief Constructor with the provided pointer to manage, adding a reference to it unless told otherwise
+    intrusive_ptr(T* p, bool add_ref = true) SHARED_NOEXCEPT : // never throws
+        px(p)
+    {
+        if ((NULL != px) && add_ref)
+        {
+            intrusive_ptr_add_ref(px);
+        }
+    }
+    /// @brief Copy constructor to convert from another pointer type
+    template <class U>
+    intrusive_ptr(const intrusive_ptr<U>& ptr) SHARED_NOEXCEPT : // never throws
+        px(ptr.get())
+    {
+        if (NULL != px)
+        {
+            intrusive_ptr_add_ref(px);
+        }
+    }
+    /// @brief Copy constructor (used by the copy-and-swap idiom)
+    intrusive_ptr(const intrusive_ptr& ptr) SHARED_NOEXCEPT : // never throws
+        px(ptr.px)
+    {
+        if (NULL != px)
+        {
+            intrusive_ptr_add_ref(px);
+        }
+    }
+#ifdef SHARED_PTR_CPP11
+    /// @brief Move constructor, stealing the reference without touching the counter
+    intrusive_ptr(intrusive_ptr&& ptr) SHARED_NOEXCEPT : // never throws
+        px(ptr.px)
+    {
+        ptr.px = NULL;
+    }
+    /// @brief Assignment operator using the copy-and-swap idiom (copy constructor and swap method)
+    intrusive_ptr& operator=(const intrusive_ptr& ptr) SHARED_NOEXCEPT // never throws
+    {
+        intrusive_ptr(ptr).swap(*this);
+        return *this;
+    }
+    /// @brief Move assignment operator, stealing the reference without touching the counter
+    intrusive_ptr& operator=(intrusive_ptr&& ptr) SHARED_NOEXCEPT // never throws
+    {
+        intrusive_ptr(static_cast<intrusive_ptr&&>(ptr)).swap(*this);
+        return *this;
+    }
+#else
+    /// @brief Assignment operator using the copy-and-swap idiom (copy constructor and swap method)
+    intrusive_ptr& operator=(intrusive_ptr ptr) SHARED_NOEXCEPT // never throws
+    {
+        swap(ptr);
+        return *this;
+    }
+#endif
+    /// @brief the destructor releases its reference
+    ~intrusive_ptr(void) SHARED_NOEXCEPT // never throws
+    {
+        release();
+    }
+    /// @brief this reset releases its reference
+    void reset(void) SHARED_NOEXCEPT // never throws
+    {
+        release();
+    }
+    /// @brief this reset releases its reference and adds another one
+    void reset(T* p, bool add_ref = true) SHARED_NOEXCEPT // never throws
+    {
+        intrusive_ptr(p, add_ref).swap(*this);
+    }
+
+    /// @brief Swap method for the copy-and-swap idiom (copy constructor and swap method)
+    void swap(intrusive_ptr& lhs) SHARED_NOEXCEPT // never throws
+    {
+        std::swap(px, lhs.px);
+    }
+
+    /// @brief give up the reference without releasing it, returning the raw pointer
+    T* detach(void) SHARED_NOEXCEPT // never throws
+    {
+        T* p = px;
+        px = NULL;
+        return p;
+    }
+
+    // reference counter operations :
+    operator bool() const SHARED_NOEXCEPT // never throws
+    {
+        return (NULL != px);
+    }
+
+    // underlying pointer operations :
+    T& operator*()  const SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT(NULL != px);
+        return *px;
+    }
+    T* operator->() const SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT(NULL != px);
+        return px;
+    }
+    T* get(void)  const SHARED_NOEXCEPT // never throws
+    {
+        // no assert, can return NULL
+        return px;
+    }
+
+private:
+    /// @brief release the reference to the px pointer, destroying the object when appropriate
+    void release(void) SHARED_NOEXCEPT // never throws
+    {
+        if (NULL != px)
+        {
+            intrusive_ptr_release(px);
+            px = NULL;
+        }
+    }
+
+private:
+    T*  px; //!< Native pointer
+};
+
+
+// comparaison operators
+template<class T, class U> bool operator==(const intrusive_ptr<T>& l, const intrusive_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() == r.get());
+}
+template<class T, class U> bool operator!=(const intrusive_ptr<T>& l, const intrusive_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() != r.get());
+}
+template<class T, class U> bool operator<=(const intrusive_ptr<T>& l, const intrusive_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() <= r.get());
+}
+template<class T, class U> bool operator<(const intrusive_ptr<T>& l, const intrusive_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() < r.get());
+}
+template<class T, class U> bool operator>=(const intrusive_ptr<T>& l, const intrusive_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() >= r.get());
+}
+template<class T, class U> bool operator>(const intrusive_ptr<T>& l, const intrusive_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() > r.get());
+}
+
+
+
+// static cast of intrusive_ptr
+template<class T, class U>
+intrusive_ptr<T> static_pointer_cast(const intrusive_ptr<U>& ptr) // never throws
+{
+    return intrusive_ptr<T>(static_cast<typename intrusive_ptr<T>::element_type*>(ptr.get()));
+}
+
+// dynamic cast of intrusive_ptr
+template<class T, class U>
+intrusive_ptr<T> dynamic_pointer_cast(const intrusive_ptr<U>& ptr) // never throws
+{
+    return intrusive_ptr<T>(dynamic_cast<typename intrusive_ptr<T>::element_type*>(ptr.get()));
+}
+
+
+/**
+ * @brief base class embedding a reference counter in an object managed by intrusive_ptr.
+ *
+ * Use it with the CRTP (class Xxx : public ref_counted<Xxx>) so that the object is deleted
+ * as the right type without requiring a virtual destructor.
+ * The reference counter is atomic when SHARED_PTR_THREAD_SAFE is defined.
+ */
+template<class T>
+class ref_counted
+{
+public:
+    /// @brief getter of the reference counter
+    long use_count(void) const SHARED_NOEXCEPT // never throws
+    {
+#ifdef SHARED_PTR_THREAD_SAFE
+        return count.get();
+#else
+        return count;
+#endif
+    }
+
+    /// @brief add a reference to the object (found by argument-dependent lookup)
+    friend void intrusive_ptr_add_ref(const ref_counted* p) SHARED_NOEXCEPT // never throws
+    {
+#ifdef SHARED_PTR_THREAD_SAFE
+        p->count.increment();
+#else
+        ++(p->count);
+#endif
+    }
+    /// @brief release a reference to the object, deleting it with the last one (found by argument-dependent lookup)
+    friend void intrusive_ptr_release(const ref_counted* p) SHARED_NOEXCEPT // never throws
+    {
+#ifdef SHARED_PTR_THREAD_SAFE
+        if (0 == p->count.decrement())
+#else
+        if (0 == --(p->count))
+#endif
+        {
+            delete static_cast<const T*>(p);
+        }
+    }
+
+protected:
+    ref_counted(void) SHARED_NOEXCEPT : // never throws
+        count(0)
+    {
+    }
+    /// @brief copying the object does not copy its references
+    ref_counted(const ref_counted&) SHARED_NOEXCEPT : // never throws
+        count(0)
+    {
+    }
+    ref_counted& operator=(const ref_counted&) SHARED_NOEXCEPT // never throws
+    {
+        return *this;
+    }
+    ~ref_counted(void) SHARED_NOEXCEPT // never throws
+    {
+    }
+
+private:
+#ifdef SHARED_PTR_THREAD_SAFE
+    mutable atomic_count    count;  //!< Atomic reference counter
+#else
+    mutable long            count;  //!< Reference counter
+#endif
+};
@@ -0,0 +1,373 @@
+/**
+ * @file  local_shared_ptr.hpp
+ * @brief local_shared_ptr is a shared smart pointer confined to a single thread, counting its copies without atomic operation.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include "shared_ptr.hpp"
+
+// check that the local references are used by the thread that created them, with the full level of checks
+#if defined(SHARED_PTR_CPP11) && (SHARED_ASSERT_LEVEL >= 2)
+#define SHARED_PTR_LOCAL_OWNER_CHECK
+#include <thread>
+#endif
+
+
+/**
+ * @brief local control block of local_shared_ptr, holding a single reference on the shared control block of the object.
+ *
+ * Its own counter is updated with the single_threaded policy by the local_shared_ptr,
+ * while the reference on the shared control block is taken and released atomically,
+ * as the object may also be shared by other threads through shared_ptr.
+ */
+class count_local SHARED_FINAL : public count_base
+{
+public:
+    /// @brief adopt a reference on the shared control block of an object (NULL for an uncounted pointer)
+    explicit count_local(count_base* block) SHARED_NOEXCEPT : // never throws
+        count_base(),
+        shared(block)
+#ifdef SHARED_PTR_LOCAL_OWNER_CHECK
+        , owner(std::this_thread::get_id())
+#endif
+    {
+    }
+    /// @brief share the ownership of the local control block
+    void local_add_ref(void) SHARED_NOEXCEPT // never throws
+    {
+        check_owner();
+        add_ref<single_threaded>();
+    }
+    /// @brief release the ownership of the local control block, releasing the shared one with the last reference
+    void local_release(void) SHARED_NOEXCEPT // never throws
+    {
+        check_owner();
+        release<single_threaded>();
+    }
+    /// @brief shared control block of the object
+    count_base* shared_block(void) const SHARED_NOEXCEPT // never throws
+    {
+        return shared;
+    }
+    /// @brief release the reference on the shared control block
+    virtual void dispose(void) SHARED_NOEXCEPT // never throws
+    {
+        if (NULL != shared)
+        {
+            shared->release<multi_threaded>();
+        }
+    }
+    /// @brief the control block is final: dispose() and destroy() are inlined
+    virtual void dispose_and_destroy(void) SHARED_NOEXCEPT // never throws
+    {
+        dispose();
+        destroy();
+    }
+
+private:
+    // the local references shall all be used by the thread that created the first one
+    void check_owner(void) const SHARED_NOEXCEPT // never throws
+    {
+#ifdef SHARED_PTR_LOCAL_OWNER_CHECK
+        SHARED_ASSERT_FULL(std::this_thread::get_id() == owner);
+#endif
+    }
+
+private:
+    count_base*     shared; //!< Shared control block of the object
+#ifdef SHARED_PTR_LOCAL_OWNER_CHECK
+    std::thread::id owner;  //!< Thread using the local references
+#endif
+};
+
+
+/**
+ * @brief shared smart pointer confined to a single thread, like boost::local_shared_ptr.
+ *
+ * All the local_shared_ptr converted from the same shared_ptr share a local control block, counting them
+ * with plain increments and decrements (whatever the threading policy), and holding a single reference
+ * on the shared control block of the object: the conversion from shared_ptr costs an allocation and one atomic increment
+ * (none when moving a shared_ptr), then all the local copies are free of atomic operations.
+ * It converts back to a shared_ptr, to share the object with other threads.
+ *
+ * A local_shared_ptr, and all its copies, shall be used only by the thread that created it
+ * (checked with SHARED_ASSERT_LEVEL 2), for instance for the nodes of a data structure confined to a thread.
+ */
+template<class T>
+class local_shared_ptr
+{
+public:
+    /// The type of the managed object, aliased as member type
+    typedef T element_type;
+
+    /// @brief Default constructor
+    SHARED_CONSTEXPR local_shared_ptr(void) SHARED_NOEXCEPT : // never throws
+        px(NULL),
+        pn(NULL)
+    {
+    }
+#ifdef SHARED_PTR_CPP11
+    /// @brief Constructor of an empty local_shared_ptr from nullptr
+    constexpr local_shared_ptr(std::nullptr_t) noexcept : // never throws
+        px(nullptr),
+        pn(nullptr)
+    {
+    }
+#endif
+    /// @brief Constructor with the provided pointer to manage (creating both a shared and a local control block)
+    explicit local_shared_ptr(T* p) : // may throw std::bad_alloc
+        px(NULL),
+        pn(NULL)
+    {
+        local_shared_ptr(shared_ptr<T>(p)).swap(*this); // may throw std::bad_alloc
+    }
+    /// @brief Conversion from a shared_ptr, taking a single reference on its control block
+    template<class U, class P>
+    local_shared_ptr(const shared_ptr<U, P>& ptr) : // may throw std::bad_alloc
+        px(NULL),
+        pn(NULL)
+    {
+        count_base* block = ptr.pn.pn;
+        if ((NULL != block) || (NULL != ptr.px))
+        {
+            pn = new count_local(block); // may throw std::bad_alloc
+            if (NULL != block)
+            {
+                block->add_ref<multi_threaded>(); // the shared_ptr may be shared by other threads
+            }
+            px = ptr.px;
+        }
+    }
+#ifdef SHARED_PTR_CPP11
+    /// @brief Conversion from a shared_ptr, stealing its reference without touching its reference counter
+    template<class U>
+    local_shared_ptr(shared_ptr<U>&& ptr) : // may throw std::bad_alloc
+        px(NULL),
+        pn(NULL)
+    {
+        count_base* block = ptr.pn.pn;
+        if ((NULL != block) || (NULL != ptr.px))
+        {
+            pn = new count_local(block); // may throw std::bad_alloc
+            px = ptr.px;
+            ptr.pn.pn = NULL;
+            ptr.px = NULL;
+        }
+    }
+#endif
+    /// @brief Copy constructor to convert from another pointer type
+    template<class U>
+    local_shared_ptr(const local_shared_ptr<U>& ptr) SHARED_NOEXCEPT : // never throws
+        px(ptr.px),
+        pn(ptr.pn)
+    {
+        add_ref();
+    }
+    /// @brief Copy constructor (used by the copy-and-swap idiom)
+    local_shared_ptr(const local_shared_ptr& ptr) SHARED_NOEXCEPT : // never throws
+        px(ptr.px),
+        pn(ptr.pn)
+    {
+        add_ref();
+    }
+#ifdef SHARED_PTR_CPP11
+    /// @brief Move constructor, stealing the ownership without touching the reference counter
+    local_shared_ptr(local_shared_ptr&& ptr) SHARED_NOEXCEPT : // never throws
+        px(ptr.px),
+        pn(ptr.pn)
+    {
+        ptr.px = NULL;
+        ptr.pn = NULL;
+    }
+    /// @brief Assignment operator using the copy-and-swap idiom (copy constructor and swap method)
+    local_shared_ptr& operator=(const local_shared_ptr& ptr) SHARED_NOEXCEPT // never throws
+    {
+        local_shared_ptr(ptr).swap(*this);
+        return *this;
+    }
+    /// @brief Move assignment operator, stealing the ownership without touching the reference counter
+    local_shared_ptr& operator=(local_shared_ptr&& ptr) SHARED_NOEXCEPT // never throws
+    {
+        local_shared_ptr(std::move(ptr)).swap(*this);
+        return *this;
+    }
+#else
+    /// @brief Assignment operator using the copy-and-swap idiom (copy constructor and swap method)
+    local_shared_ptr& operator=(local_shared_ptr ptr) SHARED_NOEXCEPT // never throws
+    {
+        swap(ptr);
+        return *this;
+    }
+#endif
+    /// @brief the destructor releases its ownership
+    ~local_shared_ptr(void) SHARED_NOEXCEPT // never throws
+    {
+        release();
+    }
+    /// @brief this reset releases its ownership
+    void reset(void) SHARED_NOEXCEPT // never throws
+    {
+        release();
+    }
+    /// @brief this reset release its ownership and re-acquire another one
+    void reset(T* p) // may throw std::bad_alloc
+    {
+        SHARED_ASSERT((NULL == p) || (px != p)); // auto-reset not allowed
+        local_shared_ptr(p).swap(*this); // may throw std::bad_alloc
+    }
+
+    /// @brief Swap method for the copy-and-swap idiom (copy constructor and swap method)
+    void swap(local_shared_ptr& lhs) SHARED_NOEXCEPT // never throws
+    {
+        std::swap(px, lhs.px);
+        std::swap(pn, lhs.pn);
+    }
+
+    /// @brief share the ownership with a shared_ptr, which can be used by other threads
+    template<class U>
+    operator shared_ptr<U>() const SHARED_NOEXCEPT // never throws
+    {
+        count_base* block = (NULL != pn) ? pn->shared_block() : NULL;
+        if (NULL != block)
+        {
+            block->add_ref();
+        }
+        return shared_ptr<U>(block, px); // adopt the new reference
+    }
+
+    // reference counter operations :
+    operator bool() const SHARED_NOEXCEPT // never throws
+    {
+        return (NULL != px);
+    }
+    bool unique(void)  const SHARED_NOEXCEPT // never throws
+    {
+        return (1 == use_count());
+    }
+    /// @brief number of local_shared_ptr sharing the local control block (not counting the shared_ptr)
+    long use_count(void)  const SHARED_NOEXCEPT // never throws
+    {
+        return (NULL != pn) ? pn->use_count() : 0;
+    }
+
+    // underlying pointer operations :
+    T& operator*()  const SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT(NULL != px);
+        return *px;
+    }
+    T* operator->() const SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT(NULL != px);
+        return px;
+    }
+    T* get(void)  const SHARED_NOEXCEPT // never throws
+    {
+        // no assert, can return NULL
+        return px;
+    }
+
+private:
+    /// @brief share the ownership of the local control block
+    void add_ref(void) SHARED_NOEXCEPT // never throws
+    {
+        if (NULL != pn)
+        {
+            pn->local_add_ref();
+        }
+    }
+    /// @brief release the ownership of the local control block, releasing the object when appropriate
+    void release(void) SHARED_NOEXCEPT // never throws
+    {
+        if (NULL != pn)
+        {
+            pn->local_release();
+            pn = NULL;
+        }
+        px = NULL;
+    }
+
+private:
+    // all local_shared_ptr specializations can share the local control block of one another
+    template<class U> friend class local_shared_ptr;
+
+    T*              px; //!< Native pointer
+    count_local*    pn; //!< Local control block holding the local reference counter
+};
+
+
+// comparaison operators
+template<class T, class U> bool operator==(const local_shared_ptr<T>& l, const local_shared_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() == r.get());
+}
+template<class T, class U> bool operator!=(const local_shared_ptr<T>& l, const local_shared_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() != r.get());
+}
+template<class T, class U> bool operator<=(const local_shared_ptr<T>& l, const local_shared_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() <= r.get());
+}
+template<class T, class U> bool operator<(const local_shared_ptr<T>& l, const local_shared_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() < r.get());
+}
+template<class T, class U> bool operator>=(const local_shared_ptr<T>& l, const local_shared_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() >= r.get());
+}
+template<class T, class U> bool operator>(const local_shared_ptr<T>& l, const local_shared_ptr<U>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() > r.get());
+}
+
+
+#ifdef SHARED_PTR_CPP11
+/**
+ * @brief create an object managed by a local_shared_ptr, using make_shared() for the object and its shared control block.
+ *
+ * @param[in] args  arguments forwarded to the constructor of T
+ */
+template<class T, class... Args>
+local_shared_ptr<T> make_local_shared(Args&&... args) // may throw std::bad_alloc or any exception of the T constructor
+{
+    return local_shared_ptr<T>(::make_shared<T>(std::forward<Args>(args)...));
+}
+#else
+/**
+ * @brief create an object managed by a local_shared_ptr, using make_shared() for the object and its shared control block.
+ *
+ * Without C++11 variadic templates, up to four arguments are supported, passed by const reference.
+ */
+template<class T>
+local_shared_ptr<T> make_local_shared(void) // may throw std::bad_alloc or any exception of the T constructor
+{
+    return local_shared_ptr<T>(::make_shared<T>());
+}
+template<class T, class A1>
+local_shared_ptr<T> make_local_shared(const A1& a1)
+{
+    return local_shared_ptr<T>(::make_shared<T>(a1));
+}
+template<class T, class A1, class A2>
+local_shared_ptr<T> make_local_shared(const A1& a1, const A2& a2)
+{
+    return local_shared_ptr<T>(::make_shared<T>(a1, a2));
+}
+template<class T, class A1, class A2, class A3>
+local_shared_ptr<T> make_local_shared(const A1& a1, const A2& a2, const A3& a3)
+{
+    return local_shared_ptr<T>(::make_shared<T>(a1, a2, a3));
+}
+template<class T, class A1, class A2, class A3, class A4>
+local_shared_ptr<T> make_local_shared(const A1& a1, const A2& a2, const A3& a3, const A4& a4)
+{
+    return local_shared_ptr<T>(::make_shared<T>(a1, a2, a3, a4));
+}
+#endif
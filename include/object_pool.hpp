@@ -0,0 +1,429 @@
+/**
+ * @file  object_pool.hpp
+ * @brief object_pool recycles the memory of the objects it creates, and of their control block, when their last shared_ptr is released.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include "shared_ptr.hpp"
+
+#if !defined(SHARED_PTR_CPP11)
+#error "object_pool requires C++11 thread_local, <atomic> and <mutex>"
+#endif
+
+#include <atomic>
+#include <mutex>
+#include <utility>      // std::forward
+
+#ifndef SHARED_PTR_OBJECT_POOL_SIZE
+#define SHARED_PTR_OBJECT_POOL_SIZE         1024    // default maximum number of free nodes kept in the global free-list of a pool
+#endif
+#ifndef SHARED_PTR_OBJECT_POOL_CACHE_SIZE
+#define SHARED_PTR_OBJECT_POOL_CACHE_SIZE   64      // maximum number of free nodes of a pool cached by each thread
+#endif
+#ifndef SHARED_PTR_OBJECT_POOL_CACHES
+#define SHARED_PTR_OBJECT_POOL_CACHES       4       // number of pools cached at the same time by each thread
+#endif
+
+
+/**
+ * @brief free nodes of identical size (a control block and its object), shared by the object_pool and the blocks it created.
+ *
+ * Each thread caches up to SHARED_PTR_OBJECT_POOL_CACHE_SIZE free nodes of the last pools it used, without any lock,
+ * and exchanges them by batches of half its cache with a global free-list, protected by a mutex and bounded by max_free.
+ * The core is reference counted by the object_pool and by each node allocated from the heap (but not by the
+ * acquisitions of nodes already allocated), so that the objects can outlive their pool.
+ */
+class object_pool_core
+{
+public:
+    object_pool_core(std::size_t block_size, std::size_t max_free) noexcept : // never throws
+        refs(1),
+        closed(false),
+        size((block_size < sizeof(node)) ? sizeof(node) : block_size),
+        max_nb_free(max_free),
+        free_head(NULL),
+        nb_free(0)
+    {
+    }
+
+    /// @brief size of the nodes
+    std::size_t node_size(void) const noexcept // never throws
+    {
+        return size;
+    }
+    /// @brief number of nodes currently allocated from the heap (used, or free in the pool)
+    std::size_t allocated(void) const noexcept // never throws
+    {
+        return static_cast<std::size_t>(refs.load(std::memory_order_relaxed) - (closed.load(std::memory_order_relaxed) ? 0 : 1));
+    }
+
+    /// @brief get a free node from the cache of the current thread, a batch from the global free-list, or a new one
+    void* allocate(void) // may throw std::bad_alloc
+    {
+        cache* local = local_cache(this);
+        if (NULL != local)
+        {
+            if (NULL == local->head)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                while ((NULL != free_head) && (local->size < (SHARED_PTR_OBJECT_POOL_CACHE_SIZE / 2)))
+                {
+                    node* n = free_head;
+                    free_head = n->next;
+                    --nb_free;
+                    n->next = local->head;
+                    local->head = n;
+                    ++local->size;
+                }
+            }
+            if (NULL != local->head)
+            {
+                node* n = local->head;
+                local->head = n->next;
+                --local->size;
+                return n;
+            }
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (NULL != free_head)
+            {
+                node* n = free_head;
+                free_head = n->next;
+                --nb_free;
+                return n;
+            }
+        }
+        refs.fetch_add(1, std::memory_order_relaxed);
+        try
+        {
+            return ::operator new(size); // may throw std::bad_alloc
+        }
+        catch (...)
+        {
+            refs.fetch_sub(1, std::memory_order_relaxed);
+            throw;
+        }
+    }
+    /// @brief put back a node in the cache of the current thread, handing half of it to the global free-list when full
+    void deallocate(void* p) noexcept // never throws
+    {
+        node* n = static_cast<node*>(p);
+        n->next = NULL;
+        cache* local = closed.load(std::memory_order_relaxed) ? NULL : local_cache(this);
+        if (NULL != local)
+        {
+            n->next = local->head;
+            local->head = n;
+            ++local->size;
+            if (local->size >= SHARED_PTR_OBJECT_POOL_CACHE_SIZE)
+            {
+                node* batch = NULL;
+                for (std::size_t i = 0; i < (SHARED_PTR_OBJECT_POOL_CACHE_SIZE / 2); ++i)
+                {
+                    node* b = local->head;
+                    local->head = b->next;
+                    --local->size;
+                    b->next = batch;
+                    batch = b;
+                }
+                give_back(batch);
+            }
+        }
+        else
+        {
+            give_back(n);
+        }
+    }
+    /// @brief allocate nodes in advance in the global free-list, up to its bound
+    void reserve(std::size_t nb_nodes) // may throw std::bad_alloc
+    {
+        for (std::size_t i = 0; i < nb_nodes; ++i)
+        {
+            refs.fetch_add(1, std::memory_order_relaxed);
+            node* n = NULL;
+            try
+            {
+                n = static_cast<node*>(::operator new(size)); // may throw std::bad_alloc
+            }
+            catch (...)
+            {
+                refs.fetch_sub(1, std::memory_order_relaxed);
+                throw;
+            }
+            n->next = NULL;
+            give_back(n);
+        }
+    }
+    /// @brief the pool is destroyed: free the free nodes, the others being freed when released
+    void close(void) noexcept // never throws
+    {
+        node* nodes = NULL;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed.store(true, std::memory_order_relaxed);
+            nodes = free_head;
+            free_head = NULL;
+            nb_free = 0;
+        }
+        cache* local = local_cache(this);
+        if ((NULL != local) && (NULL != local->head))
+        {
+            node* last = local->head;
+            while (NULL != last->next)
+            {
+                last = last->next;
+            }
+            last->next = nodes;
+            nodes = local->head;
+            local->head = NULL;
+            local->size = 0;
+        }
+        free_nodes(nodes);
+        release(); // may destroy this core: do not touch it anymore
+    }
+
+private:
+    struct node
+    {
+        node*   next;   //!< Next free node
+    };
+    /// free nodes of a pool cached by a thread
+    struct cache
+    {
+        object_pool_core*   owner;  //!< Pool of the nodes (kept alive by them), or of the last ones if empty
+        node*               head;   //!< First free node
+        std::size_t         size;   //!< Number of free nodes
+    };
+    /// caches of the last pools used by a thread, handed back to their global free-list at the exit of the thread
+    struct thread_caches
+    {
+        thread_caches(void) noexcept // never throws
+        {
+            for (std::size_t i = 0; i < SHARED_PTR_OBJECT_POOL_CACHES; ++i)
+            {
+                caches[i].owner = NULL;
+                caches[i].head = NULL;
+                caches[i].size = 0;
+            }
+        }
+        ~thread_caches(void) noexcept // never throws
+        {
+            exited() = true; // nodes released later on by this thread go directly to the global free-list
+            for (std::size_t i = 0; i < SHARED_PTR_OBJECT_POOL_CACHES; ++i)
+            {
+                if (NULL != caches[i].head)
+                {
+                    caches[i].owner->give_back(caches[i].head); // may destroy the owner
+                    caches[i].head = NULL;
+                    caches[i].size = 0;
+                }
+            }
+        }
+        cache   caches[SHARED_PTR_OBJECT_POOL_CACHES];  //!< Cache of each pool
+    };
+
+    /// @brief cache of the provided pool for the current thread, if one is available
+    static cache* local_cache(object_pool_core* owner) noexcept // never throws
+    {
+        if (exited())
+        {
+            return NULL;
+        }
+        static thread_local thread_caches local;
+        for (std::size_t i = 0; i < SHARED_PTR_OBJECT_POOL_CACHES; ++i)
+        {
+            if (owner == local.caches[i].owner)
+            {
+                return &local.caches[i];
+            }
+        }
+        // an empty cache can be reused for another pool (its owner may even have been destroyed)
+        for (std::size_t i = 0; i < SHARED_PTR_OBJECT_POOL_CACHES; ++i)
+        {
+            if (NULL == local.caches[i].head)
+            {
+                local.caches[i].owner = owner;
+                return &local.caches[i];
+            }
+        }
+        return NULL;
+    }
+    static bool& exited(void) noexcept // never throws
+    {
+        static thread_local bool has_exited = false;
+        return has_exited;
+    }
+
+    /// @brief put back a list of nodes in the global free-list, freeing the ones beyond its bound
+    void give_back(node* nodes) noexcept // never throws
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // the free-list is not used anymore once the pool is closed (under the same lock)
+            while ((NULL != nodes) && (nb_free < max_nb_free) && !closed.load(std::memory_order_relaxed))
+            {
+                node* n = nodes;
+                nodes = n->next;
+                n->next = free_head;
+                free_head = n;
+                ++nb_free;
+            }
+        }
+        free_nodes(nodes); // may destroy this core: do not touch it anymore
+    }
+    /// @brief free a list of nodes, each one releasing its reference to the core
+    void free_nodes(node* nodes) noexcept // never throws
+    {
+        while (NULL != nodes)
+        {
+            node* n = nodes;
+            nodes = n->next;
+            ::operator delete(n);
+            release(); // the last node holds the last reference: only the list is used after it
+        }
+    }
+    void release(void) noexcept // never throws
+    {
+        if (1 == refs.fetch_sub(1, std::memory_order_acq_rel))
+        {
+            delete this;
+        }
+    }
+
+private:
+    std::atomic<long>   refs;           //!< The object_pool, and each node allocated from the heap
+    std::atomic<bool>   closed;         //!< The object_pool has been destroyed
+    const std::size_t   size;           //!< Size of the nodes
+    const std::size_t   max_nb_free;    //!< Maximum number of nodes in the global free-list
+    std::mutex          mutex;          //!< Protects the global free-list
+    node*               free_head;      //!< First node of the global free-list
+    std::size_t         nb_free;        //!< Number of nodes in the global free-list
+};
+
+
+/**
+ * @brief allocator of the control blocks of an object_pool, taking them from its free nodes.
+ *
+ * Stored in each control block, so that the last release gives the node back to the pool instead of deleting it.
+ */
+template<class T>
+class object_pool_allocator
+{
+public:
+    typedef T value_type;
+
+    explicit object_pool_allocator(object_pool_core* pool) noexcept : // never throws
+        core(pool)
+    {
+    }
+    template<class U>
+    object_pool_allocator(const object_pool_allocator<U>& alloc) noexcept : // never throws
+        core(alloc.core)
+    {
+    }
+    T* allocate(std::size_t n) // may throw std::bad_alloc
+    {
+        if ((1 == n) && (sizeof(T) <= core->node_size()))
+        {
+            return static_cast<T*>(core->allocate());
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T* p, std::size_t n) noexcept // never throws
+    {
+        if ((1 == n) && (sizeof(T) <= core->node_size()))
+        {
+            core->deallocate(p);
+        }
+        else
+        {
+            ::operator delete(p);
+        }
+    }
+
+private:
+    template<class U> friend class object_pool_allocator;
+    template<class U, class V> friend bool operator==(const object_pool_allocator<U>&, const object_pool_allocator<V>&) noexcept;
+
+    object_pool_core*   core;   //!< Free nodes of the pool
+};
+template<class T, class U> bool operator==(const object_pool_allocator<T>& l, const object_pool_allocator<U>& r) noexcept // never throws
+{
+    return (l.core == r.core);
+}
+template<class T, class U> bool operator!=(const object_pool_allocator<T>& l, const object_pool_allocator<U>& r) noexcept // never throws
+{
+    return !(l == r);
+}
+
+
+/**
+ * @brief pool of objects of type T managed by shared_ptr, recycling their memory and control block when released.
+ *
+ * acquire() constructs an object in place in a control block obtained from the pool (like allocate_shared()),
+ * and the last release of its shared_ptr destroys the object then gives the node back to the pool:
+ * a steady-state acquire/release traffic does not reach the heap, nor locks a mutex as long as each thread
+ * releases about as many objects as it acquires.
+ *
+ * The pool can be used concurrently by several threads, and destroyed before the objects it created:
+ * it then frees its free nodes, the other ones being freed when released (or at the exit of the threads caching them).
+ */
+template<class T>
+class object_pool
+{
+public:
+    /// The type of the managed objects
+    typedef T element_type;
+    /// The type of the allocator of the control blocks
+    typedef object_pool_allocator<T> allocator_type;
+    /// The type of the control blocks, with the object in place
+    typedef count_inplace<T, allocator_type> block_type;
+
+    /// @brief Constructor, keeping at most max_free free nodes in the global free-list (beyond the caches of the threads)
+    explicit object_pool(std::size_t max_free = SHARED_PTR_OBJECT_POOL_SIZE) : // may throw std::bad_alloc
+        core(new object_pool_core(sizeof(block_type), max_free))
+    {
+    }
+    /// @brief the destructor frees the free nodes, the objects still used being freed when released
+    ~object_pool(void) noexcept // never throws
+    {
+        core->close();
+    }
+
+    /**
+     * @brief create an object managed by a shared_ptr, in a free node of the pool if one is available
+     *
+     * @param[in] args  arguments forwarded to the constructor of T
+     */
+    template<class... Args>
+    shared_ptr<T> acquire(Args&&... args) // may throw std::bad_alloc or any exception of the T constructor
+    {
+        return ::allocate_shared<T>(allocator_type(core), std::forward<Args>(args)...);
+    }
+
+    /// @brief allocate up to n free nodes in advance, so that the first acquisitions do not reach the heap either
+    void reserve(std::size_t n) // may throw std::bad_alloc
+    {
+        core->reserve(n);
+    }
+    /// @brief number of nodes currently allocated from the heap, used or free
+    std::size_t allocated(void) const noexcept // never throws
+    {
+        return core->allocated();
+    }
+
+private:
+    // non-copyable
+    object_pool(const object_pool&);
+    object_pool& operator=(const object_pool&);
+
+private:
+    object_pool_core*   core;   //!< Free nodes of the pool, shared with the control blocks
+};
@@ -0,0 +1,437 @@
+/**
+ * @file  reclamation_domain.hpp
+ * @brief reclamation_domain is an epoch-based reclamation of the shared_ptr retired from lock-free structures,
+ *        whose nodes are read through guarded_ptr without any reference counting.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include "shared_ptr.hpp"
+
+#if !defined(SHARED_PTR_CPP11)
+#error "reclamation_domain requires C++11 <atomic> and thread_local"
+#endif
+#if !defined(SHARED_PTR_THREAD_SAFE)
+#error "reclamation_domain requires SHARED_PTR_THREAD_SAFE to be defined before including shared_ptr.hpp"
+#endif
+
+#include <atomic>
+#include <new>          // std::nothrow
+#include <thread>       // std::this_thread::yield
+#include <vector>
+
+#ifndef SHARED_PTR_RECLAIM_BATCH
+#define SHARED_PTR_RECLAIM_BATCH    64  // number of retirements of a thread between two attempts to reclaim them
+#endif
+
+template<class T> class guarded_ptr;
+
+/**
+ * @brief epoch-based reclamation of the objects retired from concurrent structures read without reference counting.
+ *
+ * The readers of a lock-free structure traverse its nodes through raw pointers (std::atomic<T*>) while pinned
+ * by a guard or a guarded_ptr: the outermost guard of a thread costs an atomic exchange on a cache line
+ * of its own, and the reference counters of the nodes are never touched.
+ * The writers keep the ownership of the nodes in shared_ptr, and retire() the shared_ptr of a node once unlinked:
+ * its reference is kept in a shared_ptr_count, in a list of the thread, until the global epoch has advanced twice,
+ * that is until all the readers that could still reach the node have left their guard.
+ * The reference is then released like any other: it destroys the node only if it was the last one,
+ * or defers its destruction to deferred_release::drain() while in a deferred_release::scope.
+ *
+ * The retirements of a thread are reclaimed every SHARED_PTR_RECLAIM_BATCH retirements and by reclaim(),
+ * and those still pending at the exit of the thread are handed to the next reclaim() of any thread.
+ * A guard should be short: while it is held, the objects retired by all the threads cannot be reclaimed.
+ */
+class reclamation_domain
+{
+    struct thread_state;
+
+public:
+    /**
+     * @brief pins the current thread in the current epoch while in scope (guards can be nested)
+     *
+     * The objects reached while pinned are not destroyed before the end of the outermost guard.
+     */
+    class guard
+    {
+    public:
+        guard(void) : // may throw std::bad_alloc (registration of the thread by its first guard)
+            state(enter())
+        {
+        }
+        ~guard(void) noexcept // never throws
+        {
+            leave(state);
+        }
+    private:
+        // non-copyable
+        guard(const guard&);
+        guard& operator=(const guard&);
+
+    private:
+        thread_state&   state;  //!< State of the pinned thread
+    };
+
+    /**
+     * @brief retire the shared_ptr of an object unlinked from a concurrent structure, resetting it
+     *
+     * Its reference is released once no pinned reader can reach the object anymore.
+     */
+    template<class T>
+    static void retire(shared_ptr<T>& ptr) // may throw std::bad_alloc (leaving ptr unchanged)
+    {
+        thread_state& state = local_state();
+        state.retired.push_back(retired_ref()); // may throw std::bad_alloc
+        // the readers that can still reach the object are pinned in this epoch or in the previous one
+        // (a read-modify-write reads the latest epoch, after the object has been unlinked)
+        state.retired.back().epoch = global_epoch().fetch_add(0, std::memory_order_seq_cst);
+        state.retired.back().references.swap(ptr.pn);
+        ptr.px = NULL;
+        if (SHARED_PTR_RECLAIM_BATCH <= ++state.nb_retired)
+        {
+            reclaim();
+        }
+    }
+
+    /// @brief advance the epoch if possible, and release the references retired two epochs ago, returning their number
+    static std::size_t reclaim(void) noexcept; // never throws
+
+private:
+    /// @brief reference of a retired shared_ptr, with the epoch of its retirement
+    struct retired_ref
+    {
+        retired_ref(void) noexcept : // never throws
+            epoch(0)
+        {
+        }
+        unsigned long                       epoch;      //!< Global epoch when retired
+        shared_ptr_count<default_threading> references; //!< Reference of the retired shared_ptr
+    };
+    typedef std::vector<retired_ref> retired_list;
+
+    /// @brief epoch of a thread, allocated once and reused by the next threads (never freed)
+    struct thread_record
+    {
+        thread_record(void) noexcept : // never throws
+            epoch(0),
+            in_use(true),
+            next(NULL)
+        {
+        }
+        std::atomic<unsigned long>  epoch;      //!< Global epoch in which the thread is pinned, 0 when not pinned
+        std::atomic<bool>           in_use;     //!< Owned by a running thread
+        thread_record*              next;       //!< Next record in the global list
+        unsigned char               padding[SHARED_PTR_CACHE_LINE_SIZE]; //!< Keep the epochs of different threads apart
+    };
+
+    /// @brief retirements of a thread that exited, in the global stack of the orphans
+    struct batch
+    {
+        batch*          next;       //!< Next batch in the global stack
+        retired_list    retired;    //!< References to release
+    };
+
+    struct thread_state
+    {
+        thread_state(void) noexcept : // never throws
+            record(NULL),
+            depth(0),
+            nb_retired(0),
+            reclaiming(false)
+        {
+        }
+        // give back the record, and hand the retirements still pending at the exit of the thread
+        ~thread_state(void)
+        {
+            if (NULL != record)
+            {
+                record->in_use.store(false, std::memory_order_release);
+            }
+            reclaim();
+            if (!retired.empty())
+            {
+                batch* b = new(std::nothrow) batch;
+                if (NULL != b)
+                {
+                    b->retired.swap(retired);
+                    push_orphans(b);
+                }
+                else
+                {
+                    while (!retired.empty()) // wait for the readers to leave their guards
+                    {
+                        std::this_thread::yield();
+                        reclaim();
+                    }
+                }
+            }
+        }
+        thread_record*  record;     //!< Epoch of the thread, registered by its first guard
+        int             depth;      //!< Number of nested guards
+        int             nb_retired; //!< Number of retirements since the last reclaim()
+        bool            reclaiming; //!< Releasing the references retired (which can retire others)
+        retired_list    retired;    //!< References retired by the thread, in order of epoch
+    };
+
+    static thread_state& enter(void); // may throw std::bad_alloc
+    static void leave(thread_state& state) noexcept; // never throws
+    static bool try_advance(void) noexcept; // never throws
+    static std::size_t release_retired(retired_list& retired, unsigned long epoch) noexcept; // never throws
+    static void push_orphans(batch* b) noexcept; // never throws
+
+    static thread_state& local_state(void) noexcept // never throws
+    {
+        static thread_local thread_state state;
+        return state;
+    }
+    static std::atomic<unsigned long>& global_epoch(void) noexcept // never throws
+    {
+        static std::atomic<unsigned long> epoch(1);
+        return epoch;
+    }
+    static std::atomic<thread_record*>& records(void) noexcept // never throws
+    {
+        static std::atomic<thread_record*> head(NULL);
+        return head;
+    }
+    static std::atomic<batch*>& orphans(void) noexcept // never throws
+    {
+        static std::atomic<batch*> head(NULL);
+        return head;
+    }
+
+    // guarded_ptr pins its thread while it points to an object
+    template<class U> friend class guarded_ptr;
+};
+
+inline reclamation_domain::thread_state& reclamation_domain::enter(void) // may throw std::bad_alloc
+{
+    thread_state& state = local_state();
+    if (0 == state.depth)
+    {
+        if (NULL == state.record)
+        {
+            // reuse the record of a thread that exited, or register a new one
+            for (thread_record* record = records().load(std::memory_order_acquire); NULL != record; record = record->next)
+            {
+                bool in_use = false;
+                if (!record->in_use.load(std::memory_order_relaxed)
+                 && record->in_use.compare_exchange_strong(in_use, true, std::memory_order_acquire))
+                {
+                    state.record = record;
+                    break;
+                }
+            }
+            if (NULL == state.record)
+            {
+                thread_record* record = new thread_record; // may throw std::bad_alloc
+                std::atomic<thread_record*>& head = records();
+                record->next = head.load(std::memory_order_relaxed);
+                while (!head.compare_exchange_weak(record->next, record, std::memory_order_release, std::memory_order_relaxed))
+                {
+                }
+                state.record = record;
+            }
+        }
+        // announce the epoch before reading the structure (a full barrier): the advance of the epoch will wait for this thread
+        state.record->epoch.exchange(global_epoch().load(std::memory_order_relaxed), std::memory_order_seq_cst);
+    }
+    ++state.depth;
+    return state;
+}
+
+inline void reclamation_domain::leave(thread_state& state) noexcept // never throws
+{
+    SHARED_ASSERT(0 < state.depth);
+    if (0 == --state.depth)
+    {
+        // the reads of the structure are done before this thread is seen unpinned
+        state.record->epoch.store(0, std::memory_order_release);
+    }
+}
+
+inline bool reclamation_domain::try_advance(void) noexcept // never throws
+{
+    unsigned long epoch = global_epoch().load(std::memory_order_seq_cst);
+    for (thread_record* record = records().load(std::memory_order_acquire); NULL != record; record = record->next)
+    {
+        const unsigned long pinned = record->epoch.load(std::memory_order_seq_cst);
+        if ((0 != pinned) && (epoch != pinned))
+        {
+            return false; // a reader is still pinned in the previous epoch
+        }
+    }
+    return global_epoch().compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel, std::memory_order_relaxed);
+}
+
+inline std::size_t reclamation_domain::release_retired(retired_list& retired, unsigned long epoch) noexcept // never throws
+{
+    // the retirements are in order of epoch: release the ones made two epochs ago
+    // (but not the ones made meanwhile by the destructors of the objects, in a later epoch)
+    std::size_t nb_released = 0;
+    while ((nb_released < retired.size()) && (2 <= static_cast<long>(epoch - retired[nb_released].epoch)))
+    {
+        shared_ptr_count<default_threading> references;
+        references.swap(retired[nb_released].references);
+        references.release(); // the destructor of the object can retire others, at the end of the list
+        ++nb_released;
+    }
+    retired.erase(retired.begin(), retired.begin() + static_cast<std::ptrdiff_t>(nb_released));
+    return nb_released;
+}
+
+inline void reclamation_domain::push_orphans(batch* b) noexcept // never throws
+{
+    std::atomic<batch*>& head = orphans();
+    b->next = head.load(std::memory_order_relaxed);
+    while (!head.compare_exchange_weak(b->next, b, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+}
+
+inline std::size_t reclamation_domain::reclaim(void) noexcept // never throws
+{
+    try_advance();
+    const unsigned long epoch = global_epoch().load(std::memory_order_acquire);
+    std::size_t nb_released = 0;
+
+    thread_state& state = local_state();
+    if (!state.reclaiming)
+    {
+        state.reclaiming = true;
+        state.nb_retired = 0;
+        nb_released += release_retired(state.retired, epoch);
+        state.reclaiming = false;
+    }
+
+    // the retirements of the threads that exited
+    batch* b = orphans().exchange(NULL, std::memory_order_acquire);
+    while (NULL != b)
+    {
+        batch* next = b->next;
+        nb_released += release_retired(b->retired, epoch);
+        if (b->retired.empty())
+        {
+            delete b;
+        }
+        else
+        {
+            push_orphans(b);
+        }
+        b = next;
+    }
+    return nb_released;
+}
+
+
+/**
+ * @brief read handle on a node of a concurrent structure, protected from reclamation without reference counting.
+ *
+ * Loading a guarded_ptr from a std::atomic<T*> pins the current thread (see reclamation_domain::guard)
+ * while it points to an object: the object cannot be destroyed until the guarded_ptr is released,
+ * even if it is unlinked and retired meanwhile. A guarded_ptr must be released by the thread that loaded it.
+ */
+template<class T>
+class guarded_ptr
+{
+public:
+    /// The type of the managed object
+    typedef T element_type;
+
+    /// @brief Default constructor
+    constexpr guarded_ptr(void) noexcept : // never throws
+        px(NULL)
+    {
+    }
+    /// @brief Load the pointer published by a concurrent structure, pinning the current thread while it points to an object
+    explicit guarded_ptr(const std::atomic<T*>& source) : // may throw std::bad_alloc (registration of the thread by its first guard)
+        px(NULL)
+    {
+        reclamation_domain::thread_state& state = reclamation_domain::enter();
+        px = source.load(std::memory_order_acquire);
+        if (NULL == px)
+        {
+            reclamation_domain::leave(state); // nothing to protect
+        }
+    }
+    /// @brief Copy constructor, nesting a guard on the same thread
+    guarded_ptr(const guarded_ptr& ptr) noexcept : // never throws (the thread is already registered)
+        px(ptr.px)
+    {
+        if (NULL != px)
+        {
+            reclamation_domain::enter();
+        }
+    }
+    /// @brief Move constructor, stealing the guard
+    guarded_ptr(guarded_ptr&& ptr) noexcept : // never throws
+        px(ptr.px)
+    {
+        ptr.px = NULL;
+    }
+    /// @brief Assignment operator using the copy-and-swap idiom (copy constructor and swap method)
+    guarded_ptr& operator=(guarded_ptr ptr) noexcept // never throws
+    {
+        swap(ptr);
+        return *this;
+    }
+    /// @brief the destructor releases its guard
+    ~guarded_ptr(void) noexcept // never throws
+    {
+        if (NULL != px)
+        {
+            reclamation_domain::leave(reclamation_domain::local_state());
+        }
+    }
+    /// @brief this reset releases its guard
+    void reset(void) noexcept // never throws
+    {
+        guarded_ptr().swap(*this);
+    }
+
+    /// @brief Swap method for the copy-and-swap idiom (copy constructor and swap method)
+    void swap(guarded_ptr& lhs) noexcept // never throws
+    {
+        std::swap(px, lhs.px);
+    }
+
+    operator bool() const noexcept // never throws
+    {
+        return (NULL != px);
+    }
+
+    // underlying pointer operations :
+    T& operator*()  const noexcept // never throws
+    {
+        SHARED_ASSERT(NULL != px);
+        return *px;
+    }
+    T* operator->() const noexcept // never throws
+    {
+        SHARED_ASSERT(NULL != px);
+        return px;
+    }
+    T* get(void)  const noexcept // never throws
+    {
+        // no assert, can return NULL
+        return px;
+    }
+
+private:
+    T*  px; //!< Native pointer, the thread being pinned while not NULL
+};
+
+
+// comparaison operators
+template<class T, class U> bool operator==(const guarded_ptr<T>& l, const guarded_ptr<U>& r) noexcept // never throws
+{
+    return (l.get() == r.get());
+}
+template<class T, class U> bool operator!=(const guarded_ptr<T>& l, const guarded_ptr<U>& r) noexcept // never throws
+{
+    return (l.get() != r.get());
+}
@@ -0,0 +1,80 @@
+/**
+ * @file  shared_assert.hpp
+ * @brief SHARED_ASSERT() checks the preconditions of the smart pointers, with a configurable level and handler.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+// level of the checks, to define before including any header of the library:
+// - 0 (off) compiles all the checks out, without evaluating their expression,
+// - 1 (cheap) checks only the preconditions of the user API (dereference of a NULL pointer, auto-reset),
+// - 2 (full) also checks the internal invariants.
+// Defaults to full, or off if NDEBUG is defined (like assert()).
+#ifndef SHARED_ASSERT_LEVEL
+#ifdef NDEBUG
+#define SHARED_ASSERT_LEVEL 0
+#else
+#define SHARED_ASSERT_LEVEL 2
+#endif
+#endif
+
+// branch prediction hints for the failure of a check
+#if defined(__GNUC__)
+#define SHARED_EXPECT_FALSE(x)  __builtin_expect(!!(x), 0)
+#else
+#define SHARED_EXPECT_FALSE(x)  (x)
+#endif
+#if (__cplusplus >= 202002L) || (defined(_MSVC_LANG) && (_MSVC_LANG >= 202002L))
+#define SHARED_UNLIKELY         [[unlikely]]
+#else
+#define SHARED_UNLIKELY
+#endif
+
+// name of the current function, reported to the handler
+#if (__cplusplus >= 201103L) || (defined(_MSC_VER) && (_MSC_VER >= 1900))
+#define SHARED_CURRENT_FUNCTION __func__
+#elif defined(__GNUC__) || defined(_MSC_VER)
+#define SHARED_CURRENT_FUNCTION __FUNCTION__
+#else
+#define SHARED_CURRENT_FUNCTION ""
+#endif
+
+#if SHARED_ASSERT_LEVEL > 0
+#ifdef SHARED_ASSERT_HANDLER
+/**
+ * @brief user-provided handler of the failed checks (like boost::assertion_failed), to be defined by the application.
+ *
+ * It is called from functions that never throw: it can log and return, or abort, but shall not throw.
+ */
+void shared_assertion_failed(const char* expr, const char* function, const char* file, long line);
+#else
+#include <cstdio>       // std::fprintf
+#include <cstdlib>      // std::abort
+/// @brief default handler of the failed checks, reporting the expression and aborting (even if NDEBUG is defined)
+inline void shared_assertion_failed(const char* expr, const char* function, const char* file, long line)
+{
+    std::fprintf(stderr, "%s:%ld: %s: Assertion `%s' failed.\n", file, line, function, expr);
+    std::abort();
+}
+#endif
+#define SHARED_ASSERT_CHECK(x, expr) \
+    do { if (SHARED_EXPECT_FALSE(!(x))) SHARED_UNLIKELY { shared_assertion_failed(expr, SHARED_CURRENT_FUNCTION, __FILE__, __LINE__); } } while (false)
+#endif
+
+/// check a precondition of the user API (SHARED_ASSERT_LEVEL >= 1)
+#if SHARED_ASSERT_LEVEL >= 1
+#define SHARED_ASSERT(x)        SHARED_ASSERT_CHECK(x, #x)
+#else
+#define SHARED_ASSERT(x)        static_cast<void>(0)
+#endif
+
+/// check an internal invariant (SHARED_ASSERT_LEVEL >= 2)
+#if SHARED_ASSERT_LEVEL >= 2
+#define SHARED_ASSERT_FULL(x)   SHARED_ASSERT_CHECK(x, #x)
+#else
+#define SHARED_ASSERT_FULL(x)   static_cast<void>(0)
+#endif
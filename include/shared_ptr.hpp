@@ -11,284 +11,2451 @@
 
 #include <cstddef>      // NULL
 #include <algorithm>    // std::swap
+#include <new>          // std::bad_alloc, placement new
+#include <memory>       // std::allocator, std::allocator_traits
+#include <iterator>     // std::iterator_traits
 
-// can be replaced by other error mechanism
-#include <cassert>
-#define SHARED_ASSERT(x)    assert(x)
+// checks with a configurable level and handler (SHARED_ASSERT_LEVEL, SHARED_ASSERT_HANDLER)
+#include "shared_assert.hpp"
 
+// detect a C++11 compiler (MSVC does not report its real __cplusplus value by default)
+#if !defined(SHARED_PTR_CPP11) && ((__cplusplus >= 201103L) || (defined(_MSC_VER) && (_MSC_VER >= 1900)))
+#define SHARED_PTR_CPP11
+#endif
+
+// noexcept and constexpr with a C++11 compiler, fallback to a dynamic exception specification on older compilers
+#ifndef SHARED_NOEXCEPT
+#ifdef SHARED_PTR_CPP11
+#define SHARED_NOEXCEPT     noexcept
+#define SHARED_CONSTEXPR    constexpr
+#else
+#define SHARED_NOEXCEPT     throw()
+#define SHARED_CONSTEXPR
+#endif
+#endif
+
+// final control blocks with a C++11 compiler, so that their virtual functions are devirtualized
+#ifndef SHARED_FINAL
+#ifdef SHARED_PTR_CPP11
+#define SHARED_FINAL        final
+#else
+#define SHARED_FINAL
+#endif
+#endif
+
+#ifdef SHARED_PTR_CPP11
+#include <utility>      // std::forward, std::move
+#include <type_traits>  // std::is_class, std::is_final
+#include <functional>   // std::hash
+#endif
+
+// opt-in per-thread pool of control blocks: define SHARED_PTR_POOL before including this header (requires C++11)
+#if defined(SHARED_PTR_POOL) && !defined(SHARED_PTR_CPP11)
+#error "SHARED_PTR_POOL requires C++11 thread_local"
+#endif
+#ifndef SHARED_PTR_POOL_SIZE
+#define SHARED_PTR_POOL_SIZE    256 // maximum number of free control blocks of each size kept by each thread
+#endif
+
+// size of the cache lines separating the reference counters from the object with the padded_layout of make_shared()
+// (std::hardware_destructive_interference_size depends on the tuning flags of GCC, which warns against its use in headers)
+#ifndef SHARED_PTR_CACHE_LINE_SIZE
+#if defined(__cpp_lib_hardware_interference_size) && !defined(__GNUC__)
+#define SHARED_PTR_CACHE_LINE_SIZE  std::hardware_destructive_interference_size
+#else
+#define SHARED_PTR_CACHE_LINE_SIZE  64
+#endif
+#endif
+
+// the reference counters are updated either atomically or not, depending on the threading policy of each shared_ptr
+#include "atomic_count.hpp"
+
+// opt-in biased reference counting: define SHARED_PTR_BIASED and SHARED_PTR_THREAD_SAFE before including this header (requires C++11)
+#ifdef SHARED_PTR_BIASED
+#if !defined(SHARED_PTR_CPP11) || !defined(SHARED_PTR_THREAD_SAFE)
+#error "SHARED_PTR_BIASED requires C++11 thread_local and SHARED_PTR_THREAD_SAFE"
+#endif
+#include "biased_count.hpp"
+#endif
+
+// opt-in deferred release of the objects: define SHARED_PTR_DEFERRED_RELEASE before including this header (requires C++11)
+#ifdef SHARED_PTR_DEFERRED_RELEASE
+#ifndef SHARED_PTR_CPP11
+#error "SHARED_PTR_DEFERRED_RELEASE requires C++11 thread_local and <atomic>"
+#endif
+#ifndef SHARED_PTR_DEFERRED_BATCH
+#define SHARED_PTR_DEFERRED_BATCH   64  // number of deferred releases of a thread handed together to drain()
+#endif
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#endif
+
+// opt-in instrumentation of the reference counting: define SHARED_PTR_STATS before including this header (requires C++11)
+#ifdef SHARED_PTR_STATS
+#ifndef SHARED_PTR_CPP11
+#error "SHARED_PTR_STATS requires C++11 thread_local and <atomic>"
+#endif
+#include "shared_ptr_stats.hpp"
+#endif
+
+
+#ifdef SHARED_PTR_CPP11
+/**
+ * @brief per-thread free-lists recycling the memory of the control blocks, by classes of size.
+ *
+ * Each thread keeps up to SHARED_PTR_POOL_SIZE free blocks of each class of size (multiples of 16 bytes, up to 128),
+ * so that a steady-state allocation pattern does not reach the global allocator
+ * (nor contend on its lock). A block freed by another thread than the one that allocated it
+ * simply goes to the free-list of the releasing thread. Bigger blocks use the global allocator.
+ */
+class count_pool
+{
+public:
+    /// @brief get a block from the free-list of the current thread, or allocate a new one
+    static void* allocate(std::size_t size) // may throw std::bad_alloc
+    {
+        if (size <= max_size)
+        {
+            free_list& list = local_lists().lists[size_class(size)];
+            node* p = list.head;
+            if (NULL != p)
+            {
+                list.head = p->next;
+                --list.size;
+                return p;
+            }
+            size = (size_class(size) + 1) * granularity; // allocate the full class of size
+        }
+        return ::operator new(size); // may throw std::bad_alloc
+    }
+    /// @brief put back a block in the free-list of the current thread, or free it if the list is full
+    static void deallocate(void* p, std::size_t size) SHARED_NOEXCEPT // never throws
+    {
+        if (size <= max_size)
+        {
+            free_list& list = local_lists().lists[size_class(size)];
+            if (list.size < SHARED_PTR_POOL_SIZE)
+            {
+                node* n = static_cast<node*>(p);
+                n->next = list.head;
+                list.head = n;
+                ++list.size;
+                return;
+            }
+        }
+        ::operator delete(p);
+    }
+
+private:
+    static const std::size_t granularity    = 16;   //!< Step between two classes of size
+    static const std::size_t nb_classes     = 8;    //!< Number of classes of size
+    static const std::size_t max_size       = granularity * nb_classes;
+
+    struct node
+    {
+        node*   next;   //!< Next free block
+    };
+    struct free_list
+    {
+        node*       head;   //!< First free block
+        std::size_t size;   //!< Number of free blocks
+    };
+    struct thread_lists
+    {
+        thread_lists(void) SHARED_NOEXCEPT
+        {
+            for (std::size_t i = 0; i < nb_classes; ++i)
+            {
+                lists[i].head = NULL;
+                lists[i].size = 0;
+            }
+        }
+        // free the blocks at the exit of the thread
+        ~thread_lists(void) SHARED_NOEXCEPT
+        {
+            for (std::size_t i = 0; i < nb_classes; ++i)
+            {
+                while (NULL != lists[i].head)
+                {
+                    node* p = lists[i].head;
+                    lists[i].head = p->next;
+                    ::operator delete(p);
+                }
+                lists[i].size = SHARED_PTR_POOL_SIZE; // blocks released later on by this thread are freed directly
+            }
+        }
+        free_list   lists[nb_classes];  //!< One free-list for each class of size
+    };
+
+    static std::size_t size_class(std::size_t size) SHARED_NOEXCEPT // never throws
+    {
+        return (size <= granularity) ? 0 : ((size - 1) / granularity);
+    }
+    static thread_lists& local_lists(void) SHARED_NOEXCEPT // never throws
+    {
+        static thread_local thread_lists lists;
+        return lists;
+    }
+};
+#endif // SHARED_PTR_CPP11
+
+
+/**
+ * @brief threading policy of a shared_ptr<T, single_threaded>, updating the reference counters without atomic operation.
+ *
+ * With the GCC/Clang __atomic builtins the counters are plain longs, so that the increment of a copy
+ * and the decrement of its destruction can be combined (or removed altogether) by the compiler.
+ *
+ * All the shared_ptr and weak_ptr sharing the ownership of an object with a single_threaded pointer
+ * must be used by the same thread (or synchronized externally).
+ */
+struct single_threaded
+{
+    static void increment(atomic_count& count) SHARED_NOEXCEPT // never throws
+    {
+        count.set_plain(count.get_plain() + 1);
+    }
+    static long decrement(atomic_count& count) SHARED_NOEXCEPT // never throws
+    {
+        const long value = count.get_plain() - 1;
+        count.set_plain(value);
+        return value;
+    }
+    static long load(const atomic_count& count) SHARED_NOEXCEPT // never throws
+    {
+        return count.get_plain();
+    }
+    static void add(atomic_count& count, long n) SHARED_NOEXCEPT // never throws
+    {
+        count.set_plain(count.get_plain() + n);
+    }
+    static long subtract(atomic_count& count, long n) SHARED_NOEXCEPT // never throws
+    {
+        const long value = count.get_plain() - n;
+        count.set_plain(value);
+        return value;
+    }
+    static bool increment_if_not_zero(atomic_count& count) SHARED_NOEXCEPT // never throws
+    {
+        const long value = count.get_plain();
+        if (0 == value)
+        {
+            return false;
+        }
+        count.set_plain(value + 1);
+        return true;
+    }
+};
+
+/**
+ * @brief threading policy of a shared_ptr<T, multi_threaded>, updating the reference counters with atomic operations,
+ *        so that copies of a shared_ptr can be used concurrently by different threads.
+ */
+struct multi_threaded
+{
+    static void increment(atomic_count& count) SHARED_NOEXCEPT // never throws
+    {
+        count.increment();
+    }
+    static long decrement(atomic_count& count) SHARED_NOEXCEPT // never throws
+    {
+        return count.decrement();
+    }
+    static long load(const atomic_count& count) SHARED_NOEXCEPT // never throws
+    {
+        return count.get_acquire();
+    }
+    static void add(atomic_count& count, long n) SHARED_NOEXCEPT // never throws
+    {
+        count.add(n);
+    }
+    static long subtract(atomic_count& count, long n) SHARED_NOEXCEPT // never throws
+    {
+        return count.subtract(n);
+    }
+    static bool increment_if_not_zero(atomic_count& count) SHARED_NOEXCEPT // never throws
+    {
+        return count.increment_if_not_zero();
+    }
+};
+
+/**
+ * @brief policy of a shared_ptr<T, immortal>, not counted at all: for static objects, never deleted.
+ *
+ * Copying or releasing it never touches a reference counter, and it takes no control block for a raw pointer.
+ * Converting a counted shared_ptr to an immortal one takes a reference that is never released.
+ */
+struct immortal
+{
+};
+
+/// default threading policy of shared_ptr<T>: multi_threaded if SHARED_PTR_THREAD_SAFE is defined, single_threaded otherwise
+#ifdef SHARED_PTR_THREAD_SAFE
+typedef multi_threaded  default_threading;
+#else
+typedef single_threaded default_threading;
+#endif
+
+
+#ifdef SHARED_PTR_DEFERRED_RELEASE
+class count_base;
+
+/**
+ * @brief queue of the objects whose last reference has been released, to be destroyed later by drain().
+ *
+ * While a deferred_release::scope is alive on a thread, the last releases made by this thread
+ * do not destroy the objects inline but push their control blocks to a per-thread batch (no atomic operation).
+ * Each full batch is then handed to a global lock-free stack (a single compare-and-swap per batch),
+ * and drain() destroys all the objects handed so far, typically from a background deferred_release::thread.
+ *
+ * A deferred object is expired as soon as its last shared_ptr is released (weak_ptr::lock() fails),
+ * only its destructor is delayed. Drain from another thread requires SHARED_PTR_THREAD_SAFE.
+ */
+class deferred_release
+{
+public:
+    /**
+     * @brief defers the last releases made by the current thread while in scope (scopes can be nested)
+     *
+     * The pending releases are handed to drain() at the end of the outermost scope.
+     */
+    class scope
+    {
+    public:
+        scope(void) SHARED_NOEXCEPT // never throws
+        {
+            ++local_queue().depth;
+        }
+        ~scope(void) SHARED_NOEXCEPT // never throws
+        {
+            if (0 == --local_queue().depth)
+            {
+                flush();
+            }
+        }
+    private:
+        // non-copyable
+        scope(const scope&);
+        scope& operator=(const scope&);
+    };
+
+    /**
+     * @brief background thread calling drain() periodically, until destroyed (which drains one last time)
+     */
+    class thread
+    {
+    public:
+        explicit thread(std::chrono::milliseconds period = std::chrono::milliseconds(10)) : // may throw std::system_error
+            stop(false),
+            worker(&thread::run, this, period)
+        {
+        }
+        ~thread(void)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            condition.notify_one();
+            worker.join();
+        }
+    private:
+        void run(std::chrono::milliseconds period)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stop)
+            {
+                lock.unlock();
+                drain();
+                lock.lock();
+                condition.wait_for(lock, period);
+            }
+            lock.unlock();
+            drain();
+        }
+        // non-copyable
+        thread(const thread&);
+        thread& operator=(const thread&);
+
+    private:
+        std::mutex              mutex;      //!< Protect the stop flag
+        std::condition_variable condition;  //!< Wake up the worker to stop it
+        bool                    stop;       //!< Ask the worker to stop
+        std::thread             worker;     //!< Thread draining the releases
+    };
+
+    /// @brief queue the last release of a control block if deferral is enabled on the current thread (used by count_base)
+    static bool defer(count_base* block) SHARED_NOEXCEPT; // never throws
+    /// @brief hand the pending releases of the current thread to drain()
+    static void flush(void) SHARED_NOEXCEPT; // never throws
+    /// @brief destroy all the objects handed to drain() so far, returning their number
+    static std::size_t drain(void) SHARED_NOEXCEPT; // never throws
+
+private:
+    struct batch
+    {
+        batch*                  next;   //!< Next batch in the global stack
+        std::vector<count_base*> blocks; //!< Control blocks of the objects to destroy
+    };
+    struct thread_queue
+    {
+        thread_queue(void) :
+            depth(0)
+        {
+        }
+        // hand the releases still pending at the exit of the thread
+        ~thread_queue(void)
+        {
+            flush();
+            depth = 0;
+        }
+        int                         depth;      //!< Number of nested scopes
+        std::vector<count_base*>    pending;    //!< Control blocks of the objects to destroy
+    };
+
+    static thread_queue& local_queue(void) SHARED_NOEXCEPT // never throws
+    {
+        static thread_local thread_queue queue;
+        return queue;
+    }
+    static std::atomic<batch*>& global_stack(void) SHARED_NOEXCEPT // never throws
+    {
+        static std::atomic<batch*> head(NULL);
+        return head;
+    }
+};
+#endif // SHARED_PTR_DEFERRED_RELEASE
+
+
+/**
+ * @brief base class of the control block holding the reference counters of a managed object.
+ *
+ * The derived classes know how to dispose of the object they manage:
+ * - count_impl<X> deletes an object allocated separately with new,
+ * - count_impl_pd<P, D> releases an object with a custom deleter,
+ * - count_inplace<T, A, L> destroys an object constructed in place inside the control block by make_shared().
+ *
+ * The weak counter is the number of weak_ptr, plus one for all the shared_ptr together:
+ * the object is disposed of when the last shared_ptr is released,
+ * but the control block itself is destroyed only when the last weak_ptr is released.
+ *
+ * The counters are updated with the primitives of the threading policy of the shared_ptr (default_threading
+ * for the ones without template argument), except the biased counter which is always biased.
+ */
+#ifdef SHARED_PTR_BIASED
+class count_base : private biased_count
+#else
+class count_base
+#endif
+{
+public:
+    count_base(void) SHARED_NOEXCEPT : // never throws
+#ifdef SHARED_PTR_BIASED
+        biased_count(),
+#else
+        count(1),
+#endif
+        weak_count(1)
+    {
+#ifdef SHARED_PTR_STATS
+        stats.type = NULL;
+#endif
+    }
+    virtual ~count_base(void) SHARED_NOEXCEPT // never throws
+    {
+    }
+#ifdef SHARED_PTR_STATS
+    /// @brief record the statistics of the control block in the ones of the type of its managed object
+    void track(shared_ptr_stats::type_stats& type) SHARED_NOEXCEPT // never throws
+    {
+        shared_ptr_stats::on_create(stats, type);
+    }
+#endif
+    /// @brief share the ownership of the managed object
+    template<class Policy>
+    void add_ref(void) SHARED_NOEXCEPT // never throws
+    {
+#ifdef SHARED_PTR_BIASED
+        increment();
+#else
+        Policy::increment(count);
+#endif
+#ifdef SHARED_PTR_STATS
+        shared_ptr_stats::on_increment(stats, use_count());
+#endif
+    }
+    void add_ref(void) SHARED_NOEXCEPT // never throws
+    {
+        add_ref<default_threading>();
+    }
+    /// @brief share the ownership of the managed object n times, with a single operation (used by share_n())
+    template<class Policy>
+    void add_ref(long n) SHARED_NOEXCEPT // never throws
+    {
+#ifdef SHARED_PTR_BIASED
+        increment(n);
+#else
+        Policy::add(count, n);
+#endif
+#ifdef SHARED_PTR_STATS
+        shared_ptr_stats::on_increment(stats, use_count());
+#endif
+    }
+    /// @brief share the ownership of the managed object only if it is still alive (used by weak_ptr::lock())
+    bool add_ref_lock(void) SHARED_NOEXCEPT // never throws
+    {
+#ifdef SHARED_PTR_BIASED
+        const bool locked = increment_if_not_zero();
+#else
+        const bool locked = default_threading::increment_if_not_zero(count);
+#endif
+#ifdef SHARED_PTR_STATS
+        if (locked)
+        {
+            shared_ptr_stats::on_increment(stats, use_count());
+        }
+#endif
+        return locked;
+    }
+    /// @brief release the ownership of the managed object, disposing of it with the last reference
+    template<class Policy>
+    void release(void) SHARED_NOEXCEPT // never throws
+    {
+#ifdef SHARED_PTR_STATS
+        shared_ptr_stats::on_decrement(stats); // before the decrement, which may let another thread destroy the block
+#endif
+#ifdef SHARED_PTR_BIASED
+        if (0 == decrement())
+#else
+        if (0 == Policy::decrement(count))
+#endif
+        {
+            last_release<Policy>();
+        }
+    }
+    void release(void) SHARED_NOEXCEPT // never throws
+    {
+        release<default_threading>();
+    }
+    /// @brief release n references with a single operation, disposing of the object with the last one (used by release_all())
+    template<class Policy>
+    void release(long n) SHARED_NOEXCEPT // never throws
+    {
+#ifdef SHARED_PTR_STATS
+        shared_ptr_stats::on_decrement(stats); // before the decrement, which may let another thread destroy the block
+#endif
+#ifdef SHARED_PTR_BIASED
+        // the biased counter splits the references between the owner and the other threads: release them one by one
+        bool last = false;
+        for (; 0 < n; --n)
+        {
+            last = (0 == decrement());
+        }
+        if (last)
+#else
+        if (0 == Policy::subtract(count, n))
+#endif
+        {
+            last_release<Policy>();
+        }
+    }
+    /// @brief add a weak reference, keeping the control block alive
+    void weak_add_ref(void) SHARED_NOEXCEPT // never throws
+    {
+        default_threading::increment(weak_count);
+    }
+    /// @brief release a weak reference, destroying the control block with the last one
+    template<class Policy>
+    void weak_release(void) SHARED_NOEXCEPT // never throws
+    {
+        if (0 == Policy::decrement(weak_count))
+        {
+            destroy();
+        }
+    }
+    void weak_release(void) SHARED_NOEXCEPT // never throws
+    {
+        weak_release<default_threading>();
+    }
+    /// @brief getter of the reference counter
+    long use_count(void) const SHARED_NOEXCEPT // never throws
+    {
+#ifdef SHARED_PTR_BIASED
+        return get();
+#else
+        return count.get();
+#endif
+    }
+    /// @brief destroy the managed object, when the last reference is released
+    virtual void dispose(void) SHARED_NOEXCEPT = 0; // never throws
+    /// @brief free the control block itself, after the managed object has been disposed of
+    virtual void destroy(void) SHARED_NOEXCEPT // never throws
+    {
+        delete this;
+    }
+    /**
+     * @brief destroy the managed object and free the control block, when the last reference is released without any weak_ptr
+     *
+     * A single virtual call, overridden by the final control blocks so that their dispose() and destroy() are inlined.
+     */
+    virtual void dispose_and_destroy(void) SHARED_NOEXCEPT // never throws
+    {
+        dispose();
+        destroy();
+    }
+
+#ifdef SHARED_PTR_POOL
+    // recycle the control blocks allocated with new through the per-thread pool
+    static void* operator new(std::size_t size) // may throw std::bad_alloc
+    {
+        return count_pool::allocate(size);
+    }
+    static void operator delete(void* p, std::size_t size) SHARED_NOEXCEPT // never throws
+    {
+        count_pool::deallocate(p, size);
+    }
+#endif
+
+private:
+    /// @brief dispose of the managed object, after the last reference has been released
+    template<class Policy>
+    void last_release(void) SHARED_NOEXCEPT // never throws
+    {
+#ifdef SHARED_PTR_STATS
+        shared_ptr_stats::on_expire(stats);
+#endif
+#ifdef SHARED_PTR_DEFERRED_RELEASE
+        if (deferred_release::defer(this))
+        {
+            return; // destroyed later by deferred_release::drain()
+        }
+#endif
+        if (1 == Policy::load(weak_count))
+        {
+            // no weak_ptr: no other thread can reach the control block anymore, the weak reference is not decremented
+            dispose_and_destroy();
+        }
+        else
+        {
+            dispose();
+            weak_release<Policy>();
+        }
+    }
+#ifdef SHARED_PTR_BIASED
+    /// @brief the last reference has been released by the merge of the biased counter
+    virtual void biased_release(void) SHARED_NOEXCEPT // never throws
+    {
+        last_release<multi_threaded>();
+    }
+#endif
+
+private:
+#ifdef SHARED_PTR_BIASED
+    atomic_count    weak_count; //!< Weak reference counter (+1 while the biased counter != 0)
+#else
+    atomic_count    count;      //!< Reference counter, updated atomically or not by the threading policy
+    atomic_count    weak_count; //!< Weak reference counter (+1 while count != 0)
+#endif
+#ifdef SHARED_PTR_STATS
+    shared_ptr_stats::block_stats stats; //!< Instrumentation of the reference counting
+#endif
+
+private:
+    // non-copyable
+    count_base(const count_base&);
+    count_base& operator=(const count_base&);
+};
+
+#ifdef SHARED_PTR_DEFERRED_RELEASE
+inline bool deferred_release::defer(count_base* block) SHARED_NOEXCEPT // never throws
+{
+    thread_queue& queue = local_queue();
+    if (0 == queue.depth)
+    {
+        return false;
+    }
+    try
+    {
+        queue.pending.push_back(block); // may throw std::bad_alloc
+    }
+    catch (std::bad_alloc&)
+    {
+        return false; // release inline
+    }
+    if (SHARED_PTR_DEFERRED_BATCH <= queue.pending.size())
+    {
+        flush();
+    }
+    return true;
+}
+
+inline void deferred_release::flush(void) SHARED_NOEXCEPT // never throws
+{
+    thread_queue& queue = local_queue();
+    if (!queue.pending.empty())
+    {
+        batch* b = new(std::nothrow) batch;
+        if (NULL != b)  // else keep the releases pending until the next flush
+        {
+            b->blocks.swap(queue.pending);
+            std::atomic<batch*>& head = global_stack();
+            b->next = head.load(std::memory_order_relaxed);
+            while (!head.compare_exchange_weak(b->next, b, std::memory_order_release, std::memory_order_relaxed))
+            {
+            }
+        }
+    }
+}
+
+inline std::size_t deferred_release::drain(void) SHARED_NOEXCEPT // never throws
+{
+    std::size_t nb_released = 0;
+    batch* b = global_stack().exchange(NULL, std::memory_order_acquire);
+    while (NULL != b)
+    {
+        for (std::size_t i = 0; i < b->blocks.size(); ++i)
+        {
+            b->blocks[i]->dispose();
+            b->blocks[i]->weak_release();
+        }
+        nb_released += b->blocks.size();
+        batch* next = b->next;
+        delete b;
+        b = next;
+    }
+    return nb_released;
+}
+#endif // SHARED_PTR_DEFERRED_RELEASE
+
+#ifdef SHARED_PTR_CPP11
+/**
+ * @brief minimal allocator using the per-thread count_pool for single objects.
+ *
+ * Used by default for all the control blocks when SHARED_PTR_POOL is defined,
+ * and usable explicitly with allocate_shared().
+ */
+template<class T>
+class pool_allocator
+{
+public:
+    typedef T value_type;
+
+    pool_allocator(void) SHARED_NOEXCEPT // never throws
+    {
+    }
+    template<class U>
+    pool_allocator(const pool_allocator<U>&) SHARED_NOEXCEPT // never throws
+    {
+    }
+    T* allocate(std::size_t n) // may throw std::bad_alloc
+    {
+        if (1 == n)
+        {
+            return static_cast<T*>(count_pool::allocate(sizeof(T)));
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T* p, std::size_t n) SHARED_NOEXCEPT // never throws
+    {
+        if (1 == n)
+        {
+            count_pool::deallocate(p, sizeof(T));
+        }
+        else
+        {
+            ::operator delete(p);
+        }
+    }
+};
+template<class T, class U> bool operator==(const pool_allocator<T>&, const pool_allocator<U>&) SHARED_NOEXCEPT // never throws
+{
+    return true;
+}
+template<class T, class U> bool operator!=(const pool_allocator<T>&, const pool_allocator<U>&) SHARED_NOEXCEPT // never throws
+{
+    return false;
+}
+#endif // SHARED_PTR_CPP11
+
+/**
+ * @brief control block for an object allocated separately with new, and deleted as X.
+ */
+template<class X>
+class count_impl SHARED_FINAL : public count_base
+{
+public:
+    explicit count_impl(X* p) SHARED_NOEXCEPT : // never throws
+        count_base(),
+        px(p)
+    {
+#ifdef SHARED_PTR_STATS
+        track(shared_ptr_stats::of<X>());
+#endif
+    }
+    /// @brief delete the managed object
+    virtual void dispose(void) SHARED_NOEXCEPT // never throws
+    {
+        delete_ptr(px);
+    }
+    /// @brief the control block is final: dispose() and destroy() are inlined
+    virtual void dispose_and_destroy(void) SHARED_NOEXCEPT // never throws
+    {
+        dispose();
+        destroy();
+    }
+    /// @brief delete an object allocated with new
+    static void delete_ptr(X* p) SHARED_NOEXCEPT // never throws
+    {
+        delete p;
+    }
+
+private:
+    X*  px; //!< Owned pointer
+};
+/**
+ * @brief control block for an array allocated separately with new[], and deleted with delete[].
+ */
+template<class X>
+class count_impl<X[]> SHARED_FINAL : public count_base
+{
+public:
+    explicit count_impl(X* p) SHARED_NOEXCEPT : // never throws
+        count_base(),
+        px(p)
+    {
+#ifdef SHARED_PTR_STATS
+        track(shared_ptr_stats::of<X[]>());
+#endif
+    }
+    /// @brief delete the managed array
+    virtual void dispose(void) SHARED_NOEXCEPT // never throws
+    {
+        delete_ptr(px);
+    }
+    /// @brief the control block is final: dispose() and destroy() are inlined
+    virtual void dispose_and_destroy(void) SHARED_NOEXCEPT // never throws
+    {
+        dispose();
+        destroy();
+    }
+    /// @brief delete an array allocated with new[]
+    static void delete_ptr(X* p) SHARED_NOEXCEPT // never throws
+    {
+        delete[] p;
+    }
+
+private:
+    X*  px; //!< Owned pointer to the first element
+};
+
+/**
+ * @brief compile-time detection of class types, which can be used as an empty base.
+ */
+template<class D>
+struct count_is_class
+{
+#ifdef SHARED_PTR_CPP11
+#if (__cplusplus >= 201402L) || (defined(_MSVC_LANG) && (_MSVC_LANG >= 201402L))
+    static const bool value = std::is_class<D>::value && !std::is_final<D>::value;
+#else
+    static const bool value = std::is_class<D>::value;
+#endif
+#else
+private:
+    struct yes { char c[1]; };
+    struct no  { char c[2]; };
+    template<class U> static yes test(int U::*);
+    template<class U> static no  test(...);
+public:
+    static const bool value = (sizeof(test<D>(0)) == sizeof(yes));
+#endif
+};
+
+/**
+ * @brief storage of a deleter, using the empty base optimization for classes so that a stateless deleter takes no space.
+ */
+template<class D, bool IsClass = count_is_class<D>::value>
+class count_deleter : private D
+{
+public:
+    explicit count_deleter(const D& d) :
+        D(d)
+    {
+    }
+    D& deleter(void) SHARED_NOEXCEPT // never throws
+    {
+        return *this;
+    }
+};
+template<class D>
+class count_deleter<D, false>
+{
+public:
+    explicit count_deleter(const D& d) :
+        del(d)
+    {
+    }
+    D& deleter(void) SHARED_NOEXCEPT // never throws
+    {
+        return del;
+    }
+private:
+    D   del;    //!< Deleter, typically a function pointer
+};
+
+/**
+ * @brief control block for an object released by a custom deleter D, stored inside the control block.
+ */
+template<class P, class D>
+class count_impl_pd SHARED_FINAL : public count_base, private count_deleter<D>
+{
+public:
+    count_impl_pd(P p, const D& d) : // may throw any exception of the D copy constructor
+        count_base(),
+        count_deleter<D>(d),
+        ptr(p)
+    {
+#ifdef SHARED_PTR_STATS
+        track(shared_ptr_stats::of<typename shared_ptr_stats::pointee<P>::type>());
+#endif
+    }
+    /// @brief release the managed object with the deleter
+    virtual void dispose(void) SHARED_NOEXCEPT // never throws
+    {
+        this->deleter()(ptr);
+    }
+    /// @brief the control block is final: dispose() and destroy() are inlined
+    virtual void dispose_and_destroy(void) SHARED_NOEXCEPT // never throws
+    {
+        dispose();
+        destroy();
+    }
+
+private:
+    P   ptr;    //!< Owned pointer
+};
+
+/**
+ * @brief layout of the control blocks of make_shared() keeping the object right after the reference counters (the default).
+ *
+ * The counters share the cache line of the beginning of the object, which is best for small objects
+ * (a single cache miss to reach both) as long as they are not copied by other threads while their fields are accessed.
+ */
+struct packed_layout
+{
+    /// raw storage for an object of type T, right after the counters
+    template<class T>
+    struct storage
+    {
+        /// @brief address where the object is to be constructed
+        void* address(void) SHARED_NOEXCEPT // never throws
+        {
+            return static_cast<void*>(&data);
+        }
+
+#ifdef SHARED_PTR_CPP11
+        alignas(T) unsigned char data[sizeof(T)]; //!< Raw storage for the object
+#else
+        union
+        {
+            unsigned char   bytes[sizeof(T)];
+            long double     align_long_double;  // force a maximum alignment of the storage
+            void*           align_pointer;
+        } data; //!< Raw storage for the object
+#endif
+    };
+};
+
+/**
+ * @brief layout of the control blocks of make_shared() starting the object on the cache line following the reference counters.
+ *
+ * The copies of the shared_ptr by other threads do not bounce the cache lines of the object anymore,
+ * at the cost of up to two cache lines of padding: for contended objects whose fields are read in hot loops.
+ * The object is placed at runtime on the first cache line boundary of an oversized storage,
+ * so this does not require an over-aligned allocation (nor an allocator supporting it).
+ */
+struct padded_layout
+{
+    /// raw storage for an object of type T, on its own cache lines
+    template<class T>
+    struct storage
+    {
+#ifdef SHARED_PTR_CPP11
+        static_assert(alignof(T) <= SHARED_PTR_CACHE_LINE_SIZE, "padded_layout does not support objects aligned beyond a cache line");
+#endif
+        /// @brief address where the object is to be constructed: the first cache line boundary after the counters
+        void* address(void) SHARED_NOEXCEPT // never throws
+        {
+            const std::size_t first_byte = reinterpret_cast<std::size_t>(&data[0]);
+            return reinterpret_cast<void*>((first_byte + line_size - 1) & ~(line_size - 1));
+        }
+
+        static const std::size_t line_size = SHARED_PTR_CACHE_LINE_SIZE;
+        // whole cache lines for the object, so that it does not share its last one with the next allocation,
+        // and enough bytes before it to reach a cache line boundary
+        unsigned char data[((sizeof(T) + line_size - 1) / line_size) * line_size + line_size - 1]; //!< Raw storage for the object
+    };
+};
+
+/**
+ * @brief layout of the control blocks created by make_shared() and allocate_shared() for objects of type T.
+ *
+ * Packed by default; specialize it to use a padded_layout for each type whose objects are copied concurrently
+ * by several threads while others read them, or use make_shared_padded() to choose for each object:
+ * @code
+ * template<> struct shared_ptr_layout<Contended> { typedef padded_layout type; };
+ * @endcode
+ */
+template<class T>
+struct shared_ptr_layout
+{
+    typedef packed_layout type;
+};
+
+/**
+ * @brief control block with storage for the managed object in the same allocation, obtained from the allocator A.
+ *
+ * Used by make_shared() and allocate_shared() to replace the two allocations of shared_ptr<T>(new T) by a single one,
+ * keeping the reference counter on the same cache line as the beginning of the object, or on its own one,
+ * depending on the layout L.
+ * The allocator is stored using the empty base optimization, so a stateless allocator takes no space.
+ */
+template<class T, class A, class L = typename shared_ptr_layout<T>::type>
+class count_inplace SHARED_FINAL : public count_base, private A
+{
+public:
+#ifdef SHARED_PTR_CPP11
+    typedef typename std::allocator_traits<A>::template rebind_alloc<count_inplace> block_allocator;
+#else
+    typedef typename A::template rebind<count_inplace>::other block_allocator;
+#endif
+
+    /// @brief allocate a control block using a copy of the provided allocator; the object is to be constructed afterward
+    static count_inplace* create(const A& alloc) // may throw std::bad_alloc
+    {
+        block_allocator block_alloc(alloc);
+        void* p = block_alloc.allocate(1); // may throw std::bad_alloc
+        return ::new(p) count_inplace(alloc);
+    }
+    /// @brief destroy the managed object, leaving the storage to be freed with the control block
+    virtual void dispose(void) SHARED_NOEXCEPT // never throws
+    {
+        get()->~T();
+    }
+    /// @brief free the control block with the allocator that was used to allocate it
+    virtual void destroy(void) SHARED_NOEXCEPT // never throws
+    {
+        block_allocator block_alloc(static_cast<const A&>(*this));
+        this->~count_inplace();
+        block_alloc.deallocate(this, 1);
+    }
+    /// @brief the control block is final: dispose() and destroy() are inlined
+    virtual void dispose_and_destroy(void) SHARED_NOEXCEPT // never throws
+    {
+        dispose();
+        destroy();
+    }
+    /// @brief address of the storage where the object is to be constructed
+    void* address(void) SHARED_NOEXCEPT // never throws
+    {
+        return storage.address();
+    }
+    /// @brief getter of the object constructed in place
+    T* get(void) SHARED_NOEXCEPT // never throws
+    {
+        return static_cast<T*>(address());
+    }
+
+private:
+    explicit count_inplace(const A& alloc) SHARED_NOEXCEPT : // never throws
+        count_base(),
+        A(alloc)
+    {
+    }
+
+private:
+    typename L::template storage<T> storage; //!< Raw storage for the object
+};
+
+/**
+ * @brief control block with storage for an array of n elements in the same allocation, obtained from the allocator A.
+ *
+ * Used by make_shared<T[]>(n) and allocate_shared<T[]>(alloc, n): the elements follow the reference counter,
+ * in place of the three allocations of a wrapper object owning a buffer (wrapper, buffer and control block).
+ * The allocation is made of whole blocks, the first element being stored at the end of the first block.
+ */
+template<class T, class A>
+class count_inplace_array SHARED_FINAL : public count_base, private A
+{
+public:
+#ifdef SHARED_PTR_CPP11
+    typedef typename std::allocator_traits<A>::template rebind_alloc<count_inplace_array> block_allocator;
+#else
+    typedef typename A::template rebind<count_inplace_array>::other block_allocator;
+#endif
+
+    /// @brief allocate a control block using a copy of the provided allocator; the elements are to be constructed afterward
+    static count_inplace_array* create(const A& alloc, std::size_t n) // may throw std::bad_alloc
+    {
+        if (((static_cast<std::size_t>(-1) - sizeof(count_inplace_array)) / sizeof(T)) < n)
+        {
+            throw std::bad_alloc();
+        }
+        block_allocator block_alloc(alloc);
+        void* p = block_alloc.allocate(nb_blocks(n)); // may throw std::bad_alloc
+        return ::new(p) count_inplace_array(alloc, n);
+    }
+    /// @brief value-initialize the elements in place, destroying the ones already constructed if one of them throws
+    void construct(void) // may throw any exception of the T constructor
+    {
+        T* elements = get();
+        std::size_t i = 0;
+        try
+        {
+            for (; i < size; ++i)
+            {
+                ::new(static_cast<void*>(elements + i)) T();
+            }
+        }
+        catch (...)
+        {
+            while (0 < i)
+            {
+                elements[--i].~T();
+            }
+            throw; // rethrow the exception of the T constructor
+        }
+    }
+    /// @brief destroy the elements in reverse order, leaving the storage to be freed with the control block
+    virtual void dispose(void) SHARED_NOEXCEPT // never throws
+    {
+        T* elements = get();
+        for (std::size_t i = size; 0 < i; --i)
+        {
+            elements[i - 1].~T();
+        }
+    }
+    /// @brief free the control block with the allocator that was used to allocate it
+    virtual void destroy(void) SHARED_NOEXCEPT // never throws
+    {
+        block_allocator block_alloc(static_cast<const A&>(*this));
+        const std::size_t n = nb_blocks(size);
+        this->~count_inplace_array();
+        block_alloc.deallocate(this, n);
+    }
+    /// @brief the control block is final: dispose() and destroy() are inlined
+    virtual void dispose_and_destroy(void) SHARED_NOEXCEPT // never throws
+    {
+        dispose();
+        destroy();
+    }
+    /// @brief getter of the first element constructed in place
+    T* get(void) SHARED_NOEXCEPT // never throws
+    {
+        return static_cast<T*>(static_cast<void*>(&storage));
+    }
+
+private:
+    count_inplace_array(const A& alloc, std::size_t n) SHARED_NOEXCEPT : // never throws
+        count_base(),
+        A(alloc),
+        size(n)
+    {
+    }
+    /// @brief number of blocks to allocate for the control block followed by n elements
+    static std::size_t nb_blocks(std::size_t n) SHARED_NOEXCEPT // never throws
+    {
+        const std::size_t bytes = sizeof(count_inplace_array) + ((1 < n) ? ((n - 1) * sizeof(T)) : 0);
+        return (bytes + sizeof(count_inplace_array) - 1) / sizeof(count_inplace_array);
+    }
+
+private:
+    std::size_t size; //!< Number of elements
+#ifdef SHARED_PTR_CPP11
+    alignas(T) unsigned char storage[sizeof(T)]; //!< Raw storage for the first element, followed by the others
+#else
+    union
+    {
+        unsigned char   data[sizeof(T)];
+        long double     align_long_double;  // force a maximum alignment of the storage
+        void*           align_pointer;
+    } storage; //!< Raw storage for the first element, followed by the others
+#endif
+};
+
+
+/**
+ * @brief implementation of reference counter for the following minimal smart pointer.
+ *
+ * shared_ptr_count is a container for the allocated pn control block holding the reference counter,
+ * updated with the increment/decrement primitives of the threading Policy.
+ */
+template<class Policy>
+class shared_ptr_count
+{
+public:
+    SHARED_CONSTEXPR shared_ptr_count() SHARED_NOEXCEPT : // never throws
+        pn(NULL)
+    {
+    }
+    shared_ptr_count(const shared_ptr_count& count) SHARED_NOEXCEPT : // never throws
+        pn(count.pn)
+    {
+    }
+    /// @brief Swap method for the copy-and-swap idiom (copy constructor and swap method)
+    void swap(shared_ptr_count& lhs) SHARED_NOEXCEPT // never throws
+    {
+        std::swap(pn, lhs.pn);
+    }
+    /// @brief getter of the underlying reference counter
+    long use_count(void) const SHARED_NOEXCEPT // never throws
+    {
+        long count = 0;
+        if (NULL != pn)
+        {
+            count = pn->use_count();
+        }
+        return count;
+    }
+    /// @brief acquire the ownership of the pointer, initializing the reference counter to delete it as X (X[] for arrays)
+    template<class X, class U>
+    void acquire(U* p) // may throw std::bad_alloc
+    {
+        SHARED_ASSERT_FULL(NULL == pn);
+        if (NULL != p)
+        {
+            try
+            {
+                pn = new count_impl<X>(p); // may throw std::bad_alloc
+            }
+            catch (std::bad_alloc&)
+            {
+                count_impl<X>::delete_ptr(p);
+                throw; // rethrow the std::bad_alloc
+            }
+        }
+    }
+    /// @brief acquire the ownership of the pointer, initializing the reference counter with a custom deleter
+    /// @note the deleter is copied only inside the try block, so that p is deleted by d on any exception
+    template<class U, class D>
+    void acquire(U* p, D& d) // may throw std::bad_alloc, or any exception of the D copy constructor
+    {
+        SHARED_ASSERT_FULL(NULL == pn);
+        if (NULL != p)
+        {
+            try
+            {
+                pn = new count_impl_pd<U*, D>(p, d); // may throw std::bad_alloc, or any exception of the D copy constructor
+            }
+            catch (...)
+            {
+                d(p);
+                throw; // rethrow the std::bad_alloc, or the exception of the copy of the deleter
+            }
+        }
+    }
+    /// @brief share the ownership of the managed object (used by the aliasing constructor)
+    void add_ref(void) SHARED_NOEXCEPT // never throws
+    {
+        if (NULL != pn)
+        {
+            pn->add_ref<Policy>();
+        }
+    }
+    /// @brief share the ownership of the managed object n times (used by share_n())
+    void add_ref(long n) SHARED_NOEXCEPT // never throws
+    {
+        if (NULL != pn)
+        {
+            pn->add_ref<Policy>(n);
+        }
+    }
+    /// @brief share the control block of a shared_ptr of another policy (explicit conversion)
+    void share(count_base* block) SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT_FULL(NULL == pn);
+        pn = block;
+        add_ref();
+    }
+    /// @brief adopt a newly created control block, already holding its first reference
+    void adopt(count_base* block) SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT_FULL(NULL == pn);
+        pn = block;
+    }
+    /// @brief release the ownership of the px pointer, destroying the object when appropriate
+    void release(void) SHARED_NOEXCEPT // never throws
+    {
+        if (NULL != pn)
+        {
+            pn->release<Policy>();
+            pn = NULL;
+        }
+    }
+    /// @brief release n references of the managed object, destroying it when appropriate (used by release_all())
+    void release(long n) SHARED_NOEXCEPT // never throws
+    {
+        if (NULL != pn)
+        {
+            pn->release<Policy>(n);
+            pn = NULL;
+        }
+    }
+
+public:
+    count_base* pn; //!< Control block holding the reference counter
+};
+
+/**
+ * @brief uncounted "reference counter" of a shared_ptr<T, immortal>, never releasing its object.
+ *
+ * It has no control block for a raw pointer, and only keeps the one of an explicitly converted shared_ptr,
+ * with a reference taken once and for all.
+ */
+template<>
+class shared_ptr_count<immortal>
+{
+public:
+    SHARED_CONSTEXPR shared_ptr_count() SHARED_NOEXCEPT : // never throws
+        pn(NULL)
+    {
+    }
+    shared_ptr_count(const shared_ptr_count& count) SHARED_NOEXCEPT : // never throws
+        pn(count.pn)
+    {
+    }
+    /// @brief Swap method for the copy-and-swap idiom (copy constructor and swap method)
+    void swap(shared_ptr_count& lhs) SHARED_NOEXCEPT // never throws
+    {
+        std::swap(pn, lhs.pn);
+    }
+    /// @brief getter of the underlying reference counter, 0 without control block
+    long use_count(void) const SHARED_NOEXCEPT // never throws
+    {
+        return (NULL != pn) ? pn->use_count() : 0;
+    }
+    /// @brief point to an object that is never deleted: no control block
+    template<class X, class U>
+    void acquire(U*) SHARED_NOEXCEPT // never throws
+    {
+    }
+    /// @brief point to an object that is never deleted: no control block, the deleter is never called
+    template<class U, class D>
+    void acquire(U*, D) SHARED_NOEXCEPT // never throws
+    {
+    }
+    /// @brief copies are not counted
+    void add_ref(void) SHARED_NOEXCEPT // never throws
+    {
+    }
+    void add_ref(long) SHARED_NOEXCEPT // never throws
+    {
+    }
+    /// @brief share the control block of a counted shared_ptr, with a reference that is never released
+    void share(count_base* block) SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT_FULL(NULL == pn);
+        pn = block;
+        if (NULL != pn)
+        {
+            pn->add_ref<multi_threaded>(); // the counted shared_ptr may be shared by other threads
+        }
+    }
+    /// @brief never release the object
+    void release(void) SHARED_NOEXCEPT // never throws
+    {
+        pn = NULL;
+    }
+    void release(long) SHARED_NOEXCEPT // never throws
+    {
+        pn = NULL;
+    }
+
+public:
+    count_base* pn; //!< Control block of the explicitly converted shared_ptr, if any
+};
+
+template<class Policy>
+class shared_ptr_base
+{
+protected:
+    SHARED_CONSTEXPR shared_ptr_base(void) SHARED_NOEXCEPT : // never throws
+        pn()
+    {
+    }
+
+    shared_ptr_base(const shared_ptr_base& other) SHARED_NOEXCEPT : // never throws
+        pn(other.pn)
+    {
+    }
+
+    shared_ptr_count<Policy> pn; //!< Reference counter
+};
+
+template<class T> class weak_ptr;
+template<class T> class compact_shared_ptr;
+template<class T> class local_shared_ptr;
+class reclamation_domain;
+template<class T, class Policy = default_threading> class shared_ptr;
+template<class T> class enable_shared_from_this;
+
+/// @brief give the ownership of a new shared_ptr to the weak_ptr of its object, if it derives from enable_shared_from_this
+/// @note only for the default policy, used by the weak_ptr and thus by shared_from_this(): the owners of the other policies are ignored
+template<class X, class Y, class U>
+void enable_shared_from_this_hook(const shared_ptr<X, default_threading>* owner, const Y* p, const enable_shared_from_this<U>* pe) SHARED_NOEXCEPT; // never throws
+/// @brief do nothing if the object does not derive from enable_shared_from_this, or if its owner has another policy
+inline void enable_shared_from_this_hook(...) SHARED_NOEXCEPT // never throws
+{
+}
 
 /**
- * @brief implementation of reference counter for the following minimal smart pointer.
+ * @brief type of the elements of a shared_ptr<T>, T being either a single object or an array T[] of elements.
  *
- * shared_ptr_count is a container for the allocated pn reference counter.
+ * Also selects the overloads of make_shared() and allocate_shared() for single objects and for arrays.
  */
-class shared_ptr_count
+template<class T>
+struct shared_ptr_traits
+{
+    typedef T               element_type;
+    typedef shared_ptr<T>   single_ptr; //!< Return type of make_shared<T>()
+};
+template<class T>
+struct shared_ptr_traits<T[]>
+{
+    typedef T               element_type;
+    typedef shared_ptr<T[]> array_ptr;  //!< Return type of make_shared<T[]>(n)
+};
+
+
+/**
+ * @brief minimal implementation of smart pointer, a subset of the C++11 std::shared_ptr or boost::shared_ptr.
+ *
+ * shared_ptr is a smart pointer retaining ownership of an object through a provided pointer,
+ * and sharing this ownership with a reference counter.
+ * It destroys the object when the last shared pointer pointing to it is destroyed or reset.
+ *
+ * The threading Policy selects the cost of the reference counting of each shared_ptr:
+ * - shared_ptr<T, single_threaded> uses plain increments and decrements,
+ * - shared_ptr<T, multi_threaded> uses atomic operations, allowing copies to be used concurrently by different threads,
+ * - shared_ptr<T, immortal> does not count at all, for static objects that are never deleted.
+ * shared_ptr<T> uses default_threading: single_threaded, unless SHARED_PTR_THREAD_SAFE is defined.
+ * The conversions between policies are explicit, and do not transfer the ownership of the other pointers:
+ * an object can get single_threaded pointers only while it is used by a single thread.
+ * weak_ptr, make_shared() and the other smart pointers always use the default policy.
+ *
+ * shared_ptr<T[]> manages an array allocated with new[] (or by make_shared<T[]>(n)),
+ * deleted with delete[] and accessed with operator[].
+ */
+template<class T, class Policy>
+class shared_ptr: public shared_ptr_base<Policy>
+{
+    using shared_ptr_base<Policy>::pn;
+
+public:
+    /// The type of the managed object (or of the elements of the managed array), aliased as member type
+    typedef typename shared_ptr_traits<T>::element_type element_type;
+    /// The threading policy of the reference counting
+    typedef Policy policy_type;
+
+    /// @brief Default constructor (constant initialization of a static shared_ptr, without dynamic initializer)
+    SHARED_CONSTEXPR shared_ptr(void) SHARED_NOEXCEPT : // never throws
+        shared_ptr_base<Policy>(),
+        px(NULL)
+    {
+    }
+#ifdef SHARED_PTR_CPP11
+    /// @brief Constructor of an empty shared_ptr from nullptr
+    constexpr shared_ptr(std::nullptr_t) noexcept : // never throws
+        shared_ptr_base<Policy>(),
+        px(nullptr)
+    {
+    }
+#endif
+    /// @brief Constructor with the provided pointer to manage
+    explicit shared_ptr(element_type* p) : // may throw std::bad_alloc
+      //px(p), would be unsafe as acquire() may throw, which would call release() in destructor
+        shared_ptr_base<Policy>()
+    {
+        acquire(p);   // may throw std::bad_alloc
+        enable_shared_from_this_hook(this, p, p);
+    }
+    /// @brief Constructor adopting a newly created control block already holding its first reference (used by make_shared())
+    /// @note the block must be passed as a count_base*, not to be mistaken for the (pointer, deleter) constructor
+    shared_ptr(count_base* block, element_type* p) SHARED_NOEXCEPT : // never throws
+        shared_ptr_base<Policy>(),
+        px(p)
+    {
+        pn.adopt(block);
+    }
+    /// @brief Constructor with the provided pointer to manage, and the custom deleter to release it
+    template <class U, class D>
+    shared_ptr(U* p, D d) : // may throw std::bad_alloc, or any exception of the D copy constructor
+      //px(p), would be unsafe as acquire() may throw, which would call release() in destructor
+        shared_ptr_base<Policy>()
+    {
+        pn.acquire(p, d); // may throw std::bad_alloc, or any exception of the D copy constructor (p being deleted by d)
+        px = p;
+        enable_shared_from_this_hook(this, p, p);
+    }
+    /// @brief Aliasing constructor: share the ownership of ptr, but point to p (a member of its object, or a cast pointer)
+    template <class U>
+    shared_ptr(const shared_ptr<U, Policy>& ptr, element_type* p) SHARED_NOEXCEPT : // never throws
+        shared_ptr_base<Policy>(ptr),
+        px(p)
+    {
+        pn.add_ref(); // share the existing control block: no allocation
+    }
+    /// @brief Copy constructor to convert from another pointer type
+    template <class U>
+    shared_ptr(const shared_ptr<U, Policy>& ptr) SHARED_NOEXCEPT : // never throws
+        shared_ptr_base<Policy>(ptr),
+        px(static_cast<element_type*>(ptr.px))
+    {
+        pn.add_ref(); // share the existing control block: no allocation
+    }
+    /// @brief Explicit conversion from a shared_ptr of another threading policy, sharing its control block
+    template <class U, class P>
+    explicit shared_ptr(const shared_ptr<U, P>& ptr) SHARED_NOEXCEPT : // never throws
+        shared_ptr_base<Policy>(),
+        px(static_cast<element_type*>(ptr.px))
+    {
+        pn.share(ptr.pn.pn); // share the existing control block: no allocation
+    }
+    /// @brief Copy constructor (used by the copy-and-swap idiom)
+    shared_ptr(const shared_ptr& ptr) SHARED_NOEXCEPT : // never throws
+        shared_ptr_base<Policy>(ptr),
+        px(ptr.px)
+    {
+        pn.add_ref(); // share the existing control block: no allocation
+    }
+#ifdef SHARED_PTR_CPP11
+    /// @brief Move constructor, stealing the ownership without touching the reference counter
+    shared_ptr(shared_ptr&& ptr) SHARED_NOEXCEPT : // never throws
+        shared_ptr_base<Policy>(),
+        px(ptr.px)
+    {
+        pn.swap(ptr.pn);
+        ptr.px = NULL;
+    }
+    /// @brief Move constructor to convert from another pointer type, stealing the ownership without touching the reference counter
+    template <class U>
+    shared_ptr(shared_ptr<U, Policy>&& ptr) SHARED_NOEXCEPT : // never throws
+        shared_ptr_base<Policy>(),
+        px(ptr.px)
+    {
+        pn.swap(ptr.pn);
+        ptr.px = NULL;
+    }
+    /// @brief Assignment operator using the copy-and-swap idiom (copy constructor and swap method)
+    shared_ptr& operator=(const shared_ptr& ptr) SHARED_NOEXCEPT // never throws
+    {
+        shared_ptr(ptr).swap(*this);
+        return *this;
+    }
+    /// @brief Move assignment operator, stealing the ownership without touching the reference counter
+    shared_ptr& operator=(shared_ptr&& ptr) SHARED_NOEXCEPT // never throws
+    {
+        shared_ptr(std::move(ptr)).swap(*this);
+        return *this;
+    }
+#else
+    /// @brief Assignment operator using the copy-and-swap idiom (copy constructor and swap method)
+    shared_ptr& operator=(shared_ptr ptr) SHARED_NOEXCEPT // never throws
+    {
+        swap(ptr);
+        return *this;
+    }
+#endif
+    /// @brief the destructor releases its ownership
+    ~shared_ptr(void) SHARED_NOEXCEPT // never throws
+    {
+        release();
+    }
+    /// @brief this reset releases its ownership
+    void reset(void) SHARED_NOEXCEPT // never throws
+    {
+        release();
+    }
+    /// @brief this reset release its ownership and re-acquire another one
+    void reset(element_type* p) // may throw std::bad_alloc
+    {
+        SHARED_ASSERT((NULL == p) || (px != p)); // auto-reset not allowed
+        release();
+        acquire(p); // may throw std::bad_alloc
+        enable_shared_from_this_hook(this, p, p);
+    }
+
+    /// @brief this reset release its ownership and re-acquire another one, with a custom deleter
+    template <class U, class D>
+    void reset(U* p, D d) // may throw std::bad_alloc, or any exception of the D copy constructor
+    {
+        SHARED_ASSERT((NULL == p) || (px != p)); // auto-reset not allowed
+        shared_ptr(p, d).swap(*this); // may throw std::bad_alloc, or any exception of the D copy constructor
+    }
+
+    /// @brief Swap method for the copy-and-swap idiom (copy constructor and swap method)
+    void swap(shared_ptr& lhs) SHARED_NOEXCEPT // never throws
+    {
+        std::swap(px, lhs.px);
+        pn.swap(lhs.pn);
+    }
+
+    // reference counter operations :
+    /// @brief test the stored pointer (like std::shared_ptr, without reading the reference counter)
+    operator bool() const SHARED_NOEXCEPT // never throws
+    {
+        return (NULL != px);
+    }
+    bool unique(void)  const SHARED_NOEXCEPT // never throws
+    {
+        return (1 == pn.use_count());
+    }
+    long use_count(void)  const SHARED_NOEXCEPT // never throws
+    {
+        return pn.use_count();
+    }
+    /// @brief ordering by control block, so that all the shared_ptr sharing the ownership of an object are equivalent
+    template <class U, class P>
+    bool owner_before(const shared_ptr<U, P>& ptr) const SHARED_NOEXCEPT // never throws
+    {
+        return (pn.pn < ptr.pn.pn);
+    }
+    template <class U>
+    bool owner_before(const weak_ptr<U>& ptr) const SHARED_NOEXCEPT // never throws
+    {
+        return (pn.pn < ptr.pn);
+    }
+    /// @brief equivalence by control block, true if both share the ownership of the same object (or are both empty)
+    template <class U, class P>
+    bool owner_equal(const shared_ptr<U, P>& ptr) const SHARED_NOEXCEPT // never throws
+    {
+        return (pn.pn == ptr.pn.pn);
+    }
+    template <class U>
+    bool owner_equal(const weak_ptr<U>& ptr) const SHARED_NOEXCEPT // never throws
+    {
+        return (pn.pn == ptr.pn);
+    }
+#ifdef SHARED_PTR_CPP11
+    /// @brief hash of the control block, consistent with owner_equal()
+    std::size_t owner_hash(void) const noexcept // never throws
+    {
+        return std::hash<count_base*>()(pn.pn);
+    }
+#endif
+
+    // underlying pointer operations :
+    element_type& operator*()  const SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT(NULL != px);
+        return *px;
+    }
+    element_type* operator->() const SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT(NULL != px);
+        return px;
+    }
+    /// @brief access to an element of a managed array (shared_ptr<T[]>)
+    element_type& operator[](std::ptrdiff_t i) const SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT(NULL != px);
+        SHARED_ASSERT(0 <= i);
+        return px[i];
+    }
+    element_type* get(void)  const SHARED_NOEXCEPT // never throws
+    {
+        // no assert, can return NULL
+        return px;
+    }
+
+private:
+    /// @brief acquire the ownership of the px pointer, initializing the reference counter
+    void acquire(element_type* p) // may throw std::bad_alloc
+    {
+        pn.template acquire<T>(p); // may throw std::bad_alloc
+        px = p; // here it is safe to acquire the ownership of the provided raw pointer, where exception cannot be thrown any more
+    }
+
+    /// @brief release the ownership of the px pointer, destroying the object when appropriate
+    void release(void) SHARED_NOEXCEPT // never throws
+    {
+        pn.release(); // the control block knows how to dispose of the object it manages
+        px = NULL;
+    }
+
+private:
+    // all shared_ptr specializations can steal the ownership of one another
+    template<class U, class P> friend class shared_ptr;
+    // weak_ptr can observe the control block
+    template<class U> friend class weak_ptr;
+    // compact_shared_ptr can steal the control block created by make_shared()
+    template<class U> friend class compact_shared_ptr;
+    // local_shared_ptr can hold a reference on the control block, and steal it from a shared_ptr
+    template<class U> friend class local_shared_ptr;
+    // the bulk operations adjust the reference counter once for many shared_ptr
+    template<class U, class Q, class O> friend O share_n(const shared_ptr<U, Q>& ptr, std::size_t n, O out);
+    template<class I> friend void release_all(I first, I last) SHARED_NOEXCEPT;
+    // the reclamation domain holds the reference of a retired shared_ptr until no reader can reach its object
+    friend class reclamation_domain;
+
+    element_type*       px; //!< Native pointer
+};
+
+
+// comparaison operators
+template<class T, class P, class U, class Q> bool operator==(const shared_ptr<T, P>& l, const shared_ptr<U, Q>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() == r.get());
+}
+template<class T, class P, class U, class Q> bool operator!=(const shared_ptr<T, P>& l, const shared_ptr<U, Q>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() != r.get());
+}
+template<class T, class P, class U, class Q> bool operator<=(const shared_ptr<T, P>& l, const shared_ptr<U, Q>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() <= r.get());
+}
+template<class T, class P, class U, class Q> bool operator<(const shared_ptr<T, P>& l, const shared_ptr<U, Q>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() < r.get());
+}
+template<class T, class P, class U, class Q> bool operator>=(const shared_ptr<T, P>& l, const shared_ptr<U, Q>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() >= r.get());
+}
+template<class T, class P, class U, class Q> bool operator>(const shared_ptr<T, P>& l, const shared_ptr<U, Q>& r) SHARED_NOEXCEPT // never throws
+{
+    return (l.get() > r.get());
+}
+#ifdef SHARED_PTR_CPP11
+template<class T, class P> bool operator==(const shared_ptr<T, P>& l, std::nullptr_t) noexcept // never throws
+{
+    return !l;
+}
+template<class T, class P> bool operator==(std::nullptr_t, const shared_ptr<T, P>& r) noexcept // never throws
+{
+    return !r;
+}
+template<class T, class P> bool operator!=(const shared_ptr<T, P>& l, std::nullptr_t) noexcept // never throws
+{
+    return static_cast<bool>(l);
+}
+template<class T, class P> bool operator!=(std::nullptr_t, const shared_ptr<T, P>& r) noexcept // never throws
+{
+    return static_cast<bool>(r);
+}
+#endif
+
+
+/**
+ * @brief minimal implementation of weak pointer, a subset of the C++11 std::weak_ptr or boost::weak_ptr.
+ *
+ * weak_ptr is a non-owning reference to an object managed by a shared_ptr.
+ * It keeps the control block alive (but not the object) so that lock() can safely tell
+ * if the object still exists, and get a new shared_ptr to it.
+ * lock() uses a lock-free compare-and-swap loop when SHARED_PTR_THREAD_SAFE is defined.
+ */
+template<class T>
+class weak_ptr
 {
 public:
-    shared_ptr_count() :
+    /// The type of the managed object (or of the elements of the managed array), aliased as member type
+    typedef typename shared_ptr_traits<T>::element_type element_type;
+
+    /// @brief Default constructor
+    SHARED_CONSTEXPR weak_ptr(void) SHARED_NOEXCEPT : // never throws
+        px(NULL),
         pn(NULL)
     {
     }
-    shared_ptr_count(const shared_ptr_count& count) :
-        pn(count.pn)
+    /// @brief Constructor from a shared_ptr, observing its object
+    template <class U>
+    weak_ptr(const shared_ptr<U>& ptr) SHARED_NOEXCEPT : // never throws
+        px(ptr.px),
+        pn(ptr.pn.pn)
+    {
+        weak_add_ref();
+    }
+    /// @brief Copy constructor to convert from another pointer type
+    template <class U>
+    weak_ptr(const weak_ptr<U>& ptr) SHARED_NOEXCEPT : // never throws
+        px(NULL),
+        pn(ptr.pn)
+    {
+        // the object may already be destroyed: the conversion of the pointer requires it to be locked
+        px = ptr.lock().get();
+        weak_add_ref();
+    }
+    /// @brief Copy constructor (used by the copy-and-swap idiom)
+    weak_ptr(const weak_ptr& ptr) SHARED_NOEXCEPT : // never throws
+        px(ptr.px),
+        pn(ptr.pn)
+    {
+        weak_add_ref();
+    }
+    /// @brief Assignment operator using the copy-and-swap idiom (copy constructor and swap method)
+    weak_ptr& operator=(weak_ptr ptr) SHARED_NOEXCEPT // never throws
+    {
+        swap(ptr);
+        return *this;
+    }
+    /// @brief the destructor releases its weak reference
+    ~weak_ptr(void) SHARED_NOEXCEPT // never throws
+    {
+        weak_release();
+    }
+    /// @brief this reset releases its weak reference
+    void reset(void) SHARED_NOEXCEPT // never throws
     {
+        weak_release();
+        px = NULL;
+        pn = NULL;
     }
+
     /// @brief Swap method for the copy-and-swap idiom (copy constructor and swap method)
-    void swap(shared_ptr_count& lhs) throw() // never throws
+    void swap(weak_ptr& lhs) SHARED_NOEXCEPT // never throws
     {
+        std::swap(px, lhs.px);
         std::swap(pn, lhs.pn);
     }
-    /// @brief getter of the underlying reference counter
-    long use_count(void) const throw() // never throws
+
+    // reference counter operations :
+    long use_count(void) const SHARED_NOEXCEPT // never throws
+    {
+        return (NULL != pn) ? pn->use_count() : 0;
+    }
+    bool expired(void) const SHARED_NOEXCEPT // never throws
+    {
+        return (0 == use_count());
+    }
+    /// @brief get a shared_ptr to the object if it still exists, or an empty one otherwise
+    shared_ptr<T> lock(void) const SHARED_NOEXCEPT // never throws
+    {
+        if ((NULL != pn) && pn->add_ref_lock())
+        {
+            return shared_ptr<T>(pn, px); // adopt the new reference
+        }
+        return shared_ptr<T>();
+    }
+
+    /// @brief ordering by control block, so that the weak_ptr and the shared_ptr of an object are equivalent, even once expired
+    template <class U, class P>
+    bool owner_before(const shared_ptr<U, P>& ptr) const SHARED_NOEXCEPT // never throws
+    {
+        return (pn < ptr.pn.pn);
+    }
+    template <class U>
+    bool owner_before(const weak_ptr<U>& ptr) const SHARED_NOEXCEPT // never throws
+    {
+        return (pn < ptr.pn);
+    }
+    /// @brief equivalence by control block, true if both observe the same object (or are both empty)
+    template <class U, class P>
+    bool owner_equal(const shared_ptr<U, P>& ptr) const SHARED_NOEXCEPT // never throws
+    {
+        return (pn == ptr.pn.pn);
+    }
+    template <class U>
+    bool owner_equal(const weak_ptr<U>& ptr) const SHARED_NOEXCEPT // never throws
+    {
+        return (pn == ptr.pn);
+    }
+#ifdef SHARED_PTR_CPP11
+    /// @brief hash of the control block, consistent with owner_equal()
+    std::size_t owner_hash(void) const noexcept // never throws
+    {
+        return std::hash<count_base*>()(pn);
+    }
+#endif
+
+private:
+    /// @brief Constructor observing the object of owner, but pointing to p (used by enable_shared_from_this)
+    template <class U>
+    weak_ptr(const shared_ptr<U, default_threading>& owner, element_type* p) SHARED_NOEXCEPT : // never throws
+        px(p),
+        pn(owner.pn.pn)
+    {
+        weak_add_ref();
+    }
+
+    void weak_add_ref(void) SHARED_NOEXCEPT // never throws
+    {
+        if (NULL != pn)
+        {
+            pn->weak_add_ref();
+        }
+    }
+    void weak_release(void) SHARED_NOEXCEPT // never throws
     {
-        long count = 0;
         if (NULL != pn)
         {
-            count = *pn;
+            pn->weak_release();
         }
-        return count;
     }
-    /// @brief acquire/share the ownership of the pointer, initializing the reference counter
-    template<class U>
-    void acquire(U* p) // may throw std::bad_alloc
+
+private:
+    // all weak_ptr specializations can access one another
+    template<class U> friend class weak_ptr;
+    // shared_ptr can be ordered by control block with a weak_ptr
+    template<class U, class P> friend class shared_ptr;
+    // enable_shared_from_this can observe the object it is a base of
+    template<class U> friend class enable_shared_from_this;
+
+    element_type*   px; //!< Native pointer
+    count_base*     pn; //!< Control block holding the weak reference counter
+};
+
+
+// static cast of shared_ptr
+template<class T, class U, class P>
+shared_ptr<T, P> static_pointer_cast(const shared_ptr<U, P>& ptr) // never throws
+{
+    return shared_ptr<T, P>(ptr, static_cast<typename shared_ptr<T, P>::element_type*>(ptr.get()));
+}
+
+// dynamic cast of shared_ptr
+template<class T, class U, class P>
+shared_ptr<T, P> dynamic_pointer_cast(const shared_ptr<U, P>& ptr) // never throws
+{
+    T* p = dynamic_cast<typename shared_ptr<T, P>::element_type*>(ptr.get());
+    if (NULL != p)
     {
-        if (NULL != p)
+        return shared_ptr<T, P>(ptr, p);
+    }
+    else
+    {
+        return shared_ptr<T, P>();
+    }
+}
+
+
+/**
+ * @brief write n copies of ptr to the output iterator out, adding their n references with a single operation.
+ *
+ * Fanning out a shared_ptr to many consumers costs one (atomic) update of the reference counter instead of n.
+ * The copies are moved to the output (with C++11), like to a std::back_inserter of a container.
+ *
+ * @param[in] ptr   shared_ptr to copy
+ * @param[in] n     number of copies
+ * @param[in] out   output iterator receiving the copies
+ *
+ * @return the output iterator past the last copy
+ */
+template<class T, class P, class O>
+O share_n(const shared_ptr<T, P>& ptr, std::size_t n, O out) // may throw any exception of the output iterator
+{
+    if (0 < n)
+    {
+        shared_ptr_count<P> references(ptr.pn);
+        references.add_ref(static_cast<long>(n)); // all the references at once
+        for (; 0 < n; --n, ++out)
         {
-            if (NULL == pn)
+            shared_ptr<T, P> copy;
+            copy.px = ptr.px;
+            copy.pn.pn = ptr.pn.pn; // adopt one of the new references
+            try
             {
-                try
-                {
-                    pn = new long(1); // may throw std::bad_alloc
-                }
-                catch (std::bad_alloc&)
-                {
-                    delete p;
-                    throw; // rethrow the std::bad_alloc
-                }
+#ifdef SHARED_PTR_CPP11
+                *out = std::move(copy); // may throw
+#else
+                *out = copy; // may throw
+#endif
             }
-            else
+            catch (...)
             {
-                ++(*pn);
+                copy.pn.pn = NULL; // released with the references not given yet
+                references.release(static_cast<long>(n));
+                throw;
             }
         }
     }
-    /// @brief release the ownership of the px pointer, destroying the object when appropriate
-    template<class U>
-    void release(U* p) throw() // never throws
+    return out;
+}
+
+/**
+ * @brief release all the shared_ptr of the range [first, last), leaving them empty,
+ *        releasing the consecutive ones sharing a control block with a single operation.
+ *
+ * Draining the copies of a few objects, such as the messages of a fan-out, costs one (atomic) update
+ * of each reference counter by run of consecutive copies, instead of one per shared_ptr.
+ *
+ * @param[in] first first shared_ptr of the range (a forward iterator)
+ * @param[in] last  end of the range
+ */
+template<class I>
+void release_all(I first, I last) SHARED_NOEXCEPT // never throws
+{
+    typedef typename std::iterator_traits<I>::value_type::policy_type policy_type;
+    while (first != last)
     {
-        if (NULL != pn)
+        count_base* block = first->pn.pn;
+        long n = 0;
+        for (; (first != last) && (block == first->pn.pn); ++first, ++n)
         {
-            --(*pn);
-            if (0 == *pn)
-            {
-                delete p;
-                delete pn;
-            }
-            pn = NULL;
+            first->pn.pn = NULL;
+            first->px = NULL;
         }
+        shared_ptr_count<policy_type> references;
+        references.pn = block;
+        references.release(n);
     }
+}
 
-public:
-    long*   pn; //!< Reference counter
-};
+/// @brief release all the shared_ptr of a container, coalescing the consecutive ones sharing a control block (see above)
+template<class R>
+void release_all(R& range) SHARED_NOEXCEPT // never throws
+{
+    release_all(range.begin(), range.end());
+}
 
-class shared_ptr_base
+/// @brief raw pointer managed by a shared_ptr, for the generic code handling smart and raw pointers alike (like boost::get_pointer)
+template<class T, class P>
+typename shared_ptr<T, P>::element_type* get_pointer(const shared_ptr<T, P>& ptr) SHARED_NOEXCEPT // never throws
 {
-protected:
-    shared_ptr_base(void) :
-        pn()
+    return ptr.get();
+}
+/// @brief raw pointer, returned as is
+template<class T>
+T* get_pointer(T* p) SHARED_NOEXCEPT // never throws
+{
+    return p;
+}
+
+/**
+ * @brief ordering of smart pointers by the address of their object, accepting raw pointers as well (transparent comparator).
+ *
+ * Used as the comparator of a std::set or std::map of shared_ptr (or unique_ptr), it allows lookups by raw pointer
+ * (with C++14 heterogeneous lookup) without building a temporary smart pointer, thus without any allocation nor counter traffic.
+ */
+struct ptr_less
+{
+    typedef void is_transparent;
+
+    template<class L, class R>
+    bool operator()(const L& l, const R& r) const SHARED_NOEXCEPT // never throws
     {
+        return (get_pointer(l) < get_pointer(r));
     }
+};
 
-    shared_ptr_base(const shared_ptr_base& other) :
-        pn(other.pn)
+/// @brief equality of smart pointers by the address of their object, accepting raw pointers as well (transparent comparator)
+struct ptr_equal
+{
+    typedef void is_transparent;
+
+    template<class L, class R>
+    bool operator()(const L& l, const R& r) const SHARED_NOEXCEPT // never throws
     {
+        return (get_pointer(l) == get_pointer(r));
     }
-
-    shared_ptr_count    pn; //!< Reference counter
 };
 
-
 /**
- * @brief minimal implementation of smart pointer, a subset of the C++11 std::shared_ptr or boost::shared_ptr.
+ * @brief ordering of shared_ptr and weak_ptr by control block (transparent comparator, like std::owner_less<void>).
  *
- * shared_ptr is a smart pointer retaining ownership of an object through a provided pointer,
- * and sharing this ownership with a reference counter.
- * It destroys the object when the last shared pointer pointing to it is destroyed or reset.
+ * All the pointers sharing the ownership of an object are equivalent, whatever the object they point to,
+ * and a weak_ptr keeps its place after its object has expired.
  */
-template<class T>
-class shared_ptr: public shared_ptr_base
+struct owner_less
 {
-public:
-    /// The type of the managed object, aliased as member type
-    typedef T element_type;
+    typedef void is_transparent;
 
-    /// @brief Default constructor
-    shared_ptr(void) throw() : // never throws
-        shared_ptr_base(),
-        px(NULL)
+    template<class L, class R>
+    bool operator()(const L& l, const R& r) const SHARED_NOEXCEPT // never throws
     {
+        return l.owner_before(r);
     }
-    /// @brief Constructor with the provided pointer to manage
-    explicit shared_ptr(T* p) : // may throw std::bad_alloc
-      //px(p), would be unsafe as acquire() may throw, which would call release() in destructor
-        shared_ptr_base()
+};
+
+/// @brief equivalence of shared_ptr and weak_ptr by control block (transparent comparator, like std::owner_equal)
+struct owner_equal
+{
+    typedef void is_transparent;
+
+    template<class L, class R>
+    bool operator()(const L& l, const R& r) const SHARED_NOEXCEPT // never throws
     {
-        acquire(p);   // may throw std::bad_alloc
+        return l.owner_equal(r);
     }
-    /// @brief Constructor to share ownership. Warning : to be used for pointer_cast only ! (does not manage two separate <T> and <U> pointers)
-    template <class U>
-    shared_ptr(const shared_ptr<U>& ptr, T* p) :
-     //px(p), would be unsafe as acquire() may throw, which would call release() in destructor
-       shared_ptr_base(ptr)
+};
+
+#ifdef SHARED_PTR_CPP11
+/**
+ * @brief hash of smart pointers by the address of their object, accepting raw pointers as well (transparent hash).
+ *
+ * Consistent with std::hash of the smart pointers, and with ptr_equal for pointers to the same type,
+ * for lookups by raw pointer in unordered containers (with C++20 heterogeneous lookup).
+ */
+struct ptr_hash
+{
+    typedef void is_transparent;
+
+    template<class T>
+    std::size_t operator()(const T& ptr) const noexcept // never throws
     {
-       acquire(p);   // may throw std::bad_alloc
+        return hash(get_pointer(ptr));
     }
-    /// @brief Copy constructor to convert from another pointer type
-    template <class U>
-    shared_ptr(const shared_ptr<U>& ptr) throw() : // never throws (see comment below)
-      //px(ptr.px),
-        shared_ptr_base(ptr)
+
+private:
+    template<class T>
+    static std::size_t hash(T* p) noexcept // never throws
     {
-        SHARED_ASSERT((NULL == ptr.get()) || (0 != ptr.use_count())); // must be coherent : no allocation allowed in this path
-        acquire(static_cast<typename shared_ptr<T>::element_type*>(ptr.get()));   // will never throw std::bad_alloc
+        return std::hash<T*>()(p);
     }
-    /// @brief Copy constructor (used by the copy-and-swap idiom)
-    shared_ptr(const shared_ptr& ptr) throw() : // never throws (see comment below)
-       //px(ptr.px),
-         shared_ptr_base(ptr)
+};
+
+/// @brief hash of shared_ptr and weak_ptr by control block, consistent with owner_equal (transparent hash, like std::owner_hash)
+struct owner_hash
+{
+    typedef void is_transparent;
+
+    template<class T>
+    std::size_t operator()(const T& ptr) const noexcept // never throws
     {
-        SHARED_ASSERT((NULL == ptr.px) || (0 != ptr.pn.use_count())); // must be cohérent : no allocation allowed in this path
-        acquire(ptr.px);   // will never throw std::bad_alloc
+        return ptr.owner_hash();
     }
-    /// @brief Assignment operator using the copy-and-swap idiom (copy constructor and swap method)
-    shared_ptr& operator=(shared_ptr ptr) throw() // never throws
+};
+
+namespace std
+{
+/// @brief hash of a shared_ptr by the address of its object, like the one of std::shared_ptr
+template<class T, class P>
+struct hash< ::shared_ptr<T, P> >
+{
+    std::size_t operator()(const ::shared_ptr<T, P>& ptr) const noexcept // never throws
     {
-        swap(ptr);
-        return *this;
+        return hash<typename ::shared_ptr<T, P>::element_type*>()(ptr.get());
     }
-    /// @brief the destructor releases its ownership
-    ~shared_ptr(void) throw() // never throws
+};
+} // namespace std
+#endif
+
+
+/**
+ * @brief base class allowing an object managed by a shared_ptr to get a shared_ptr to itself, a subset of std::enable_shared_from_this.
+ *
+ * Use it with the CRTP (class Xxx : public enable_shared_from_this<Xxx>): the shared_ptr(Xxx*) constructor
+ * and make_shared<Xxx>() store a weak_ptr to the object in this base class,
+ * so that shared_from_this() can share the existing control block (with a single increment),
+ * instead of creating a second one with shared_ptr<Xxx>(this) and deleting the object twice.
+ *
+ * Like weak_ptr, it uses the default policy: an object owned first by a shared_ptr of another policy
+ * (single_threaded or multi_threaded without SHARED_PTR_THREAD_SAFE) is not observed, since shared_from_this()
+ * would update its counters with other operations than its owners (weak_from_this() is then empty).
+ */
+template<class T>
+class enable_shared_from_this
+{
+public:
+    /// @brief get a shared_ptr sharing the ownership of this object, which must already be owned by a shared_ptr
+    shared_ptr<T> shared_from_this(void) SHARED_NOEXCEPT // never throws
     {
-        release();
+        shared_ptr<T> ptr = weak_this.lock();
+        SHARED_ASSERT(ptr); // the object must be owned by a shared_ptr
+        return ptr;
     }
-    /// @brief this reset releases its ownership
-    void reset(void) throw() // never throws
+    /// @brief get a shared_ptr sharing the ownership of this object, which must already be owned by a shared_ptr
+    shared_ptr<const T> shared_from_this(void) const SHARED_NOEXCEPT // never throws
     {
-        release();
+        shared_ptr<const T> ptr = weak_this.lock();
+        SHARED_ASSERT(ptr); // the object must be owned by a shared_ptr
+        return ptr;
     }
-    /// @brief this reset release its ownership and re-acquire another one
-    void reset(T* p) // may throw std::bad_alloc
+    /// @brief get a weak_ptr observing this object, empty if it is not owned by a shared_ptr
+    weak_ptr<T> weak_from_this(void) SHARED_NOEXCEPT // never throws
     {
-        SHARED_ASSERT((NULL == p) || (px != p)); // auto-reset not allowed
-        release();
-        acquire(p); // may throw std::bad_alloc
+        return weak_this;
     }
-
-    /// @brief Swap method for the copy-and-swap idiom (copy constructor and swap method)
-    void swap(shared_ptr& lhs) throw() // never throws
+    /// @brief get a weak_ptr observing this object, empty if it is not owned by a shared_ptr
+    weak_ptr<const T> weak_from_this(void) const SHARED_NOEXCEPT // never throws
     {
-        std::swap(px, lhs.px);
-        pn.swap(lhs.pn);
+        return weak_this;
     }
 
-    // reference counter operations :
-    operator bool() const throw() // never throws
-    {
-        return (0 < pn.use_count());
-    }
-    bool unique(void)  const throw() // never throws
+protected:
+    enable_shared_from_this(void) SHARED_NOEXCEPT // never throws
     {
-        return (1 == pn.use_count());
     }
-    long use_count(void)  const throw() // never throws
+    /// @brief copying the object does not copy its ownership
+    enable_shared_from_this(const enable_shared_from_this&) SHARED_NOEXCEPT // never throws
     {
-        return pn.use_count();
     }
-
-    // underlying pointer operations :
-    T& operator*()  const throw() // never throws
+    enable_shared_from_this& operator=(const enable_shared_from_this&) SHARED_NOEXCEPT // never throws
     {
-        SHARED_ASSERT(NULL != px);
-        return *px;
+        return *this;
     }
-    T* operator->() const throw() // never throws
+    ~enable_shared_from_this(void) SHARED_NOEXCEPT // never throws
     {
-        SHARED_ASSERT(NULL != px);
-        return px;
     }
-    T* get(void)  const throw() // never throws
+
+private:
+    /// @brief observe the object with the first shared_ptr owning it
+    template<class X, class Y>
+    void accept_owner(const shared_ptr<X, default_threading>& owner, const Y* p) const SHARED_NOEXCEPT // never throws
     {
-        // no assert, can return NULL
-        return px;
+        if (weak_this.expired())
+        {
+            weak_ptr<T>(owner, const_cast<T*>(static_cast<const T*>(p))).swap(weak_this);
+        }
     }
 
+    template<class X, class Y, class U>
+    friend void enable_shared_from_this_hook(const shared_ptr<X, default_threading>* owner, const Y* p, const enable_shared_from_this<U>* pe) SHARED_NOEXCEPT;
+
 private:
-    /// @brief acquire/share the ownership of the px pointer, initializing the reference counter
-    void acquire(T* p) // may throw std::bad_alloc
+    mutable weak_ptr<T> weak_this;  //!< Weak pointer to the object, set by its first owner
+};
+
+template<class X, class Y, class U>
+void enable_shared_from_this_hook(const shared_ptr<X, default_threading>* owner, const Y* p, const enable_shared_from_this<U>* pe) SHARED_NOEXCEPT // never throws
+{
+    if (NULL != pe)
     {
-        pn.acquire(p); // may throw std::bad_alloc
-        px = p; // here it is safe to acquire the ownership of the provided raw pointer, where exception cannot be thrown any more
+        pe->accept_owner(*owner, p);
     }
+}
 
-    /// @brief release the ownership of the px pointer, destroying the object when appropriate
-    void release(void) throw() // never throws
+
+/**
+ * @brief default allocator of the control blocks created by make_shared()
+ */
+template<class T>
+struct count_default_allocator
+{
+#ifdef SHARED_PTR_POOL
+    typedef pool_allocator<T>   type;
+#else
+    typedef std::allocator<T>   type;
+#endif
+};
+
+/**
+ * @brief adopt a control block created by allocate_shared(), once its object is constructed in place
+ */
+template<class T, class A, class L>
+shared_ptr<T> adopt_inplace(count_inplace<T, A, L>* block) SHARED_NOEXCEPT // never throws
+{
+#ifdef SHARED_PTR_STATS
+    block->track(shared_ptr_stats::of<T>()); // once the object is constructed
+#endif
+    shared_ptr<T> ptr(static_cast<count_base*>(block), block->get());
+    enable_shared_from_this_hook(&ptr, block->get(), block->get());
+    return ptr;
+}
+
+#ifdef SHARED_PTR_CPP11
+/**
+ * @brief create an object managed by a shared_ptr, using a single allocation from the provided allocator
+ *        for the object and its reference counter, laid out as L (packed_layout or padded_layout).
+ *
+ * @param[in] alloc allocator used for the control block, copied inside it to free it at the end
+ * @param[in] args  arguments forwarded to the constructor of T
+ */
+template<class T, class L, class A, class... Args>
+typename shared_ptr_traits<T>::single_ptr allocate_shared_layout(const A& alloc, Args&&... args) // may throw std::bad_alloc or any exception of the T constructor
+{
+    count_inplace<T, A, L>* block = count_inplace<T, A, L>::create(alloc); // may throw std::bad_alloc
+    try
     {
-        pn.release(px);
-        px = NULL;
+        ::new(block->address()) T(std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        block->destroy();
+        throw; // rethrow the exception of the T constructor
     }
+    return adopt_inplace(block);
+}
 
-private:
-    T*                  px; //!< Native pointer
-};
+/**
+ * @brief create an object managed by a shared_ptr, using a single allocation from the provided allocator
+ *        for the object and its reference counter.
+ *
+ * @param[in] alloc allocator used for the control block, copied inside it to free it at the end
+ * @param[in] args  arguments forwarded to the constructor of T
+ */
+template<class T, class A, class... Args>
+typename shared_ptr_traits<T>::single_ptr allocate_shared(const A& alloc, Args&&... args) // may throw std::bad_alloc or any exception of the T constructor
+{
+    return ::allocate_shared_layout<T, typename shared_ptr_layout<T>::type>(alloc, std::forward<Args>(args)...);
+}
 
+/**
+ * @brief create an object managed by a shared_ptr, using a single allocation for the object and its reference counter.
+ *
+ * @param[in] args  arguments forwarded to the constructor of T
+ */
+template<class T, class... Args>
+typename shared_ptr_traits<T>::single_ptr make_shared(Args&&... args) // may throw std::bad_alloc or any exception of the T constructor
+{
+    return ::allocate_shared<T>(typename count_default_allocator<T>::type(), std::forward<Args>(args)...);
+}
 
-// comparaison operators
-template<class T, class U> bool operator==(const shared_ptr<T>& l, const shared_ptr<U>& r) throw() // never throws
+/**
+ * @brief create an object managed by a shared_ptr, using a single allocation for the object and its reference counter,
+ *        the object starting on the cache line following the counters (see padded_layout).
+ *
+ * @param[in] args  arguments forwarded to the constructor of T
+ */
+template<class T, class... Args>
+typename shared_ptr_traits<T>::single_ptr make_shared_padded(Args&&... args) // may throw std::bad_alloc or any exception of the T constructor
 {
-    return (l.get() == r.get());
+    return ::allocate_shared_layout<T, padded_layout>(typename count_default_allocator<T>::type(), std::forward<Args>(args)...);
 }
-template<class T, class U> bool operator!=(const shared_ptr<T>& l, const shared_ptr<U>& r) throw() // never throws
+#else
+/**
+ * @brief create an object managed by a shared_ptr, using a single allocation from the provided allocator
+ *        for the object and its reference counter.
+ *
+ * Without C++11 variadic templates, up to four arguments are supported, passed by const reference.
+ */
+template<class T, class A>
+typename shared_ptr_traits<T>::single_ptr allocate_shared(const A& alloc) // may throw std::bad_alloc or any exception of the T constructor
 {
-    return (l.get() != r.get());
+    count_inplace<T, A>* block = count_inplace<T, A>::create(alloc); // may throw std::bad_alloc
+    try
+    {
+        ::new(block->address()) T();
+    }
+    catch (...)
+    {
+        block->destroy();
+        throw; // rethrow the exception of the T constructor
+    }
+    return adopt_inplace(block);
 }
-template<class T, class U> bool operator<=(const shared_ptr<T>& l, const shared_ptr<U>& r) throw() // never throws
+template<class T, class A, class A1>
+typename shared_ptr_traits<T>::single_ptr allocate_shared(const A& alloc, const A1& a1)
 {
-    return (l.get() <= r.get());
+    count_inplace<T, A>* block = count_inplace<T, A>::create(alloc);
+    try
+    {
+        ::new(block->address()) T(a1);
+    }
+    catch (...)
+    {
+        block->destroy();
+        throw;
+    }
+    return adopt_inplace(block);
 }
-template<class T, class U> bool operator<(const shared_ptr<T>& l, const shared_ptr<U>& r) throw() // never throws
+template<class T, class A, class A1, class A2>
+typename shared_ptr_traits<T>::single_ptr allocate_shared(const A& alloc, const A1& a1, const A2& a2)
 {
-    return (l.get() < r.get());
+    count_inplace<T, A>* block = count_inplace<T, A>::create(alloc);
+    try
+    {
+        ::new(block->address()) T(a1, a2);
+    }
+    catch (...)
+    {
+        block->destroy();
+        throw;
+    }
+    return adopt_inplace(block);
 }
-template<class T, class U> bool operator>=(const shared_ptr<T>& l, const shared_ptr<U>& r) throw() // never throws
+template<class T, class A, class A1, class A2, class A3>
+typename shared_ptr_traits<T>::single_ptr allocate_shared(const A& alloc, const A1& a1, const A2& a2, const A3& a3)
 {
-    return (l.get() >= r.get());
+    count_inplace<T, A>* block = count_inplace<T, A>::create(alloc);
+    try
+    {
+        ::new(block->address()) T(a1, a2, a3);
+    }
+    catch (...)
+    {
+        block->destroy();
+        throw;
+    }
+    return adopt_inplace(block);
 }
-template<class T, class U> bool operator>(const shared_ptr<T>& l, const shared_ptr<U>& r) throw() // never throws
+template<class T, class A, class A1, class A2, class A3, class A4>
+typename shared_ptr_traits<T>::single_ptr allocate_shared(const A& alloc, const A1& a1, const A2& a2, const A3& a3, const A4& a4)
 {
-    return (l.get() > r.get());
+    count_inplace<T, A>* block = count_inplace<T, A>::create(alloc);
+    try
+    {
+        ::new(block->address()) T(a1, a2, a3, a4);
+    }
+    catch (...)
+    {
+        block->destroy();
+        throw;
+    }
+    return adopt_inplace(block);
 }
 
-
-
-// static cast of shared_ptr
-template<class T, class U>
-shared_ptr<T> static_pointer_cast(const shared_ptr<U>& ptr) // never throws
+/**
+ * @brief create an object managed by a shared_ptr, using a single allocation for the object and its reference counter.
+ *
+ * Without C++11 variadic templates, up to four arguments are supported, passed by const reference.
+ */
+template<class T>
+typename shared_ptr_traits<T>::single_ptr make_shared(void) // may throw std::bad_alloc or any exception of the T constructor
+{
+    return ::allocate_shared<T>(typename count_default_allocator<T>::type());
+}
+template<class T, class A1>
+typename shared_ptr_traits<T>::single_ptr make_shared(const A1& a1)
+{
+    return ::allocate_shared<T>(typename count_default_allocator<T>::type(), a1);
+}
+template<class T, class A1, class A2>
+typename shared_ptr_traits<T>::single_ptr make_shared(const A1& a1, const A2& a2)
+{
+    return ::allocate_shared<T>(typename count_default_allocator<T>::type(), a1, a2);
+}
+template<class T, class A1, class A2, class A3>
+typename shared_ptr_traits<T>::single_ptr make_shared(const A1& a1, const A2& a2, const A3& a3)
 {
-    return shared_ptr<T>(ptr, static_cast<typename shared_ptr<T>::element_type*>(ptr.get()));
+    return ::allocate_shared<T>(typename count_default_allocator<T>::type(), a1, a2, a3);
 }
+template<class T, class A1, class A2, class A3, class A4>
+typename shared_ptr_traits<T>::single_ptr make_shared(const A1& a1, const A2& a2, const A3& a3, const A4& a4)
+{
+    return ::allocate_shared<T>(typename count_default_allocator<T>::type(), a1, a2, a3, a4);
+}
+#endif
 
-// dynamic cast of shared_ptr
-template<class T, class U>
-shared_ptr<T> dynamic_pointer_cast(const shared_ptr<U>& ptr) // never throws
+/**
+ * @brief create an array of n value-initialized elements managed by a shared_ptr<T[]>, using a single allocation
+ *        from the provided allocator for the elements and their reference counter.
+ *
+ * @param[in] alloc allocator of elements, used for the control block, copied inside it to free it at the end
+ * @param[in] n     number of elements
+ */
+template<class T, class A>
+typename shared_ptr_traits<T>::array_ptr allocate_shared(const A& alloc, std::size_t n) // may throw std::bad_alloc or any exception of the constructor of the elements
 {
-    T* p = dynamic_cast<typename shared_ptr<T>::element_type*>(ptr.get());
-    if (NULL != p)
+    typedef count_inplace_array<typename shared_ptr_traits<T>::element_type, A> block_type;
+    block_type* block = block_type::create(alloc, n); // may throw std::bad_alloc
+    try
     {
-        return shared_ptr<T>(ptr, p);
+        block->construct();
     }
-    else
+    catch (...)
     {
-        return shared_ptr<T>();
+        block->destroy();
+        throw; // rethrow the exception of the constructor of the elements
     }
+#ifdef SHARED_PTR_STATS
+    block->track(shared_ptr_stats::of<T>()); // once the elements are constructed
+#endif
+    return shared_ptr<T>(static_cast<count_base*>(block), block->get());
+}
+
+/**
+ * @brief create an array of n value-initialized elements managed by a shared_ptr<T[]>, using a single allocation
+ *        for the elements and their reference counter.
+ *
+ * @param[in] n     number of elements
+ */
+template<class T>
+typename shared_ptr_traits<T>::array_ptr make_shared(std::size_t n) // may throw std::bad_alloc or any exception of the constructor of the elements
+{
+    return ::allocate_shared<T>(typename count_default_allocator<typename shared_ptr_traits<T>::element_type>::type(), n);
 }
@@ -0,0 +1,371 @@
+/**
+ * @file  shared_ptr_stats.hpp
+ * @brief shared_ptr_stats records per-type statistics of the reference counting of shared_ptr (SHARED_PTR_STATS).
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+// detect a C++11 compiler (MSVC does not report its real __cplusplus value by default)
+#if !defined(SHARED_PTR_CPP11) && ((__cplusplus >= 201103L) || (defined(_MSC_VER) && (_MSC_VER >= 1900)))
+#define SHARED_PTR_CPP11
+#endif
+
+#ifndef SHARED_PTR_CPP11
+#error "SHARED_PTR_STATS requires C++11 thread_local and <atomic>"
+#endif
+
+#include <cstddef>      // NULL, std::size_t
+#include <cstdlib>      // std::free
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <typeinfo>
+#if defined(__GNUG__)
+#include <cxxabi.h>     // abi::__cxa_demangle
+#endif
+
+#ifndef SHARED_PTR_STATS_MAX_TYPES
+#define SHARED_PTR_STATS_MAX_TYPES  64  // number of types counted by each thread, the next ones sharing global atomic counters
+#endif
+
+
+/**
+ * @brief instrumentation of the control blocks of shared_ptr, recording statistics for each type of managed object.
+ *
+ * For each type, it counts the control blocks allocated, the objects expired (their last reference released),
+ * the increments and decrements of the reference counter, and among them the ones made by another thread than
+ * the one that created the object (a hint of contention on the counter); it also tracks the peak use_count()
+ * and the lifetimes of the objects.
+ *
+ * The counters are kept per thread (a relaxed store, without atomic read-modify-write) and summed by get() and dump();
+ * the ones of a thread are merged in the totals of each type when it exits.
+ * Only the peak use_count() and the longest lifetime are global atomic maximums, updated when exceeded.
+ */
+class shared_ptr_stats
+{
+private:
+    // index of the summed counters
+    static const int allocations_index  = 0;
+    static const int expirations_index  = 1;
+    static const int increments_index   = 2;
+    static const int decrements_index   = 3;
+    static const int remote_index       = 4;
+    static const int lifetime_index     = 5;
+    static const int nb_sums            = 6;
+
+public:
+    /// statistics of a type of managed objects
+    struct counters
+    {
+        long long   allocations;    //!< Control blocks created
+        long long   expirations;    //!< Objects whose last reference has been released
+        long long   increments;     //!< References added (copies, weak_ptr::lock())
+        long long   decrements;     //!< References released
+        long long   remote;         //!< Increments and decrements made by another thread than the one that created the object
+        long long   total_lifetime; //!< Sum of the lifetimes of the expired objects, in nanoseconds
+        long long   peak_use_count; //!< Highest use_count() reached
+        long long   max_lifetime;   //!< Longest lifetime of an object, in nanoseconds
+
+        /// @brief number of objects still alive (or leaked)
+        long long live(void) const noexcept // never throws
+        {
+            return allocations - expirations;
+        }
+    };
+
+    /// record of a type of managed objects
+    class type_stats
+    {
+    public:
+        explicit type_stats(const char* type_name) noexcept; // never throws
+
+    private:
+        friend class shared_ptr_stats;
+
+        const char*             name;           //!< Mangled name of the type
+        std::size_t             id;             //!< Index of the per-thread counters of the type
+        std::atomic<long long>  totals[nb_sums]; //!< Sums of the exited threads (and of all threads beyond SHARED_PTR_STATS_MAX_TYPES)
+        std::atomic<long long>  peak_use_count; //!< Highest use_count() reached
+        std::atomic<long long>  max_lifetime;   //!< Longest lifetime of an object, in nanoseconds
+        type_stats*             next;           //!< Next type in the global list
+    };
+
+    /// instrumentation stored in each control block
+    struct block_stats
+    {
+        type_stats*                             type;       //!< Record of the type of the managed object
+        unsigned long long                      home;       //!< Identifier of the thread that created the object
+        std::chrono::steady_clock::time_point   created;    //!< Creation time of the object
+    };
+
+    /// type of the object pointed to by a pointer P
+    template<class P>
+    struct pointee
+    {
+        typedef P type;
+    };
+    template<class U>
+    struct pointee<U*>
+    {
+        typedef U type;
+    };
+
+    /// @brief record of the type T
+    template<class T>
+    static type_stats& of(void) noexcept // never throws
+    {
+        static type_stats stats(typeid(T).name());
+        return stats;
+    }
+    /// @brief statistics of the type T, summed over all the threads
+    template<class T>
+    static counters get(void) noexcept // never throws
+    {
+        return get(of<T>());
+    }
+    /// @brief statistics of a type, summed over all the threads
+    static counters get(const type_stats& type) noexcept // never throws
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        return sum(type);
+    }
+    /// @brief print the statistics of all the types, one line per type
+    static void dump(std::ostream& os) // may throw any exception of the stream
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        os << "shared_ptr_stats: allocations live increments decrements remote peak_use_count mean_lifetime_ns max_lifetime_ns type\n";
+        for (const type_stats* type = all_types().load(std::memory_order_acquire); NULL != type; type = type->next)
+        {
+            const counters values = sum(*type);
+            const long long mean_lifetime = (0 != values.expirations) ? (values.total_lifetime / values.expirations) : 0;
+            os << values.allocations << ' ' << values.live() << ' ' << values.increments << ' ' << values.decrements << ' '
+               << values.remote << ' ' << values.peak_use_count << ' ' << mean_lifetime << ' ' << values.max_lifetime << ' ';
+#if defined(__GNUG__)
+            int status = 0;
+            char* demangled = abi::__cxa_demangle(type->name, NULL, NULL, &status);
+            os << ((0 == status) ? demangled : type->name) << '\n';
+            std::free(demangled);
+#else
+            os << type->name << '\n';
+#endif
+        }
+    }
+
+    // hooks called by the control blocks
+    /// @brief a control block has been created for an object of the provided type
+    static void on_create(block_stats& block, type_stats& type) noexcept // never throws
+    {
+        block.type = &type;
+        block.home = thread_id();
+        block.created = std::chrono::steady_clock::now();
+        add(block, allocations_index, 1);
+        update_max(type.peak_use_count, 1);
+    }
+    /// @brief a reference has been added, the counter being now use_count
+    static void on_increment(const block_stats& block, long use_count) noexcept // never throws
+    {
+        if (NULL != block.type)
+        {
+            add(block, increments_index, 1);
+            update_max(block.type->peak_use_count, use_count);
+        }
+    }
+    /// @brief a reference is to be released
+    static void on_decrement(const block_stats& block) noexcept // never throws
+    {
+        if (NULL != block.type)
+        {
+            add(block, decrements_index, 1);
+        }
+    }
+    /// @brief the last reference has been released
+    static void on_expire(const block_stats& block) noexcept // never throws
+    {
+        if (NULL != block.type)
+        {
+            const long long lifetime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - block.created).count();
+            add(block, expirations_index, 1);
+            add(block, lifetime_index, lifetime);
+            update_max(block.type->max_lifetime, lifetime);
+        }
+    }
+
+private:
+    /// counters of a thread, registered while the thread is alive
+    struct thread_counters
+    {
+        thread_counters(void) noexcept // never throws
+        {
+            for (std::size_t i = 0; i < SHARED_PTR_STATS_MAX_TYPES; ++i)
+            {
+                for (int j = 0; j < nb_sums; ++j)
+                {
+                    sums[i][j].store(0, std::memory_order_relaxed);
+                }
+            }
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            next = all_threads();
+            all_threads() = this;
+        }
+        // merge the counters in the totals of each type at the exit of the thread
+        ~thread_counters(void) noexcept // never throws
+        {
+            local_thread() = NULL;
+            exited() = true;
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            for (type_stats* type = all_types().load(std::memory_order_acquire); NULL != type; type = type->next)
+            {
+                if (type->id < SHARED_PTR_STATS_MAX_TYPES)
+                {
+                    for (int j = 0; j < nb_sums; ++j)
+                    {
+                        type->totals[j].fetch_add(sums[type->id][j].load(std::memory_order_relaxed), std::memory_order_relaxed);
+                    }
+                }
+            }
+            thread_counters** link = &all_threads();
+            while (this != *link)
+            {
+                link = &(*link)->next;
+            }
+            *link = next;
+        }
+
+        std::atomic<long long>  sums[SHARED_PTR_STATS_MAX_TYPES][nb_sums];  //!< Counters of each type, only modified by the thread
+        thread_counters*        next;                                       //!< Next thread in the global list
+    };
+
+    /// @brief add to a counter of the current thread, or to the global one of the type
+    static void add(const block_stats& block, int index, long long value) noexcept // never throws
+    {
+        thread_counters* self = current_thread();
+        const bool is_remote = (index != allocations_index) && (index != lifetime_index) && (block.home != thread_id());
+        if ((NULL != self) && (block.type->id < SHARED_PTR_STATS_MAX_TYPES))
+        {
+            std::atomic<long long>& sum = self->sums[block.type->id][index];
+            sum.store(sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+            if (is_remote)
+            {
+                std::atomic<long long>& remote = self->sums[block.type->id][remote_index];
+                remote.store(remote.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+            }
+        }
+        else
+        {
+            block.type->totals[index].fetch_add(value, std::memory_order_relaxed);
+            if (is_remote)
+            {
+                block.type->totals[remote_index].fetch_add(value, std::memory_order_relaxed);
+            }
+        }
+    }
+    static void update_max(std::atomic<long long>& maximum, long long value) noexcept // never throws
+    {
+        long long current = maximum.load(std::memory_order_relaxed);
+        while ((current < value) && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        {
+        }
+    }
+    /// @brief sum the counters of a type (the registry mutex being locked)
+    static counters sum(const type_stats& type) noexcept // never throws
+    {
+        long long sums[nb_sums];
+        for (int j = 0; j < nb_sums; ++j)
+        {
+            sums[j] = type.totals[j].load(std::memory_order_relaxed);
+        }
+        if (type.id < SHARED_PTR_STATS_MAX_TYPES)
+        {
+            for (const thread_counters* thread = all_threads(); NULL != thread; thread = thread->next)
+            {
+                for (int j = 0; j < nb_sums; ++j)
+                {
+                    sums[j] += thread->sums[type.id][j].load(std::memory_order_relaxed);
+                }
+            }
+        }
+        counters values;
+        values.allocations      = sums[allocations_index];
+        values.expirations      = sums[expirations_index];
+        values.increments       = sums[increments_index];
+        values.decrements       = sums[decrements_index];
+        values.remote           = sums[remote_index];
+        values.total_lifetime   = sums[lifetime_index];
+        values.peak_use_count   = type.peak_use_count.load(std::memory_order_relaxed);
+        values.max_lifetime     = type.max_lifetime.load(std::memory_order_relaxed);
+        return values;
+    }
+
+    static thread_counters* current_thread(void) noexcept // never throws
+    {
+        if ((NULL == local_thread()) && !exited())
+        {
+            static thread_local thread_counters counters;
+            local_thread() = &counters;
+        }
+        return local_thread();
+    }
+    /// @brief identifier of the current thread, never reused by another one (unlike the address of its counters)
+    static unsigned long long thread_id(void) noexcept // never throws
+    {
+        static std::atomic<unsigned long long> last_id(0);
+        static thread_local unsigned long long id = 0;
+        if (0 == id)
+        {
+            id = last_id.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+        return id;
+    }
+    static thread_counters*& local_thread(void) noexcept // never throws
+    {
+        static thread_local thread_counters* self = NULL;
+        return self;
+    }
+    static bool& exited(void) noexcept // never throws
+    {
+        static thread_local bool has_exited = false;
+        return has_exited;
+    }
+    static std::mutex& registry_mutex(void) noexcept // never throws
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+    static std::atomic<type_stats*>& all_types(void) noexcept // never throws
+    {
+        static std::atomic<type_stats*> head(NULL);
+        return head;
+    }
+    static thread_counters*& all_threads(void) noexcept // never throws
+    {
+        static thread_counters* head = NULL;
+        return head;
+    }
+    static std::size_t next_id(void) noexcept // never throws
+    {
+        static std::size_t id = 0;
+        return id++;
+    }
+};
+
+inline shared_ptr_stats::type_stats::type_stats(const char* type_name) noexcept : // never throws
+    name(type_name),
+    id(0),
+    next(NULL)
+{
+    for (int j = 0; j < nb_sums; ++j)
+    {
+        totals[j].store(0, std::memory_order_relaxed);
+    }
+    peak_use_count.store(0, std::memory_order_relaxed);
+    max_lifetime.store(0, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    id = next_id();
+    next = all_types().load(std::memory_order_relaxed);
+    all_types().store(this, std::memory_order_release);
+}
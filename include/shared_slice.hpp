@@ -0,0 +1,187 @@
+/**
+ * @file  shared_slice.hpp
+ * @brief shared_slice is a view of a range of elements of a shared array, sharing its ownership without any copy.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include "shared_ptr.hpp"
+
+#include <cstring>      // memcpy
+
+
+/**
+ * @brief view of the elements [offset, offset + length) of an array managed by a shared_ptr<T[]>, sharing its ownership.
+ *
+ * A shared_slice is an aliasing shared_ptr to the first element of the range, and the number of elements:
+ * all the slices of an array share its control block, so that taking a sub-slice costs one increment of the
+ * reference counter and no allocation, and the array is released with the last of its slices.
+ * With the multi_threaded policy, the slices can be handed to other threads without copying the elements.
+ *
+ * Like a raw pointer, a shared_slice<const T> is a read-only view, converted from a shared_slice<T>.
+ */
+template<class T, class Policy = default_threading>
+class shared_slice
+{
+public:
+    /// The type of the elements of the array
+    typedef T               value_type;
+    /// The type of the shared_ptr to the array
+    typedef shared_ptr<T[], Policy> array_ptr;
+    /// Iterators are raw pointers to the elements
+    typedef T*              iterator;
+
+    /// @brief Default constructor of an empty slice
+    SHARED_CONSTEXPR shared_slice(void) SHARED_NOEXCEPT : // never throws
+        ptr(),
+        len(0)
+    {
+    }
+    /// @brief Constructor of a slice of the whole array (of the given number of elements), sharing its ownership
+    shared_slice(const array_ptr& array, std::size_t length) SHARED_NOEXCEPT : // never throws
+        ptr(array),
+        len(length)
+    {
+    }
+    /// @brief Constructor of a slice of the elements [offset, offset + length) of the array, sharing its ownership
+    shared_slice(const array_ptr& array, std::size_t offset, std::size_t length) SHARED_NOEXCEPT : // never throws
+        ptr(array, array.get() + offset), // aliasing constructor: no allocation
+        len(length)
+    {
+    }
+    /// @brief Copy constructor to convert from another element type (to a read-only slice)
+    template<class U>
+    shared_slice(const shared_slice<U, Policy>& slice) SHARED_NOEXCEPT : // never throws
+        ptr(slice.ptr),
+        len(slice.len)
+    {
+    }
+
+    /// @brief this reset releases its share of the ownership of the array
+    void reset(void) SHARED_NOEXCEPT // never throws
+    {
+        ptr.reset();
+        len = 0;
+    }
+    /// @brief Swap method for the copy-and-swap idiom (copy constructor and swap method)
+    void swap(shared_slice& lhs) SHARED_NOEXCEPT // never throws
+    {
+        ptr.swap(lhs.ptr);
+        std::swap(len, lhs.len);
+    }
+
+    /**
+     * @brief sub-slice of the elements [offset, offset + length) of this slice, sharing the ownership of the array
+     *
+     * Costs one increment of the reference counter, and no allocation.
+     */
+    shared_slice slice(std::size_t offset, std::size_t length) const SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT((offset <= len) && (length <= len - offset));
+        return shared_slice(ptr, offset, length);
+    }
+    /// @brief sub-slice of the elements from offset to the end of this slice
+    shared_slice slice(std::size_t offset) const SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT(offset <= len);
+        return shared_slice(ptr, offset, len - offset);
+    }
+    /// @brief drop the first n elements of this slice (without any allocation)
+    void remove_prefix(std::size_t n) SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT(n <= len);
+        array_ptr(ptr, ptr.get() + n).swap(ptr);
+        len -= n;
+    }
+    /// @brief drop the last n elements of this slice
+    void remove_suffix(std::size_t n) SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT(n <= len);
+        len -= n;
+    }
+
+    // reference counter operations :
+    operator bool() const SHARED_NOEXCEPT // never throws
+    {
+        return (NULL != ptr.get());
+    }
+    /// @brief number of shared_ptr and slices sharing the ownership of the array
+    long use_count(void) const SHARED_NOEXCEPT // never throws
+    {
+        return ptr.use_count();
+    }
+    /// @brief aliasing shared_ptr to the first element of the slice, sharing the ownership of the array
+    const array_ptr& get_shared(void) const SHARED_NOEXCEPT // never throws
+    {
+        return ptr;
+    }
+
+    // underlying elements operations :
+    T* data(void) const SHARED_NOEXCEPT // never throws
+    {
+        // no assert, can return NULL
+        return ptr.get();
+    }
+    std::size_t size(void) const SHARED_NOEXCEPT // never throws
+    {
+        return len;
+    }
+    bool empty(void) const SHARED_NOEXCEPT // never throws
+    {
+        return (0 == len);
+    }
+    T& operator[](std::size_t i) const SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT(i < len);
+        return ptr.get()[i];
+    }
+    iterator begin(void) const SHARED_NOEXCEPT // never throws
+    {
+        return ptr.get();
+    }
+    iterator end(void) const SHARED_NOEXCEPT // never throws
+    {
+        return ptr.get() + len;
+    }
+
+private:
+    // all shared_slice specializations can convert from one another
+    template<class U, class P> friend class shared_slice;
+
+    array_ptr   ptr;    //!< Aliasing pointer to the first element of the slice, sharing the control block of the array
+    std::size_t len;    //!< Number of elements of the slice
+};
+
+
+/// @brief shared receive buffer of bytes, sliced without copy into the records it contains
+typedef shared_slice<unsigned char> shared_buffer;
+
+/**
+ * @brief create a value-initialized buffer of size bytes, allocated with its reference counter in a single memory block.
+ *
+ * @param[in] size  number of bytes of the buffer
+ */
+inline shared_buffer make_shared_buffer(std::size_t size) // may throw std::bad_alloc
+{
+    return shared_buffer(make_shared<unsigned char[]>(size), size);
+}
+
+/**
+ * @brief create a buffer holding a copy of size bytes, allocated with its reference counter in a single memory block.
+ *
+ * @param[in] data  bytes to copy once into the buffer
+ * @param[in] size  number of bytes to copy
+ */
+inline shared_buffer make_shared_buffer(const void* data, std::size_t size) // may throw std::bad_alloc
+{
+    shared_buffer buffer = make_shared_buffer(size); // may throw std::bad_alloc
+    if (0 < size)
+    {
+        std::memcpy(buffer.data(), data, size);
+    }
+    return buffer;
+}
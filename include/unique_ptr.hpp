@@ -14,14 +14,36 @@
 #include <cstddef>      // NULL
 #include <algorithm>    // std::swap
 
-// can be replaced by other error mechanism
-#include <cassert>
-#define SHARED_ASSERT(x)    assert(x)
+// checks with a configurable level and handler (SHARED_ASSERT_LEVEL, SHARED_ASSERT_HANDLER)
+#include "shared_assert.hpp"
 
+// detect a C++11 compiler (MSVC does not report its real __cplusplus value by default)
+#if !defined(SHARED_PTR_CPP11) && ((__cplusplus >= 201103L) || (defined(_MSC_VER) && (_MSC_VER >= 1900)))
+#define SHARED_PTR_CPP11
+#endif
 
+// noexcept and constexpr with a C++11 compiler, fallback to a dynamic exception specification on older compilers
+#ifndef SHARED_NOEXCEPT
+#ifdef SHARED_PTR_CPP11
+#define SHARED_NOEXCEPT     noexcept
+#define SHARED_CONSTEXPR    constexpr
+#else
+#define SHARED_NOEXCEPT     throw()
+#define SHARED_CONSTEXPR
+#endif
+#endif
+
+#ifdef SHARED_PTR_CPP11
+#include <utility>      // std::move
+#include <type_traits>  // std::is_class, std::is_final, std::is_convertible, std::enable_if
+#include <functional>   // std::hash
+#else
 /**
  * @brief fake implementation to use in place of a C++11 std::move() when compiling on an older compiler.
  *
+ * Only defined for older compilers, to never collide with std::move(): portable code can call move()
+ * unqualified after a "using std::move;" guarded by SHARED_PTR_CPP11.
+ *
  * @see http://www.cplusplus.com/reference/utility/move/
 */
 template <typename T>
@@ -29,6 +51,141 @@ inline T& move(T& v)
 {
     return v;
 }
+#endif
+
+
+/**
+ * @brief default deleter of unique_ptr, a subset of the C++11 std::default_delete: delete for an object, delete[] for an array.
+ */
+template<class T>
+struct default_delete
+{
+#ifdef SHARED_PTR_CPP11
+    constexpr default_delete(void) noexcept = default;
+    /// @brief converting constructor, letting a unique_ptr<Derived> be moved to a unique_ptr<Base>
+    template<class U, class = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+    default_delete(const default_delete<U>&) noexcept // never throws
+    {
+    }
+#endif
+    void operator()(T* p) const SHARED_NOEXCEPT // never throws
+    {
+        delete p;
+    }
+};
+template<class T>
+struct default_delete<T[]>
+{
+    void operator()(T* p) const SHARED_NOEXCEPT // never throws
+    {
+        delete[] p;
+    }
+};
+
+/**
+ * @brief type of the elements of a unique_ptr<T>, T being either a single object or an array T[] of elements.
+ */
+template<class T>
+struct unique_ptr_traits
+{
+    typedef T element_type;
+};
+template<class T>
+struct unique_ptr_traits<T[]>
+{
+    typedef T element_type;
+};
+
+#ifdef SHARED_PTR_CPP11
+/**
+ * @brief compile-time check of the conversion of a unique_ptr<U> to a unique_ptr<T>:
+ *        an object to an object of a base class, or an array to an array of the same (but more qualified) elements.
+ */
+template<class U, class T>
+struct unique_ptr_convertible
+{
+    static const bool value = std::is_convertible<U*, T*>::value;
+};
+template<class U, class T>
+struct unique_ptr_convertible<U[], T>
+{
+    static const bool value = false;
+};
+template<class U, class T>
+struct unique_ptr_convertible<U, T[]>
+{
+    static const bool value = false;
+};
+template<class U, class T>
+struct unique_ptr_convertible<U[], T[]>
+{
+    static const bool value = std::is_convertible<U(*)[], T(*)[]>::value;
+};
+#endif
+
+/**
+ * @brief compile-time detection of class types, which can be used as an empty base.
+ */
+template<class D>
+struct unique_ptr_is_class
+{
+#ifdef SHARED_PTR_CPP11
+#if (__cplusplus >= 201402L) || (defined(_MSVC_LANG) && (_MSVC_LANG >= 201402L))
+    static const bool value = std::is_class<D>::value && !std::is_final<D>::value;
+#else
+    static const bool value = std::is_class<D>::value;
+#endif
+#else
+private:
+    struct yes { char c[1]; };
+    struct no  { char c[2]; };
+    template<class U> static yes test(int U::*);
+    template<class U> static no  test(...);
+public:
+    static const bool value = (sizeof(test<D>(0)) == sizeof(yes));
+#endif
+};
+
+/**
+ * @brief storage of the deleter of a unique_ptr, using the empty base optimization for classes
+ *        so that a stateless deleter takes no space: sizeof(unique_ptr<T, D>) == sizeof(T*).
+ */
+template<class D, bool IsClass = unique_ptr_is_class<D>::value>
+class unique_ptr_deleter : private D
+{
+public:
+    SHARED_CONSTEXPR explicit unique_ptr_deleter(const D& d) SHARED_NOEXCEPT : // never throws
+        D(d)
+    {
+    }
+    D& deleter(void) SHARED_NOEXCEPT // never throws
+    {
+        return *this;
+    }
+    const D& deleter(void) const SHARED_NOEXCEPT // never throws
+    {
+        return *this;
+    }
+};
+template<class D>
+class unique_ptr_deleter<D, false>
+{
+public:
+    SHARED_CONSTEXPR explicit unique_ptr_deleter(const D& d) SHARED_NOEXCEPT : // never throws
+        del(d)
+    {
+    }
+    D& deleter(void) SHARED_NOEXCEPT // never throws
+    {
+        return del;
+    }
+    const D& deleter(void) const SHARED_NOEXCEPT // never throws
+    {
+        return del;
+    }
+private:
+    D   del;    //!< Deleter, typically a function pointer
+};
 
 
 /**
@@ -39,144 +196,266 @@ inline T& move(T& v)
  * It does not allow sharing this ownership (but moving it is possible)
  * and destroys the object when the pointer is destroyed or reset.
  *
- * This implementation is a fake one, to use when compiling on an older compiler that does not have the move semantic.
+ * With a C++11 compiler it is a real move-only type: it cannot be copied, and its noexcept move operations
+ * let the standard containers move the pointers when they reallocate.
+ *
+ * On an older compiler that does not have the move semantic, the copy transfers the ownership (like std::auto_ptr).
  * As such, it cannot offer any guaranty that the pointer is not copied!
  * It is still usable in production on such a compiler if you also compile
  * your program on a recent compiler to verify that it does not violate this guaranty.
+ *
+ * unique_ptr<T[]> manages an array allocated with new[], deleted with delete[] and accessed with operator[].
+ *
+ * unique_ptr<T, D> releases the object with a custom deleter D (a function object or a function pointer),
+ * for instance to give it back to a pool or to close a handle. A stateless deleter class is stored
+ * with the empty base optimization, so that it does not add anything to the size of the pointer.
  */
-template<class T>
-class unique_ptr
+template<class T, class D = default_delete<T> >
+class unique_ptr : private unique_ptr_deleter<D>
 {
 public:
-    /// The type of the managed object, aliased as member type
-    typedef T element_type;
+    /// The type of the managed object (or of the elements of the managed array), aliased as member type
+    typedef typename unique_ptr_traits<T>::element_type element_type;
+    /// The type of the deleter, aliased as member type
+    typedef D deleter_type;
 
-    /// @brief Default constructor
-    unique_ptr(void) throw() : // never throws
+    /// @brief Default constructor (constant initialization of a static unique_ptr, without dynamic initializer)
+    SHARED_CONSTEXPR unique_ptr(void) SHARED_NOEXCEPT : // never throws
+        unique_ptr_deleter<D>(D()),
         px(NULL)
     {
     }
+#ifdef SHARED_PTR_CPP11
+    /// @brief Constructor of an empty unique_ptr from nullptr
+    constexpr unique_ptr(std::nullptr_t) noexcept : // never throws
+        unique_ptr_deleter<D>(D()),
+        px(nullptr)
+    {
+    }
+#endif
     /// @brief Constructor with the provided pointer to manage
-    explicit unique_ptr(T* p) throw() : // never throws
+    explicit unique_ptr(element_type* p) SHARED_NOEXCEPT : // never throws
+        unique_ptr_deleter<D>(D()),
+        px(p)
+    {
+    }
+    /// @brief Constructor with the provided pointer to manage, and the custom deleter to release it
+    unique_ptr(element_type* p, const D& d) SHARED_NOEXCEPT : // never throws
+        unique_ptr_deleter<D>(d),
         px(p)
     {
     }
+#ifdef SHARED_PTR_CPP11
+    /// @brief Move constructor, transferring the ownership
+    unique_ptr(unique_ptr&& ptr) SHARED_NOEXCEPT : // never throws
+        unique_ptr_deleter<D>(ptr.get_deleter()),
+        px(ptr.release())
+    {
+    }
+    /// @brief Move constructor to convert from another pointer type, transferring the ownership
+    ///        (only from an object to an object of a base class, never between an array and an object)
+    template <class U, class E, class = typename std::enable_if<unique_ptr_convertible<U, T>::value>::type>
+    unique_ptr(unique_ptr<U, E>&& ptr) SHARED_NOEXCEPT : // never throws
+        unique_ptr_deleter<D>(ptr.get_deleter()),
+        px(ptr.release())
+    {
+    }
+    /// @brief Move assignment operator, transferring the ownership
+    unique_ptr& operator=(unique_ptr&& ptr) SHARED_NOEXCEPT // never throws
+    {
+        reset(ptr.release());
+        get_deleter() = ptr.get_deleter();
+        return *this;
+    }
+    /// @brief Assignment of nullptr, destroying the object
+    unique_ptr& operator=(std::nullptr_t) noexcept // never throws
+    {
+        destroy();
+        return *this;
+    }
+    // non-copyable
+    unique_ptr(const unique_ptr&) = delete;
+    unique_ptr& operator=(const unique_ptr&) = delete;
+#else
     /// @brief Copy constructor to convert from another pointer type
     /* TODO MSVC error C2248: 'unique_ptr<B>::px' : unique_ptr<A> cannot access private member declared in class 'unique_ptr<B>'
     template <class U>
-    unique_ptr(const unique_ptr<U>& ptr) throw() : // never throws
+    unique_ptr(const unique_ptr<U>& ptr) SHARED_NOEXCEPT : // never throws
         px(static_cast<typename unique_ptr<T>::element_type*>(ptr.px))
     {
         const_cast<unique_ptr<U>&>(ptr).px = NULL; // const-cast to force ownership transfer!
     }
     */
-    /// @brief Copy constructor (used by the copy-and-swap idiom)
-    unique_ptr(const unique_ptr& ptr) throw() : // never throws
+    /// @brief Copy constructor (used by the copy-and-swap idiom), transferring the ownership like std::auto_ptr
+    unique_ptr(const unique_ptr& ptr) SHARED_NOEXCEPT : // never throws
+        unique_ptr_deleter<D>(ptr.get_deleter()),
         px(ptr.px)
     {
         const_cast<unique_ptr&>(ptr).px = NULL; // const-cast to force ownership transfer!
     }
     /// @brief Assignment operator using the copy-and-swap idiom (copy constructor and swap method)
-    unique_ptr& operator=(unique_ptr ptr) throw() // never throws
+    unique_ptr& operator=(unique_ptr ptr) SHARED_NOEXCEPT // never throws
     {
         swap(ptr);
         return *this;
     }
+#endif
     /// @brief the destructor releases its ownership and destroy the object
-    inline ~unique_ptr(void) throw() // never throws
+    inline ~unique_ptr(void) SHARED_NOEXCEPT // never throws
     {
         destroy();
     }
     /// @brief this reset releases its ownership and destroy the object
-    inline void reset(void) throw() // never throws
+    inline void reset(void) SHARED_NOEXCEPT // never throws
     {
         destroy();
     }
     /// @brief this reset release its ownership and re-acquire another one
-    void reset(T* p) throw() // never throws
+    void reset(element_type* p) SHARED_NOEXCEPT // never throws
     {
         SHARED_ASSERT((NULL == p) || (px != p)); // auto-reset not allowed
-        destroy();
-        px = p;
+        element_type* old = px;
+        px = p; // before the deleter, like std::unique_ptr, which lets it be a tail call
+        if (NULL != old)
+        {
+            get_deleter()(old);
+        }
     }
 
     /// @brief Swap method for the copy-and-swap idiom (copy constructor and swap method)
-    void swap(unique_ptr& lhs) throw() // never throws
+    void swap(unique_ptr& lhs) SHARED_NOEXCEPT // never throws
     {
         std::swap(px, lhs.px);
+        std::swap(get_deleter(), lhs.get_deleter());
     }
 
-    /// @brief release the ownership of the px pointer without destroying the object!
-    inline void release(void) throw() // never throws
+    /// @brief release the ownership of the px pointer without destroying the object, returning it!
+    inline element_type* release(void) SHARED_NOEXCEPT // never throws
     {
+        element_type* p = px;
         px = NULL;
+        return p;
     }
 
     // reference counter operations :
-    inline operator bool() const throw() // never throws
+    inline operator bool() const SHARED_NOEXCEPT // never throws
     {
-        return (NULL != px); // TODO nullptr
+        return (NULL != px);
     }
 
     // underlying pointer operations :
-    inline T& operator*()  const throw() // never throws
+    inline element_type& operator*()  const SHARED_NOEXCEPT // never throws
     {
         SHARED_ASSERT(NULL != px);
         return *px;
     }
-    inline T* operator->() const throw() // never throws
+    inline element_type* operator->() const SHARED_NOEXCEPT // never throws
     {
         SHARED_ASSERT(NULL != px);
         return px;
     }
-    inline T* get(void)  const throw() // never throws
+    /// @brief access to an element of a managed array (unique_ptr<T[]>)
+    inline element_type& operator[](std::size_t i) const SHARED_NOEXCEPT // never throws
+    {
+        SHARED_ASSERT(NULL != px);
+        return px[i];
+    }
+    inline element_type* get(void)  const SHARED_NOEXCEPT // never throws
     {
         // no assert, can return NULL
         return px;
     }
 
-private:
-    /// @brief release the ownership of the px pointer and destroy the object
-    inline void destroy(void) throw() // never throws
+    // deleter operations :
+    inline D& get_deleter(void) SHARED_NOEXCEPT // never throws
     {
-        delete px;
-        px = NULL;
+        return this->deleter();
+    }
+    inline const D& get_deleter(void) const SHARED_NOEXCEPT // never throws
+    {
+        return this->deleter();
     }
 
-    /// @brief hack: const-cast release the ownership of the px pointer without destroying the object!
-    inline void release(void) const throw() // never throws
+private:
+    /// @brief release the ownership of the px pointer and destroy the object (the deleter is never called with NULL)
+    inline void destroy(void) SHARED_NOEXCEPT // never throws
     {
-        px = NULL;
+        element_type* p = px;
+        px = NULL; // before the deleter, which can then be a tail call
+        if (NULL != p)
+        {
+            get_deleter()(p);
+        }
     }
 
 private:
-    T* px; //!< Native pointer
+    element_type* px; //!< Native pointer
 };
 
 
 // comparaison operators
-template<class T, class U> inline bool operator==(const unique_ptr<T>& l, const unique_ptr<U>& r) throw() // never throws
+template<class T, class D, class U, class E> inline bool operator==(const unique_ptr<T, D>& l, const unique_ptr<U, E>& r) SHARED_NOEXCEPT // never throws
 {
     return (l.get() == r.get());
 }
-template<class T, class U> inline bool operator!=(const unique_ptr<T>& l, const unique_ptr<U>& r) throw() // never throws
+template<class T, class D, class U, class E> inline bool operator!=(const unique_ptr<T, D>& l, const unique_ptr<U, E>& r) SHARED_NOEXCEPT // never throws
 {
     return (l.get() != r.get());
 }
-template<class T, class U> inline bool operator<=(const unique_ptr<T>& l, const unique_ptr<U>& r) throw() // never throws
+template<class T, class D, class U, class E> inline bool operator<=(const unique_ptr<T, D>& l, const unique_ptr<U, E>& r) SHARED_NOEXCEPT // never throws
 {
     return (l.get() <= r.get());
 }
-template<class T, class U> inline bool operator<(const unique_ptr<T>& l, const unique_ptr<U>& r) throw() // never throws
+template<class T, class D, class U, class E> inline bool operator<(const unique_ptr<T, D>& l, const unique_ptr<U, E>& r) SHARED_NOEXCEPT // never throws
 {
     return (l.get() < r.get());
 }
-template<class T, class U> inline bool operator>=(const unique_ptr<T>& l, const unique_ptr<U>& r) throw() // never throws
+template<class T, class D, class U, class E> inline bool operator>=(const unique_ptr<T, D>& l, const unique_ptr<U, E>& r) SHARED_NOEXCEPT // never throws
 {
     return (l.get() >= r.get());
 }
-template<class T, class U> inline bool operator>(const unique_ptr<T>& l, const unique_ptr<U>& r) throw() // never throws
+template<class T, class D, class U, class E> inline bool operator>(const unique_ptr<T, D>& l, const unique_ptr<U, E>& r) SHARED_NOEXCEPT // never throws
 {
     return (l.get() > r.get());
 }
 
+#ifdef SHARED_PTR_CPP11
+template<class T, class D> inline bool operator==(const unique_ptr<T, D>& l, std::nullptr_t) noexcept // never throws
+{
+    return !l;
+}
+template<class T, class D> inline bool operator==(std::nullptr_t, const unique_ptr<T, D>& r) noexcept // never throws
+{
+    return !r;
+}
+template<class T, class D> inline bool operator!=(const unique_ptr<T, D>& l, std::nullptr_t) noexcept // never throws
+{
+    return static_cast<bool>(l);
+}
+template<class T, class D> inline bool operator!=(std::nullptr_t, const unique_ptr<T, D>& r) noexcept // never throws
+{
+    return static_cast<bool>(r);
+}
+#endif
+
+/// @brief raw pointer managed by a unique_ptr, for the generic code handling smart and raw pointers alike (like boost::get_pointer)
+template<class T, class D>
+inline typename unique_ptr<T, D>::element_type* get_pointer(const unique_ptr<T, D>& ptr) SHARED_NOEXCEPT // never throws
+{
+    return ptr.get();
+}
+
+#ifdef SHARED_PTR_CPP11
+namespace std
+{
+/// @brief hash of a unique_ptr by the address of its object, like the one of std::unique_ptr
+template<class T, class D>
+struct hash< ::unique_ptr<T, D> >
+{
+    std::size_t operator()(const ::unique_ptr<T, D>& ptr) const noexcept // never throws
+    {
+        return hash<typename ::unique_ptr<T, D>::element_type*>()(ptr.get());
+    }
+};
+} // namespace std
+#endif
@@ -0,0 +1,223 @@
+/**
+ * @file  atomic_shared_ptr_test.cpp
+ * @brief Multi-threaded Unit Test of this atomic_shared_ptr minimal implementation using Google Test library (SHARED_PTR_THREAD_SAFE).
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include "atomic_shared_ptr.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+struct Snapshot
+{
+    explicit Snapshot(int aVal) :
+        mVal(aVal),
+        mCheck(aVal)
+    {
+        ++_mNbInstances;
+    }
+    ~Snapshot(void)
+    {
+        mCheck = -1;
+        --_mNbInstances;
+    }
+
+    int                     mVal;
+    int                     mCheck; //!< Same as mVal as long as the object is alive
+    static std::atomic<int> _mNbInstances;
+};
+
+std::atomic<int> Snapshot::_mNbInstances(0);
+
+// deleter doing nothing, to share a pointer without owning it
+struct NoDelete
+{
+    void operator()(Snapshot*) const
+    {
+    }
+};
+
+static const int    NB_READERS  = 6;
+static const int    NB_WRITERS  = 2;
+static const int    NB_LOOPS    = 20000;
+
+
+TEST(atomic_shared_ptr, empty_ptr)
+{
+    // Create an empty (ie. NULL) atomic_shared_ptr
+    atomic_shared_ptr<Snapshot> xPtr;
+
+    EXPECT_EQ(true, xPtr.is_lock_free());
+    EXPECT_EQ(false, xPtr.load());
+    EXPECT_EQ(0, xPtr.load().use_count());
+
+    // Store and exchange an empty shared_ptr
+    xPtr.store(shared_ptr<Snapshot>());
+    EXPECT_EQ(false, xPtr.load());
+    EXPECT_EQ(false, xPtr.exchange(shared_ptr<Snapshot>()));
+
+    // Compare an empty shared_ptr
+    shared_ptr<Snapshot> expected;
+    EXPECT_EQ(true, xPtr.compare_exchange_strong(expected, shared_ptr<Snapshot>()));
+    EXPECT_EQ(false, xPtr.load());
+}
+
+TEST(atomic_shared_ptr, basic_ptr)
+{
+    {
+        shared_ptr<Snapshot> first(new Snapshot(1));
+        atomic_shared_ptr<Snapshot> xPtr(first);
+        EXPECT_EQ(2, first.use_count());
+
+        // Load a copy
+        shared_ptr<Snapshot> loaded = xPtr.load();
+        EXPECT_EQ(first, loaded);
+        EXPECT_EQ(3, first.use_count());
+        loaded = xPtr;
+        EXPECT_EQ(3, first.use_count());
+
+        // Store another value
+        xPtr = shared_ptr<Snapshot>(new Snapshot(2));
+        EXPECT_EQ(2, Snapshot::_mNbInstances);
+        EXPECT_EQ(2, first.use_count());
+        EXPECT_EQ(2, xPtr.load()->mVal);
+
+        // Exchange it back
+        shared_ptr<Snapshot> second = xPtr.exchange(first);
+        EXPECT_EQ(2, second->mVal);
+        EXPECT_EQ(1, second.use_count());
+        EXPECT_EQ(first, xPtr.load());
+
+        // Empty it
+        loaded.reset();
+        first.reset();
+        second.reset();
+        EXPECT_EQ(1, Snapshot::_mNbInstances);
+        xPtr.store(shared_ptr<Snapshot>());
+        EXPECT_EQ(0, Snapshot::_mNbInstances);
+        EXPECT_EQ(false, xPtr.load());
+    }
+    EXPECT_EQ(0, Snapshot::_mNbInstances);
+}
+
+TEST(atomic_shared_ptr, compare_exchange)
+{
+    {
+        shared_ptr<Snapshot> first(new Snapshot(1));
+        shared_ptr<Snapshot> second(new Snapshot(2));
+        atomic_shared_ptr<Snapshot> xPtr(first);
+
+        // Fail, updating the expected value
+        shared_ptr<Snapshot> expected = second;
+        EXPECT_EQ(false, xPtr.compare_exchange_strong(expected, second));
+        EXPECT_EQ(first, expected);
+        EXPECT_EQ(first, xPtr.load());
+        EXPECT_EQ(3, first.use_count());
+        EXPECT_EQ(1, second.use_count());
+
+        // Succeed
+        EXPECT_EQ(true, xPtr.compare_exchange_strong(expected, second));
+        EXPECT_EQ(first, expected);
+        EXPECT_EQ(second, xPtr.load());
+        EXPECT_EQ(2, first.use_count());
+        EXPECT_EQ(2, second.use_count());
+
+        // Another shared_ptr to the same object does not share the same control block
+        shared_ptr<Snapshot> other(second.get(), NoDelete());
+        EXPECT_EQ(false, xPtr.compare_exchange_weak(other, first));
+        EXPECT_EQ(second, other);
+    }
+    EXPECT_EQ(0, Snapshot::_mNbInstances);
+}
+
+// multi-threaded tests
+
+// load the value many times, checking that it is always alive
+static void read_snapshots(const atomic_shared_ptr<Snapshot>* apPtr, std::atomic<int>* apNbErrors)
+{
+    for (int i = 0; i < NB_LOOPS; ++i)
+    {
+        const shared_ptr<Snapshot> snapshot = apPtr->load();
+        if (!snapshot || (snapshot->mCheck != snapshot->mVal))
+        {
+            ++(*apNbErrors);
+        }
+    }
+}
+
+// publish new values many times, with store, exchange and compare_exchange
+static void write_snapshots(atomic_shared_ptr<Snapshot>* apPtr, int aFirst)
+{
+    for (int i = 0; i < NB_LOOPS / 10; ++i)
+    {
+        apPtr->store(shared_ptr<Snapshot>(new Snapshot(aFirst + i)));
+        apPtr->exchange(shared_ptr<Snapshot>(new Snapshot(aFirst + i)));
+        shared_ptr<Snapshot> expected = apPtr->load();
+        apPtr->compare_exchange_strong(expected, shared_ptr<Snapshot>(new Snapshot(aFirst + i)));
+    }
+}
+
+TEST(atomic_shared_ptr, concurrent_loads_stores)
+{
+    {
+        atomic_shared_ptr<Snapshot> xPtr(shared_ptr<Snapshot>(new Snapshot(0)));
+        std::atomic<int> nbErrors(0);
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < NB_READERS; ++i)
+        {
+            threads.push_back(std::thread(read_snapshots, &xPtr, &nbErrors));
+        }
+        for (int i = 0; i < NB_WRITERS; ++i)
+        {
+            threads.push_back(std::thread(write_snapshots, &xPtr, (i + 1) * NB_LOOPS));
+        }
+        for (size_t i = 0; i < threads.size(); ++i)
+        {
+            threads[i].join();
+        }
+
+        EXPECT_EQ(0, nbErrors);
+#ifdef SHARED_PTR_BIASED
+        // the references of the owner thread released by the other threads are merged by the owner thread
+        biased_count::merge_queued();
+#endif
+        // only the last stored value is still alive, owned by the atomic_shared_ptr only
+        EXPECT_EQ(1, Snapshot::_mNbInstances);
+        EXPECT_EQ(2, xPtr.load().use_count());
+    }
+    EXPECT_EQ(0, Snapshot::_mNbInstances);
+}
+
+TEST(atomic_shared_ptr, concurrent_compare_exchange)
+{
+    // all the threads increment the value with a compare-exchange loop: no increment can be lost
+    atomic_shared_ptr<Snapshot> xPtr(shared_ptr<Snapshot>(new Snapshot(0)));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < NB_WRITERS + NB_READERS; ++i)
+    {
+        threads.push_back(std::thread([&xPtr]()
+        {
+            for (int j = 0; j < NB_LOOPS / 10; ++j)
+            {
+                shared_ptr<Snapshot> expected = xPtr.load();
+                while (!xPtr.compare_exchange_weak(expected, shared_ptr<Snapshot>(new Snapshot(expected->mVal + 1))))
+                {
+                }
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i].join();
+    }
+    EXPECT_EQ((NB_WRITERS + NB_READERS) * (NB_LOOPS / 10), xPtr.load()->mVal);
+}
@@ -0,0 +1,213 @@
+/**
+ * @file  biased_count_test.cpp
+ * @brief Multi-threaded Unit Test of the biased reference counting of shared_ptr (SHARED_PTR_BIASED) using Google Test library.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#ifndef SHARED_PTR_BIASED
+#error "this test must be compiled with SHARED_PTR_BIASED defined"
+#endif
+
+#include "shared_ptr.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+struct Biased
+{
+    Biased(void)
+    {
+        ++_mNbInstances;
+    }
+    ~Biased(void)
+    {
+        --_mNbInstances;
+    }
+
+    static std::atomic<int> _mNbInstances;
+};
+
+std::atomic<int> Biased::_mNbInstances(0);
+
+
+TEST(biased_count, owner_thread)
+{
+    {
+        // All the references are local to the owner thread
+        shared_ptr<Biased> xPtr(new Biased);
+        shared_ptr<Biased> yPtr = make_shared<Biased>();
+        shared_ptr<Biased> copyPtr(xPtr);
+        EXPECT_EQ(2, xPtr.use_count());
+        weak_ptr<Biased> wPtr(xPtr);
+        EXPECT_EQ(xPtr, wPtr.lock());
+        EXPECT_EQ(2, xPtr.use_count());
+        copyPtr.reset();
+        EXPECT_EQ(true, xPtr.unique());
+        xPtr.reset();
+        EXPECT_EQ(true, wPtr.expired());
+        EXPECT_EQ(1, Biased::_mNbInstances);
+    }
+    EXPECT_EQ(0, Biased::_mNbInstances);
+}
+
+TEST(biased_count, shared_by_another_thread)
+{
+    weak_ptr<Biased> wPtr;
+    {
+        shared_ptr<Biased> xPtr(new Biased);
+        wPtr = xPtr;
+        std::thread thread([&xPtr]()
+        {
+            // copies made by another thread use the shared counter
+            shared_ptr<Biased> copyPtr(xPtr);
+            shared_ptr<Biased> otherPtr(copyPtr);
+            EXPECT_EQ(3, xPtr.use_count());
+        });
+        thread.join();
+        EXPECT_EQ(true, xPtr.unique());
+    }
+    // the last reference was local to the owner: destroyed immediately
+    EXPECT_EQ(true, wPtr.expired());
+    EXPECT_EQ(0, Biased::_mNbInstances);
+}
+
+TEST(biased_count, handed_to_another_thread)
+{
+    weak_ptr<Biased> wPtr;
+    {
+        shared_ptr<Biased> xPtr(new Biased);
+        wPtr = xPtr;
+        // the reference copied by the owner thread is released by another thread
+        std::thread thread([](shared_ptr<Biased> aPtr)
+        {
+            EXPECT_EQ(2, aPtr.use_count());
+        }, xPtr);
+        thread.join();
+        EXPECT_EQ(1, xPtr.use_count());
+    }
+    // the last release by the owner merged the shared counter
+    EXPECT_EQ(true, wPtr.expired());
+    EXPECT_EQ(0, Biased::_mNbInstances);
+
+    {
+        shared_ptr<Biased> xPtr(new Biased);
+        wPtr = xPtr;
+        std::thread thread([](shared_ptr<Biased> aPtr)
+        {
+            EXPECT_EQ(true, aPtr.unique());
+            EXPECT_EQ(1, Biased::_mNbInstances);
+        }, std::move(xPtr));
+        thread.join();
+        // the only reference, local to the owner, has been released by another thread: queued to the owner
+        EXPECT_EQ(1, Biased::_mNbInstances);
+        biased_count::merge_queued();
+        EXPECT_EQ(0, Biased::_mNbInstances);
+        EXPECT_EQ(true, wPtr.expired());
+    }
+}
+
+TEST(biased_count, lock_after_release_by_another_thread)
+{
+    weak_ptr<Biased> wPtr;
+    {
+        shared_ptr<Biased> xPtr(new Biased);
+        wPtr = xPtr;
+        // the only reference, local to the owner, is released by another thread
+        std::thread thread([](shared_ptr<Biased> aPtr)
+        {
+            EXPECT_EQ(true, aPtr.unique());
+        }, std::move(xPtr));
+        thread.join();
+    }
+    // the object waits in the queue of the owner to be destroyed, but it is already expired for all the threads
+    EXPECT_EQ(1, Biased::_mNbInstances);
+    EXPECT_EQ(true, wPtr.expired());
+    EXPECT_EQ(0, wPtr.use_count());
+    EXPECT_EQ(false, wPtr.lock());
+    std::thread other([&wPtr]()
+    {
+        EXPECT_EQ(true, wPtr.expired());
+        EXPECT_EQ(false, wPtr.lock());
+    });
+    other.join();
+    biased_count::merge_queued();
+    EXPECT_EQ(0, Biased::_mNbInstances);
+
+    {
+        // with a reference still local to the owner, the object can be locked by any thread
+        shared_ptr<Biased> xPtr(new Biased);
+        shared_ptr<Biased> copyPtr(xPtr);
+        wPtr = xPtr;
+        std::thread thread([](shared_ptr<Biased>)
+        {
+        }, std::move(copyPtr));
+        thread.join();
+        EXPECT_EQ(1, xPtr.use_count());
+        std::thread locker([&wPtr]()
+        {
+            EXPECT_EQ(false, wPtr.expired());
+            EXPECT_EQ(true, static_cast<bool>(wPtr.lock()));
+        });
+        locker.join();
+        EXPECT_EQ(xPtr, wPtr.lock());
+    }
+    biased_count::merge_queued();
+    EXPECT_EQ(true, wPtr.expired());
+    EXPECT_EQ(0, Biased::_mNbInstances);
+}
+
+TEST(biased_count, owner_thread_exits)
+{
+    shared_ptr<Biased> xPtr;
+    std::thread thread([&xPtr]()
+    {
+        shared_ptr<Biased> ownerPtr(new Biased);
+        xPtr = ownerPtr;
+    });
+    thread.join();
+    EXPECT_EQ(1, xPtr.use_count());
+    EXPECT_EQ(1, Biased::_mNbInstances);
+    // the owner thread has exited: the last release merges the counter directly
+    xPtr.reset();
+    EXPECT_EQ(0, Biased::_mNbInstances);
+}
+
+TEST(biased_count, concurrent_hand_offs)
+{
+    static const int NB_THREADS = 8;
+    static const int NB_ITERATIONS = 1000;
+    {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < NB_THREADS; ++i)
+        {
+            threads.push_back(std::thread([]()
+            {
+                for (int j = 0; j < NB_ITERATIONS; ++j)
+                {
+                    // each thread owns its objects, and hands them to a consumer thread
+                    shared_ptr<Biased> xPtr(new Biased);
+                    weak_ptr<Biased> wPtr(xPtr);
+                    std::thread consumer([](shared_ptr<Biased> aPtr, weak_ptr<Biased> aWeakPtr)
+                    {
+                        shared_ptr<Biased> lockedPtr = aWeakPtr.lock();
+                        EXPECT_EQ(aPtr, lockedPtr);
+                    }, xPtr, wPtr);
+                    xPtr.reset();
+                    consumer.join();
+                }
+            }));
+        }
+        for (size_t i = 0; i < threads.size(); ++i)
+        {
+            threads[i].join();
+        }
+    }
+    EXPECT_EQ(0, Biased::_mNbInstances);
+}
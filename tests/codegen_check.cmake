@@ -0,0 +1,113 @@
+# Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+#
+# Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+# or copy at http://opensource.org/licenses/MIT)
+#
+# Codegen regression check of the hot paths, run by ctest as a CMake script:
+#   cmake -DCXX=<compiler> -DFLAGS=<flags> -DSOURCE=codegen_hot_paths.cpp -DOUTPUT=<file.s> [-DTOLERANCE=<n>] -P codegen_check.cmake
+#
+# Compiles SOURCE to assembly at -O2, counts the instructions and the calls (including tail calls) of the main body
+# of each <operation>_minimal function and of its <operation>_std equivalent, and fails if this implementation
+# does more calls, or more than TOLERANCE additional instructions (0 by default).
+# Each <operation>_minimal function of the NO_TRAFFIC operations, without std equivalent, fails instead
+# if it writes to memory (other than the stack) before its first return, ie. if it touches a reference counter.
+
+set(OPERATIONS copy destroy arrow move unique_move unique_arrow)
+set(NO_TRAFFIC copy_destroy)
+if (NOT DEFINED TOLERANCE)
+    set(TOLERANCE 0)
+endif (NOT DEFINED TOLERANCE)
+
+execute_process(
+    COMMAND ${CXX} ${FLAGS} -O2 -DNDEBUG -S -o ${OUTPUT} ${SOURCE}
+    RESULT_VARIABLE COMPILE_RESULT
+    ERROR_VARIABLE COMPILE_ERROR
+)
+if (NOT COMPILE_RESULT EQUAL 0)
+    message(FATAL_ERROR "failed to compile ${SOURCE} to assembly:\n${COMPILE_ERROR}")
+endif (NOT COMPILE_RESULT EQUAL 0)
+
+# the functions to measure, and their counters
+set(FUNCTIONS)
+foreach (OPERATION ${OPERATIONS})
+    list(APPEND FUNCTIONS ${OPERATION}_minimal ${OPERATION}_std)
+endforeach (OPERATION)
+foreach (OPERATION ${NO_TRAFFIC})
+    list(APPEND FUNCTIONS ${OPERATION}_minimal)
+endforeach (OPERATION)
+foreach (FUNCTION ${FUNCTIONS})
+    set(${FUNCTION}_INSTRUCTIONS 0)
+    set(${FUNCTION}_CALLS 0)
+    set(${FUNCTION}_WRITES 0)
+    set(${FUNCTION}_RETURNED FALSE)
+    set(${FUNCTION}_FOUND FALSE)
+endforeach (FUNCTION)
+
+# parse the assembly: a function starts at its label (with a leading underscore on Mach-O),
+# and its main body ends at its .size or .cfi_endproc directive (the cold parts moved elsewhere are not counted)
+file(STRINGS ${OUTPUT} LINES)
+set(CURRENT "")
+foreach (LINE ${LINES})
+    if (LINE MATCHES "^_?([A-Za-z_][A-Za-z0-9_]*):")
+        set(LABEL ${CMAKE_MATCH_1})
+        list(FIND FUNCTIONS ${LABEL} INDEX)
+        if (NOT INDEX EQUAL -1)
+            set(CURRENT ${LABEL})
+            set(${CURRENT}_FOUND TRUE)
+        endif (NOT INDEX EQUAL -1)
+    elseif (CURRENT)
+        if (LINE MATCHES "^[ \t]+\\.(size|cfi_endproc)")
+            set(CURRENT "")
+        elseif (LINE MATCHES "^[ \t]+[a-z]")
+            math(EXPR ${CURRENT}_INSTRUCTIONS "${${CURRENT}_INSTRUCTIONS} + 1")
+            # calls, and jumps/branches out of the function (tail calls), but not to its local labels
+            if (LINE MATCHES "^[ \t]+(call[a-z]*|bl|blr|jmp|b)[ \t]+[^. \t]")
+                math(EXPR ${CURRENT}_CALLS "${${CURRENT}_CALLS} + 1")
+            endif ()
+            # writes to memory before the first return: x86 instructions with a memory destination
+            # (AT&T syntax, other than a comparison), and AArch64 stores and atomics, except to the stack
+            if (LINE MATCHES "^[ \t]+ret")
+                set(${CURRENT}_RETURNED TRUE)
+            elseif (NOT ${CURRENT}_RETURNED AND NOT LINE MATCHES "[%\[](rsp|esp|sp)[],)]")
+                if ((LINE MATCHES "^[ \t]+(lock|xadd|xchg|cmpxchg)") OR
+                    (LINE MATCHES "^[ \t]+(mov|add|sub|inc|dec|and|or|xor|neg|not)[a-z]*[ \t]+([^,]*,[ \t]*)?[^,%$]*\\([^,]*$") OR
+                    (LINE MATCHES "^[ \t]+(st[a-z0-9]*|ldadd[a-z]*|swp[a-z]*|cas[a-z]*)[ \t]"))
+                    math(EXPR ${CURRENT}_WRITES "${${CURRENT}_WRITES} + 1")
+                endif ()
+            endif ()
+        endif ()
+    endif ()
+endforeach (LINE)
+
+# report and compare each operation with its std equivalent
+set(FAILURES "")
+message(STATUS "operation        minimal (instructions/calls)    std (instructions/calls)")
+foreach (OPERATION ${OPERATIONS})
+    set(MINIMAL ${OPERATION}_minimal)
+    set(STD ${OPERATION}_std)
+    if (NOT ${MINIMAL}_FOUND OR NOT ${STD}_FOUND)
+        message(FATAL_ERROR "functions ${MINIMAL} and ${STD} not found in ${OUTPUT}")
+    endif ()
+    message(STATUS "${OPERATION}:\t\t${${MINIMAL}_INSTRUCTIONS}/${${MINIMAL}_CALLS}\t\t\t\t${${STD}_INSTRUCTIONS}/${${STD}_CALLS}")
+    math(EXPR BUDGET "${${STD}_INSTRUCTIONS} + ${TOLERANCE}")
+    if (${MINIMAL}_INSTRUCTIONS GREATER BUDGET)
+        set(FAILURES "${FAILURES}\n  ${OPERATION}: ${${MINIMAL}_INSTRUCTIONS} instructions instead of at most ${BUDGET}")
+    endif ()
+    if (${MINIMAL}_CALLS GREATER ${STD}_CALLS)
+        set(FAILURES "${FAILURES}\n  ${OPERATION}: ${${MINIMAL}_CALLS} calls instead of at most ${${STD}_CALLS}")
+    endif ()
+endforeach (OPERATION)
+foreach (OPERATION ${NO_TRAFFIC})
+    set(MINIMAL ${OPERATION}_minimal)
+    if (NOT ${MINIMAL}_FOUND)
+        message(FATAL_ERROR "function ${MINIMAL} not found in ${OUTPUT}")
+    endif ()
+    message(STATUS "${OPERATION}:\t${${MINIMAL}_INSTRUCTIONS}/${${MINIMAL}_CALLS}, ${${MINIMAL}_WRITES} writes before returning")
+    if (${MINIMAL}_WRITES GREATER 0)
+        set(FAILURES "${FAILURES}\n  ${OPERATION}: ${${MINIMAL}_WRITES} writes to memory instead of none")
+    endif ()
+endforeach (OPERATION)
+
+if (FAILURES)
+    message(FATAL_ERROR "the hot paths do more than their std equivalents (see ${OUTPUT}):${FAILURES}")
+endif (FAILURES)
@@ -0,0 +1,59 @@
+/**
+ * @file  codegen_check.cpp
+ * @brief Compile-time check of the hot paths of the smart pointers: constant initialization, noexcept and sizes.
+ *
+ * This translation unit is only compiled (with C++20 constinit), never run: a regression is a build failure.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include "shared_ptr.hpp"
+#include "compact_shared_ptr.hpp"
+#include "unique_ptr.hpp"
+
+#include <type_traits>
+
+struct Xxx
+{
+    int mVal;
+};
+
+// static smart pointers are initialized at compile time: no dynamic initializer runs at startup
+constinit shared_ptr<Xxx>           gSharedPtr;
+constinit shared_ptr<Xxx>           gNullSharedPtr(nullptr);
+constinit weak_ptr<Xxx>             gWeakPtr;
+constinit compact_shared_ptr<Xxx>   gCompactPtr;
+constinit shared_ptr<Xxx, immortal> gImmortalPtr;
+constinit unique_ptr<Xxx>           gUniquePtr;
+constinit unique_ptr<Xxx[]>         gUniqueArray(nullptr);
+
+// the non-throwing operations are noexcept, so that the compiler needs no unwinding code around them
+static_assert(noexcept(shared_ptr<Xxx>(gSharedPtr)),                    "shared_ptr copy");
+static_assert(std::is_nothrow_move_constructible<shared_ptr<Xxx> >::value, "shared_ptr move");
+static_assert(std::is_nothrow_destructible<shared_ptr<Xxx> >::value,    "shared_ptr destructor");
+static_assert(noexcept(gSharedPtr = gNullSharedPtr),                    "shared_ptr assignment");
+static_assert(noexcept(gSharedPtr.reset()),                             "shared_ptr reset");
+static_assert(noexcept(static_cast<bool>(gSharedPtr)),                  "shared_ptr operator bool");
+static_assert(noexcept(gSharedPtr.get()),                               "shared_ptr get");
+static_assert(noexcept(*gSharedPtr),                                    "shared_ptr operator*");
+static_assert(noexcept(gSharedPtr == nullptr),                          "shared_ptr comparison");
+static_assert(noexcept(gWeakPtr.lock()),                                "weak_ptr lock");
+static_assert(std::is_nothrow_move_constructible<unique_ptr<Xxx> >::value, "unique_ptr move");
+static_assert(noexcept(gUniquePtr.reset()),                             "unique_ptr reset");
+static_assert(noexcept(gUniquePtr = nullptr),                           "unique_ptr nullptr assignment");
+
+// no space overhead
+static_assert(sizeof(shared_ptr<Xxx>)           == 2 * sizeof(Xxx*),    "shared_ptr is two pointers");
+static_assert(sizeof(shared_ptr<Xxx, single_threaded>) == sizeof(shared_ptr<Xxx, multi_threaded>), "the policy takes no space");
+static_assert(sizeof(shared_ptr<Xxx, immortal>) == 2 * sizeof(Xxx*),    "immortal shared_ptr is two pointers");
+static_assert(sizeof(compact_shared_ptr<Xxx>)   == sizeof(Xxx*),        "compact_shared_ptr is one pointer");
+static_assert(sizeof(unique_ptr<Xxx>)           == sizeof(Xxx*),        "unique_ptr is one pointer");
+
+// operator bool only tests the stored pointer: a single comparison, without loading the reference counter
+bool is_set(const shared_ptr<Xxx>& aPtr) noexcept
+{
+    return static_cast<bool>(aPtr);
+}
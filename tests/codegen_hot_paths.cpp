@@ -0,0 +1,96 @@
+/**
+ * @file  codegen_hot_paths.cpp
+ * @brief Hot paths of the smart pointers and of their std equivalents, compiled to assembly by codegen_check.cmake.
+ *
+ * Each hot path is an extern "C" function named <operation>_minimal, with its std equivalent named <operation>_std:
+ * the check counts the instructions and the calls of each pair, and fails if this implementation does more.
+ * A <operation>_minimal function without std equivalent must not write to memory (other than the stack) before it returns.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include "shared_ptr.hpp"
+#include "unique_ptr.hpp"
+
+#include <memory>
+#include <new>
+
+struct Xxx
+{
+    int mVal;
+};
+
+extern "C"
+{
+
+// copy construction: a single increment of the reference counter
+void copy_minimal(void* aDst, const ::shared_ptr<Xxx>& aPtr) noexcept
+{
+    ::new(aDst) ::shared_ptr<Xxx>(aPtr);
+}
+void copy_std(void* aDst, const std::shared_ptr<Xxx>& aPtr) noexcept
+{
+    ::new(aDst) std::shared_ptr<Xxx>(aPtr);
+}
+
+// destruction: a single decrement of the reference counter, and the release of the object with the last reference
+void destroy_minimal(::shared_ptr<Xxx>& aPtr) noexcept
+{
+    aPtr.~shared_ptr();
+}
+void destroy_std(std::shared_ptr<Xxx>& aPtr) noexcept
+{
+    aPtr.~shared_ptr();
+}
+
+// dereference: a single load of the stored pointer, without touching the control block
+int arrow_minimal(const ::shared_ptr<Xxx>& aPtr) noexcept
+{
+    return aPtr->mVal;
+}
+int arrow_std(const std::shared_ptr<Xxx>& aPtr) noexcept
+{
+    return aPtr->mVal;
+}
+
+// move construction: no reference counting at all
+void move_minimal(void* aDst, ::shared_ptr<Xxx>& aPtr) noexcept
+{
+    ::new(aDst) ::shared_ptr<Xxx>(std::move(aPtr));
+}
+void move_std(void* aDst, std::shared_ptr<Xxx>& aPtr) noexcept
+{
+    ::new(aDst) std::shared_ptr<Xxx>(std::move(aPtr));
+}
+
+// unique_ptr move assignment: the release of the previous object, and the transfer of the pointer
+void unique_move_minimal(::unique_ptr<Xxx>& aDst, ::unique_ptr<Xxx>& aPtr) noexcept
+{
+    aDst = std::move(aPtr);
+}
+void unique_move_std(std::unique_ptr<Xxx>& aDst, std::unique_ptr<Xxx>& aPtr) noexcept
+{
+    aDst = std::move(aPtr);
+}
+
+// unique_ptr dereference
+int unique_arrow_minimal(const ::unique_ptr<Xxx>& aPtr) noexcept
+{
+    return aPtr->mVal;
+}
+int unique_arrow_std(const std::unique_ptr<Xxx>& aPtr) noexcept
+{
+    return aPtr->mVal;
+}
+
+// copy then destruction of a single_threaded shared_ptr: no counter traffic, the increment and the decrement cancel out
+int copy_destroy_minimal(const ::shared_ptr<Xxx, single_threaded>& aPtr) noexcept
+{
+    const ::shared_ptr<Xxx, single_threaded> copy(aPtr);
+    return copy->mVal;
+}
+
+} // extern "C"
@@ -0,0 +1,95 @@
+/**
+ * @file  codegen_sizes.cpp
+ * @brief Report of the size of every smart pointer, policy and control block variant, run by ctest.
+ *
+ * Built with SHARED_PTR_THREAD_SAFE to report the atomic_shared_ptr too; it fails only if a size exceeds
+ * its budget in pointers, so that an addition to a pointer or to a control block does not go unnoticed.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include "shared_ptr.hpp"
+#include "compact_shared_ptr.hpp"
+#include "local_shared_ptr.hpp"
+#include "shared_slice.hpp"
+#include "intrusive_ptr.hpp"
+#include "unique_ptr.hpp"
+#ifdef SHARED_PTR_THREAD_SAFE
+#include "atomic_shared_ptr.hpp"
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+struct Xxx : public ref_counted<Xxx>
+{
+    int mVal;
+};
+
+// stateless deleter
+struct Deleter
+{
+    void operator()(Xxx* p) const
+    {
+        delete p;
+    }
+};
+
+static int gNbFailures = 0;
+
+/// @brief report the size of a type, failing if it takes more than aBudget pointers
+static void report(const char* aName, std::size_t aSize, std::size_t aBudget)
+{
+    const bool bOverBudget = (aBudget * sizeof(void*) < aSize);
+    std::printf("%-48s %3u bytes (budget of %u pointers)%s\n", aName, static_cast<unsigned>(aSize), static_cast<unsigned>(aBudget),
+                bOverBudget ? " OVER BUDGET" : "");
+    if (bOverBudget)
+    {
+        ++gNbFailures;
+    }
+}
+
+#define REPORT(Budget, ...)    report(#__VA_ARGS__, sizeof(__VA_ARGS__), Budget)
+
+int main(void)
+{
+    std::printf("smart pointers:\n");
+    REPORT(2, shared_ptr<Xxx>);
+    REPORT(2, shared_ptr<Xxx, single_threaded>);
+    REPORT(2, shared_ptr<Xxx, multi_threaded>);
+    REPORT(2, shared_ptr<Xxx, immortal>);
+    REPORT(2, shared_ptr<Xxx[]>);
+    REPORT(2, weak_ptr<Xxx>);
+    REPORT(1, compact_shared_ptr<Xxx>);
+    REPORT(2, local_shared_ptr<Xxx>);
+    REPORT(3, shared_slice<Xxx>);
+    REPORT(1, intrusive_ptr<Xxx>);
+    REPORT(1, unique_ptr<Xxx>);
+    REPORT(1, unique_ptr<Xxx[]>);
+    REPORT(1, unique_ptr<Xxx, Deleter>);
+    REPORT(2, unique_ptr<Xxx, void(*)(Xxx*)>);
+#ifdef SHARED_PTR_THREAD_SAFE
+    REPORT(1, atomic_shared_ptr<Xxx>);
+#endif
+    REPORT(2, std::shared_ptr<Xxx>);
+    REPORT(1, std::unique_ptr<Xxx>);
+
+    // the control blocks: a vtable pointer and two counters, followed by the pointer, the deleter or the object
+    std::printf("control blocks:\n");
+    REPORT(4, count_impl<Xxx>);
+    REPORT(4, count_impl_pd<Xxx*, Deleter>);
+    REPORT(5, count_impl_pd<Xxx*, void(*)(Xxx*)>);
+    REPORT(3 + sizeof(Xxx) / sizeof(void*), count_inplace<Xxx, std::allocator<Xxx> >);
+    REPORT(3 * SHARED_PTR_CACHE_LINE_SIZE / sizeof(void*), count_inplace<Xxx, std::allocator<Xxx>, padded_layout>);
+#ifdef SHARED_PTR_LOCAL_OWNER_CHECK
+    REPORT(5, count_local);
+#else
+    REPORT(4, count_local);
+#endif
+
+    return (0 == gNbFailures) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,175 @@
+/**
+ * @file  compact_shared_ptr_test.cpp
+ * @brief Complete Unit Test of this compact_shared_ptr minimal implementation using Google Test library.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include "compact_shared_ptr.hpp"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+struct Compact
+{
+    explicit Compact(int aVal = 0) :
+        mVal(aVal)
+    {
+        ++_mNbInstances;
+    }
+    Compact(int aVal1, int aVal2) :
+        mVal(aVal1 + aVal2)
+    {
+        ++_mNbInstances;
+    }
+    ~Compact(void)
+    {
+        --_mNbInstances;
+    }
+
+    int         mVal;
+    static int _mNbInstances;
+};
+
+int Compact::_mNbInstances = 0;
+
+
+TEST(compact_shared_ptr, size)
+{
+    // The compact handle is a single word, half the size of a shared_ptr
+    EXPECT_EQ(sizeof(void*), sizeof(compact_shared_ptr<Compact>));
+    EXPECT_EQ(2 * sizeof(compact_shared_ptr<Compact>), sizeof(shared_ptr<Compact>));
+}
+
+TEST(compact_shared_ptr, empty_ptr)
+{
+    // Create an empty (ie. NULL) compact_shared_ptr
+    compact_shared_ptr<Compact> xPtr;
+
+    EXPECT_EQ(false, xPtr);
+    EXPECT_EQ(false, xPtr.unique());
+    EXPECT_EQ(0, xPtr.use_count());
+    EXPECT_EQ((void*)NULL, xPtr.get());
+
+    // Reset to NULL (ie. do nothing)
+    xPtr.reset();
+    EXPECT_EQ(false, xPtr);
+
+    // Copy construct and assign the empty (ie. NULL) compact_shared_ptr
+    compact_shared_ptr<Compact> yPtr(xPtr);
+    EXPECT_EQ(false, yPtr);
+    EXPECT_EQ(0, yPtr.use_count());
+    yPtr = xPtr;
+    EXPECT_EQ(false, yPtr);
+
+    // Convert to an empty shared_ptr
+    shared_ptr<Compact> sPtr = xPtr;
+    EXPECT_EQ(false, sPtr);
+    EXPECT_EQ(0, sPtr.use_count());
+}
+
+TEST(compact_shared_ptr, basic_ptr)
+{
+    {
+        // Create a compact_shared_ptr
+        compact_shared_ptr<Compact> xPtr = make_compact_shared<Compact>(123);
+
+        EXPECT_EQ(true, xPtr);
+        EXPECT_EQ(true, xPtr.unique());
+        EXPECT_EQ(1, xPtr.use_count());
+        EXPECT_NE((void*)NULL, xPtr.get());
+        EXPECT_EQ(123, xPtr->mVal);
+        EXPECT_EQ(123, (*xPtr).mVal);
+        EXPECT_EQ(1, Compact::_mNbInstances);
+
+        // Copy construct the compact_shared_ptr
+        compact_shared_ptr<Compact> yPtr(xPtr);
+
+        EXPECT_EQ(xPtr, yPtr);
+        EXPECT_EQ(false, xPtr.unique());
+        EXPECT_EQ(2, xPtr.use_count());
+        EXPECT_EQ(2, yPtr.use_count());
+        EXPECT_EQ(123, yPtr->mVal);
+
+        // Assign to another compact_shared_ptr
+        compact_shared_ptr<Compact> zPtr = make_compact_shared<Compact>(1, 2);
+        EXPECT_EQ(2, Compact::_mNbInstances);
+        EXPECT_EQ(3, zPtr->mVal);
+        EXPECT_NE(xPtr, zPtr);
+        zPtr = xPtr;
+        EXPECT_EQ(1, Compact::_mNbInstances);
+        EXPECT_EQ(xPtr, zPtr);
+        EXPECT_EQ(3, xPtr.use_count());
+
+        // Reset one of them
+        yPtr.reset();
+        EXPECT_EQ(false, yPtr);
+        EXPECT_EQ(2, xPtr.use_count());
+
+        // Swap with an empty one
+        yPtr.swap(zPtr);
+        EXPECT_EQ(false, zPtr);
+        EXPECT_EQ(xPtr, yPtr);
+        EXPECT_EQ(2, xPtr.use_count());
+    }
+    EXPECT_EQ(0, Compact::_mNbInstances);
+}
+
+TEST(compact_shared_ptr, shared_ptr)
+{
+    {
+        compact_shared_ptr<Compact> xPtr = make_compact_shared<Compact>(123);
+        {
+            // Convert to a shared_ptr sharing the same control block
+            shared_ptr<Compact> sPtr = xPtr;
+            EXPECT_EQ(true, sPtr);
+            EXPECT_EQ(xPtr.get(), sPtr.get());
+            EXPECT_EQ(2, xPtr.use_count());
+            EXPECT_EQ(2, sPtr.use_count());
+
+            // The shared_ptr keeps the object alive after the compact_shared_ptr
+            xPtr.reset();
+            EXPECT_EQ(1, sPtr.use_count());
+            EXPECT_EQ(1, Compact::_mNbInstances);
+            EXPECT_EQ(123, sPtr->mVal);
+
+            // A weak_ptr can observe it through the shared_ptr
+            weak_ptr<Compact> wPtr(sPtr);
+            EXPECT_EQ(1, wPtr.use_count());
+            sPtr.reset();
+            EXPECT_EQ(true, wPtr.expired());
+            EXPECT_EQ(0, Compact::_mNbInstances);
+        }
+    }
+    EXPECT_EQ(0, Compact::_mNbInstances);
+}
+
+TEST(compact_shared_ptr, std_container)
+{
+    {
+        // Create a vector of compact_shared_ptr
+        std::vector<compact_shared_ptr<Compact> > ptrs;
+        for (int i = 0; i < 10; ++i)
+        {
+            ptrs.push_back(make_compact_shared<Compact>(i));
+        }
+        EXPECT_EQ(10, Compact::_mNbInstances);
+        for (int i = 0; i < 10; ++i)
+        {
+            EXPECT_EQ(i, ptrs[static_cast<std::size_t>(i)]->mVal);
+            EXPECT_EQ(1, ptrs[static_cast<std::size_t>(i)].use_count());
+        }
+
+        // Copy the vector
+        std::vector<compact_shared_ptr<Compact> > copy(ptrs);
+        EXPECT_EQ(10, Compact::_mNbInstances);
+        EXPECT_EQ(2, copy.front().use_count());
+        ptrs.clear();
+        EXPECT_EQ(1, copy.front().use_count());
+    }
+    EXPECT_EQ(0, Compact::_mNbInstances);
+}
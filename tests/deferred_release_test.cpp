@@ -0,0 +1,137 @@
+/**
+ * @file  deferred_release_test.cpp
+ * @brief Unit Test of the deferred release of shared_ptr (SHARED_PTR_DEFERRED_RELEASE) using Google Test library.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#ifndef SHARED_PTR_DEFERRED_RELEASE
+#error "this test must be compiled with SHARED_PTR_DEFERRED_RELEASE defined"
+#endif
+
+#include "shared_ptr.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+struct Deferred
+{
+    Deferred(void)
+    {
+        ++_mNbInstances;
+    }
+    ~Deferred(void)
+    {
+        --_mNbInstances;
+    }
+
+    static std::atomic<int> _mNbInstances;
+};
+
+std::atomic<int> Deferred::_mNbInstances(0);
+
+
+TEST(deferred_release, disabled)
+{
+    // Without a scope, the last release destroys the object inline
+    shared_ptr<Deferred> xPtr(new Deferred);
+    EXPECT_EQ(1, Deferred::_mNbInstances);
+    xPtr.reset();
+    EXPECT_EQ(0, Deferred::_mNbInstances);
+    EXPECT_EQ(0u, deferred_release::drain());
+}
+
+TEST(deferred_release, scope)
+{
+    weak_ptr<Deferred> wPtr;
+    {
+        deferred_release::scope deferred;
+        {
+            deferred_release::scope nested;
+
+            shared_ptr<Deferred> xPtr(new Deferred);
+            shared_ptr<Deferred> yPtr = make_shared<Deferred>();
+            wPtr = xPtr;
+            EXPECT_EQ(2, Deferred::_mNbInstances);
+
+            // A copy released is not the last one
+            shared_ptr<Deferred> copyPtr(xPtr);
+            copyPtr.reset();
+            EXPECT_EQ(2, Deferred::_mNbInstances);
+
+            // The last releases are deferred, but the objects are expired
+            xPtr.reset();
+            yPtr.reset();
+            EXPECT_EQ(2, Deferred::_mNbInstances);
+            EXPECT_EQ(true, wPtr.expired());
+            EXPECT_EQ(false, wPtr.lock());
+        }
+        // Still pending until the outermost scope ends
+        EXPECT_EQ(0u, deferred_release::drain());
+        EXPECT_EQ(2, Deferred::_mNbInstances);
+    }
+    EXPECT_EQ(2, Deferred::_mNbInstances);
+    EXPECT_EQ(2u, deferred_release::drain());
+    EXPECT_EQ(0, Deferred::_mNbInstances);
+    EXPECT_EQ(true, wPtr.expired());
+    EXPECT_EQ(0u, deferred_release::drain());
+}
+
+TEST(deferred_release, batches)
+{
+    {
+        deferred_release::scope deferred;
+        for (int i = 0; i < 3 * SHARED_PTR_DEFERRED_BATCH; ++i)
+        {
+            shared_ptr<Deferred> xPtr(new Deferred);
+        }
+        EXPECT_EQ(3 * SHARED_PTR_DEFERRED_BATCH, Deferred::_mNbInstances);
+        // The full batches are handed to drain() without waiting for the end of the scope
+        EXPECT_EQ(static_cast<std::size_t>(3 * SHARED_PTR_DEFERRED_BATCH), deferred_release::drain());
+        EXPECT_EQ(0, Deferred::_mNbInstances);
+    }
+}
+
+struct Graph
+{
+    explicit Graph(int aDepth) :
+        mLeft(aDepth > 0 ? new Graph(aDepth - 1) : NULL),
+        mRight(aDepth > 0 ? new Graph(aDepth - 1) : NULL)
+    {
+    }
+    shared_ptr<Graph>   mLeft;
+    shared_ptr<Graph>   mRight;
+    Deferred            mCounted;
+};
+
+TEST(deferred_release, background_thread)
+{
+    {
+        deferred_release::thread background(std::chrono::milliseconds(1));
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i)
+        {
+            threads.push_back(std::thread([]()
+            {
+                deferred_release::scope deferred;
+                for (int j = 0; j < 100; ++j)
+                {
+                    // the nodes of the graph are released by the background thread
+                    shared_ptr<Graph> graph(new Graph(4));
+                }
+            }));
+        }
+        for (size_t i = 0; i < threads.size(); ++i)
+        {
+            threads[i].join();
+        }
+    }
+    // the background thread drains one last time when stopped
+    EXPECT_EQ(0, Deferred::_mNbInstances);
+}
@@ -0,0 +1,200 @@
+/**
+ * @file  intrusive_ptr_test.cpp
+ * @brief Complete Unit Test of this intrusive_ptr minimal implementation using Google Test library.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include "intrusive_ptr.hpp"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+struct Intrusive : public ref_counted<Intrusive>
+{
+    explicit Intrusive(int aVal) :
+        mVal(aVal)
+    {
+        ++_mNbInstances;
+    }
+    ~Intrusive(void)
+    {
+        --_mNbInstances;
+    }
+
+    int         mVal;
+    static int _mNbInstances;
+};
+
+int Intrusive::_mNbInstances = 0;
+
+class IntrusiveBase : public ref_counted<IntrusiveBase>
+{
+public:
+    virtual ~IntrusiveBase(void)
+    {
+    }
+};
+
+class IntrusiveDerived : public IntrusiveBase
+{
+};
+
+
+TEST(intrusive_ptr, empty_ptr)
+{
+    // Create an empty (ie. NULL) intrusive_ptr
+    intrusive_ptr<Intrusive> xPtr;
+
+    EXPECT_EQ(false, xPtr);
+    EXPECT_EQ((void*)NULL, xPtr.get());
+
+    // Reset to NULL (ie. do nothing)
+    xPtr.reset();
+    EXPECT_EQ(false, xPtr);
+
+    // Copy construct and assign the empty (ie. NULL) intrusive_ptr
+    intrusive_ptr<Intrusive> yPtr(xPtr);
+    intrusive_ptr<Intrusive> zPtr;
+    zPtr = xPtr;
+    EXPECT_EQ(false, yPtr);
+    EXPECT_EQ(false, zPtr);
+}
+
+TEST(intrusive_ptr, basic_ptr)
+{
+    // same size as a raw pointer
+    EXPECT_EQ(sizeof(Intrusive*), sizeof(intrusive_ptr<Intrusive>));
+
+    {
+        // Create an intrusive_ptr
+        intrusive_ptr<Intrusive> xPtr(new Intrusive(123));
+
+        EXPECT_EQ(true, xPtr);
+        EXPECT_EQ(1,    xPtr->use_count());
+        EXPECT_EQ(123,  xPtr->mVal);
+        EXPECT_EQ(1,    Intrusive::_mNbInstances);
+
+        // Copy construct the intrusive_ptr
+        intrusive_ptr<Intrusive> yPtr(xPtr);
+        EXPECT_EQ(xPtr, yPtr);
+        EXPECT_EQ(2,    xPtr->use_count());
+
+        {
+            // Assign the intrusive_ptr
+            intrusive_ptr<Intrusive> zPtr;
+            zPtr = yPtr;
+            EXPECT_EQ(xPtr, zPtr);
+            EXPECT_EQ(3,    (*zPtr).use_count());
+        }
+        EXPECT_EQ(2,    xPtr->use_count());
+
+        // A new intrusive_ptr from the raw pointer shares the same counter
+        intrusive_ptr<Intrusive> rawPtr(xPtr.get());
+        EXPECT_EQ(3,    xPtr->use_count());
+        EXPECT_EQ(1,    Intrusive::_mNbInstances);
+
+        // Reset the copies
+        yPtr.reset();
+        rawPtr.reset();
+        EXPECT_EQ(1,    xPtr->use_count());
+        EXPECT_EQ(1,    Intrusive::_mNbInstances);
+    }
+    EXPECT_EQ(0, Intrusive::_mNbInstances);
+}
+
+TEST(intrusive_ptr, reset_detach)
+{
+    intrusive_ptr<Intrusive> xPtr;
+
+    // Reset it with a new pointer
+    xPtr.reset(new Intrusive(123));
+    EXPECT_EQ(1,    xPtr->use_count());
+
+    // Reset it with another new pointer
+    xPtr.reset(new Intrusive(234));
+    EXPECT_EQ(1,    Intrusive::_mNbInstances);
+    EXPECT_EQ(234,  xPtr->mVal);
+
+    // Detach the raw pointer, keeping its reference
+    Intrusive* pX = xPtr.detach();
+    EXPECT_EQ(false, xPtr);
+    EXPECT_EQ(1,     pX->use_count());
+
+    // Adopt it back without adding a reference
+    xPtr.reset(pX, false);
+    EXPECT_EQ(1,    xPtr->use_count());
+
+    xPtr.reset();
+    EXPECT_EQ(0,    Intrusive::_mNbInstances);
+}
+
+TEST(intrusive_ptr, compare_ptr)
+{
+    intrusive_ptr<Intrusive> xPtr(new Intrusive(123));
+    intrusive_ptr<Intrusive> yPtr(new Intrusive(234));
+
+    EXPECT_NE(xPtr, yPtr);
+    if (xPtr.get() < yPtr.get())
+    {
+        EXPECT_LT(xPtr, yPtr);
+        EXPECT_LE(xPtr, yPtr);
+        EXPECT_GT(yPtr, xPtr);
+        EXPECT_GE(yPtr, xPtr);
+    }
+    else // (pX > pY)
+    {
+        EXPECT_GT(xPtr, yPtr);
+        EXPECT_GE(xPtr, yPtr);
+        EXPECT_LT(yPtr, xPtr);
+        EXPECT_LE(yPtr, xPtr);
+    }
+
+    intrusive_ptr<Intrusive> zPtr = xPtr;
+    EXPECT_EQ(xPtr, zPtr);
+    EXPECT_GE(xPtr, zPtr);
+    EXPECT_LE(xPtr, zPtr);
+}
+
+TEST(intrusive_ptr, std_container)
+{
+    intrusive_ptr<Intrusive> xPtr(new Intrusive(123));
+    {
+        std::vector<intrusive_ptr<Intrusive> > PtrList;
+
+        // Copy-it inside a container
+        for (int i = 0; i < 100; ++i)
+        {
+            PtrList.push_back(xPtr);
+        }
+        EXPECT_EQ(101, xPtr->use_count());
+    }
+    EXPECT_EQ(1, xPtr->use_count());
+}
+
+TEST(intrusive_ptr, pointer_cast)
+{
+    intrusive_ptr<IntrusiveBase> basePtr(new IntrusiveDerived);
+
+    // dynamic cast
+    intrusive_ptr<IntrusiveDerived> derivedPtr = dynamic_pointer_cast<IntrusiveDerived>(basePtr);
+    EXPECT_EQ(true, derivedPtr);
+    EXPECT_EQ(2,    basePtr->use_count());
+
+    // static cast
+    intrusive_ptr<IntrusiveBase> base2Ptr = static_pointer_cast<IntrusiveBase>(derivedPtr);
+    EXPECT_EQ(basePtr, base2Ptr);
+    EXPECT_EQ(3,    basePtr->use_count());
+
+    // copy with conversion
+    intrusive_ptr<IntrusiveBase> base3Ptr(derivedPtr);
+    EXPECT_EQ(4,    basePtr->use_count());
+
+    // failed dynamic cast
+    intrusive_ptr<IntrusiveBase> otherPtr(new IntrusiveBase);
+    EXPECT_EQ(false, dynamic_pointer_cast<IntrusiveDerived>(otherPtr));
+}
@@ -0,0 +1,257 @@
+/**
+ * @file  local_shared_ptr_test.cpp
+ * @brief Unit Test of the local_shared_ptr confined to a single thread using Google Test library.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include "local_shared_ptr.hpp"
+
+#include <vector>
+#ifdef SHARED_PTR_CPP11
+#include <thread>
+#endif
+
+#include <gtest/gtest.h>
+
+struct Local
+{
+    explicit Local(int aVal = 0) :
+        mVal(aVal)
+    {
+        ++_mNbInstances;
+    }
+    ~Local(void)
+    {
+        --_mNbInstances;
+    }
+
+    int         mVal;
+    static int _mNbInstances;
+};
+
+int Local::_mNbInstances = 0;
+
+
+TEST(local_shared_ptr, empty_ptr)
+{
+    // Create an empty (ie. NULL) local_shared_ptr
+    local_shared_ptr<Local> xPtr;
+
+    EXPECT_EQ(false, xPtr);
+    EXPECT_EQ(false, xPtr.unique());
+    EXPECT_EQ(0, xPtr.use_count());
+    EXPECT_EQ((void*)NULL, xPtr.get());
+
+    // Converting an empty shared_ptr gives an empty local_shared_ptr, and back
+    local_shared_ptr<Local> yPtr = shared_ptr<Local>();
+    EXPECT_EQ(false, yPtr);
+    EXPECT_EQ(0, yPtr.use_count());
+    shared_ptr<Local> zPtr = yPtr;
+    EXPECT_EQ(false, zPtr);
+    EXPECT_EQ(0, zPtr.use_count());
+
+    xPtr.reset();
+    EXPECT_EQ(false, xPtr);
+}
+
+TEST(local_shared_ptr, basic_ptr)
+{
+    {
+        local_shared_ptr<Local> xPtr(new Local(123));
+        EXPECT_EQ(true, xPtr);
+        EXPECT_EQ(true, xPtr.unique());
+        EXPECT_EQ(1, xPtr.use_count());
+        EXPECT_EQ(123, xPtr->mVal);
+        EXPECT_EQ(123, (*xPtr).mVal);
+        EXPECT_EQ(1, Local::_mNbInstances);
+
+        // The local copies share the local control block
+        local_shared_ptr<Local> yPtr(xPtr);
+        EXPECT_EQ(xPtr, yPtr);
+        EXPECT_EQ(2, xPtr.use_count());
+        {
+            std::vector<local_shared_ptr<Local> > locals(8, xPtr);
+            EXPECT_EQ(10, xPtr.use_count());
+        }
+        EXPECT_EQ(2, xPtr.use_count());
+
+        local_shared_ptr<Local> zPtr;
+        zPtr = xPtr;
+        EXPECT_EQ(3, xPtr.use_count());
+        zPtr.reset(new Local(234));
+        EXPECT_NE(xPtr, zPtr);
+        EXPECT_EQ(2, xPtr.use_count());
+        EXPECT_EQ(1, zPtr.use_count());
+        EXPECT_EQ(2, Local::_mNbInstances);
+
+        xPtr.swap(zPtr);
+        EXPECT_EQ(234, xPtr->mVal);
+        EXPECT_EQ(123, zPtr->mVal);
+        EXPECT_EQ(zPtr, yPtr);
+    }
+    EXPECT_EQ(0, Local::_mNbInstances);
+}
+
+TEST(local_shared_ptr, from_shared_ptr)
+{
+    {
+        shared_ptr<Local> sharedPtr(new Local(123));
+        {
+            // The first conversion takes a single reference on the control block of the shared_ptr
+            local_shared_ptr<Local> xPtr(sharedPtr);
+            EXPECT_EQ(sharedPtr.get(), xPtr.get());
+            EXPECT_EQ(2, sharedPtr.use_count());
+            EXPECT_EQ(1, xPtr.use_count());
+
+            // The local copies do not touch the reference counter of the shared_ptr
+            std::vector<local_shared_ptr<Local> > locals(8, xPtr);
+            EXPECT_EQ(2, sharedPtr.use_count());
+            EXPECT_EQ(9, xPtr.use_count());
+
+            // Each conversion creates its own local control block
+            local_shared_ptr<Local> yPtr = sharedPtr;
+            EXPECT_EQ(xPtr, yPtr);
+            EXPECT_EQ(3, sharedPtr.use_count());
+            EXPECT_EQ(1, yPtr.use_count());
+        }
+        // The release of the last local copies releases the reference on the control block
+        EXPECT_EQ(true, sharedPtr.unique());
+        EXPECT_EQ(1, Local::_mNbInstances);
+
+        // The object is kept alive by the local_shared_ptr, after the release of the shared_ptr
+        local_shared_ptr<Local> xPtr(sharedPtr);
+        sharedPtr.reset();
+        EXPECT_EQ(1, Local::_mNbInstances);
+        EXPECT_EQ(123, xPtr->mVal);
+        xPtr.reset();
+        EXPECT_EQ(0, Local::_mNbInstances);
+
+        // with an explicit threading policy
+        shared_ptr<Local, single_threaded> singlePtr(new Local(234));
+        xPtr = singlePtr;
+        EXPECT_EQ(2, singlePtr.use_count());
+        EXPECT_EQ(234, xPtr->mVal);
+    }
+    EXPECT_EQ(0, Local::_mNbInstances);
+}
+
+TEST(local_shared_ptr, to_shared_ptr)
+{
+    {
+        shared_ptr<Local> sharedPtr;
+        {
+            local_shared_ptr<Local> xPtr(new Local(123));
+
+            // The conversion back to a shared_ptr shares the control block of the object
+            sharedPtr = xPtr;
+            EXPECT_EQ(xPtr.get(), sharedPtr.get());
+            EXPECT_EQ(2, sharedPtr.use_count());
+            EXPECT_EQ(1, xPtr.use_count());
+
+            // to be observed by a weak_ptr
+            weak_ptr<Local> weakPtr(sharedPtr);
+            EXPECT_EQ(false, weakPtr.expired());
+            EXPECT_EQ(123, weakPtr.lock()->mVal);
+        }
+        // which keeps the object alive after the release of the local references
+        EXPECT_EQ(true, sharedPtr.unique());
+        EXPECT_EQ(123, sharedPtr->mVal);
+        EXPECT_EQ(1, Local::_mNbInstances);
+    }
+    EXPECT_EQ(0, Local::_mNbInstances);
+}
+
+TEST(local_shared_ptr, make_local_shared)
+{
+    {
+        local_shared_ptr<Local> xPtr = make_local_shared<Local>(123);
+        EXPECT_EQ(true, xPtr.unique());
+        EXPECT_EQ(123, xPtr->mVal);
+        EXPECT_EQ(1, Local::_mNbInstances);
+
+        shared_ptr<Local> sharedPtr = xPtr;
+        EXPECT_EQ(2, sharedPtr.use_count());
+    }
+    EXPECT_EQ(0, Local::_mNbInstances);
+}
+
+#ifdef SHARED_PTR_CPP11
+
+TEST(local_shared_ptr, move)
+{
+    {
+        // Moving a shared_ptr steals its reference on the control block
+        shared_ptr<Local> sharedPtr(new Local(123));
+        Local* pLocal = sharedPtr.get();
+        local_shared_ptr<Local> xPtr(std::move(sharedPtr));
+        EXPECT_EQ(false, sharedPtr);
+        EXPECT_EQ(pLocal, xPtr.get());
+        EXPECT_EQ(true, xPtr.unique());
+
+        // Moving a local_shared_ptr steals its local reference
+        local_shared_ptr<Local> yPtr(std::move(xPtr));
+        EXPECT_EQ(false, xPtr);
+        EXPECT_EQ(true, yPtr.unique());
+        xPtr = std::move(yPtr);
+        EXPECT_EQ(false, yPtr);
+        EXPECT_EQ(true, xPtr.unique());
+        EXPECT_EQ(1, Local::_mNbInstances);
+
+        xPtr = nullptr;
+        EXPECT_EQ(0, Local::_mNbInstances);
+    }
+    EXPECT_EQ(0, Local::_mNbInstances);
+}
+
+TEST(local_shared_ptr, threads)
+{
+    {
+        local_shared_ptr<Local> xPtr = make_local_shared<Local>(123);
+        std::vector<local_shared_ptr<Local> > locals;
+        for (int i = 0; i < 1000; ++i)
+        {
+            locals.push_back(xPtr);
+        }
+
+        // The object is shared with other threads by converting it back to a shared_ptr
+        shared_ptr<Local, multi_threaded> sharedPtr(static_cast<shared_ptr<Local> >(xPtr));
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.push_back(std::thread([sharedPtr]()
+            {
+                // each thread has its own local references
+                local_shared_ptr<Local> yPtr(sharedPtr);
+                for (int i = 0; i < 1000; ++i)
+                {
+                    local_shared_ptr<Local> zPtr(yPtr);
+                    EXPECT_EQ(123, zPtr->mVal);
+                }
+            }));
+        }
+        for (size_t i = 0; i < threads.size(); ++i)
+        {
+            threads[i].join();
+        }
+        EXPECT_EQ(1001, xPtr.use_count());
+    }
+    EXPECT_EQ(0, Local::_mNbInstances);
+}
+
+#if SHARED_ASSERT_LEVEL >= 2
+TEST(local_shared_ptr, owner_thread)
+{
+    // The local references shall not be used by another thread than the one that created them
+    local_shared_ptr<Local> xPtr = make_local_shared<Local>(123);
+    EXPECT_DEATH(std::thread([&xPtr]()
+    {
+        local_shared_ptr<Local> yPtr(xPtr);
+    }).join(), "owner");
+}
+#endif
+
+#endif // SHARED_PTR_CPP11
@@ -0,0 +1,173 @@
+/**
+ * @file  object_pool_test.cpp
+ * @brief Unit Test of the object_pool of shared_ptr using Google Test library.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include "object_pool.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+struct Buffer
+{
+    explicit Buffer(int aVal = 0) :
+        mVal(aVal)
+    {
+        ++_mNbInstances;
+    }
+    ~Buffer(void)
+    {
+        --_mNbInstances;
+    }
+
+    int                     mVal;
+    char                    mData[256];
+    static std::atomic<int> _mNbInstances;
+};
+
+std::atomic<int> Buffer::_mNbInstances(0);
+
+
+TEST(object_pool, acquire)
+{
+    object_pool<Buffer> pool;
+    EXPECT_EQ(0u, pool.allocated());
+    Buffer* pX = NULL;
+    {
+        // The object and its control block are created in a node of the pool
+        shared_ptr<Buffer> xPtr = pool.acquire(123);
+        EXPECT_EQ(true, xPtr.unique());
+        EXPECT_EQ(123,  xPtr->mVal);
+        EXPECT_EQ(1,    Buffer::_mNbInstances);
+        EXPECT_EQ(1u,   pool.allocated());
+        pX = xPtr.get();
+
+        shared_ptr<Buffer> yPtr(xPtr);
+        EXPECT_EQ(2,    xPtr.use_count());
+    }
+    // The last release destroys the object, and gives its node back to the pool
+    EXPECT_EQ(0,  Buffer::_mNbInstances);
+    EXPECT_EQ(1u, pool.allocated());
+
+    shared_ptr<Buffer> xPtr = pool.acquire(234);
+    EXPECT_EQ(pX,   xPtr.get());
+    EXPECT_EQ(234,  xPtr->mVal);
+    EXPECT_EQ(1u,   pool.allocated());
+
+    // A weak_ptr keeps the node of an expired object until it is released
+    weak_ptr<Buffer> wPtr(xPtr);
+    xPtr.reset();
+    EXPECT_EQ(0,    Buffer::_mNbInstances);
+    shared_ptr<Buffer> yPtr = pool.acquire(345);
+    EXPECT_NE(pX,   yPtr.get());
+    EXPECT_EQ(2u,   pool.allocated());
+    wPtr.reset();
+    yPtr.reset();
+    EXPECT_EQ(2u,   pool.allocated());
+}
+
+TEST(object_pool, steady_state)
+{
+    object_pool<Buffer> pool;
+    pool.reserve(8);
+    EXPECT_EQ(8u, pool.allocated());
+
+    // A steady-state traffic reuses the same nodes, without any new allocation
+    for (int i = 0; i < 1000; ++i)
+    {
+        std::vector<shared_ptr<Buffer> > buffers;
+        for (int j = 0; j < 8; ++j)
+        {
+            buffers.push_back(pool.acquire(j));
+        }
+        EXPECT_EQ(8, Buffer::_mNbInstances);
+    }
+    EXPECT_EQ(0,  Buffer::_mNbInstances);
+    EXPECT_EQ(8u, pool.allocated());
+}
+
+TEST(object_pool, bounded)
+{
+    // The global free-list keeps at most 4 free nodes, beyond the cache of each thread
+    object_pool<Buffer> pool(4);
+    {
+        std::vector<shared_ptr<Buffer> > buffers;
+        for (int i = 0; i < 1000; ++i)
+        {
+            buffers.push_back(pool.acquire(i));
+        }
+        EXPECT_EQ(1000u, pool.allocated());
+    }
+    EXPECT_EQ(0, Buffer::_mNbInstances);
+    EXPECT_GE(4u + SHARED_PTR_OBJECT_POOL_CACHE_SIZE, pool.allocated());
+}
+
+TEST(object_pool, outlive_pool)
+{
+    shared_ptr<Buffer> xPtr;
+    weak_ptr<Buffer> wPtr;
+    {
+        object_pool<Buffer> pool;
+        xPtr = pool.acquire(1);
+        wPtr = pool.acquire(2);
+        shared_ptr<Buffer> yPtr = pool.acquire(3);
+    }
+    // The objects still used are released after their pool has been destroyed
+    EXPECT_EQ(1, xPtr->mVal);
+    EXPECT_EQ(true, wPtr.expired());
+    xPtr.reset();
+    wPtr.reset();
+    EXPECT_EQ(0, Buffer::_mNbInstances);
+}
+
+TEST(object_pool, threads)
+{
+    object_pool<Buffer> pool(64);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.push_back(std::thread([&pool, t]()
+        {
+            // each thread acquires and releases its own objects
+            for (int i = 0; i < 1000; ++i)
+            {
+                shared_ptr<Buffer> xPtr = pool.acquire(t);
+                EXPECT_EQ(t, xPtr->mVal);
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i].join();
+    }
+    EXPECT_EQ(0, Buffer::_mNbInstances);
+
+    // the objects acquired by this thread are released by another one, and come back through the global free-list
+    for (int i = 0; i < 10; ++i)
+    {
+        std::vector<shared_ptr<Buffer> > buffers;
+        for (int j = 0; j < 100; ++j)
+        {
+            buffers.push_back(pool.acquire(j));
+        }
+        std::thread consumer([&buffers]()
+        {
+            buffers.clear();
+        });
+        consumer.join();
+#ifdef SHARED_PTR_BIASED
+        // the references of the owner thread released by the other threads are merged by the owner thread
+        biased_count::merge_queued();
+#endif
+        EXPECT_EQ(0, Buffer::_mNbInstances);
+    }
+    EXPECT_GE(100u + SHARED_PTR_OBJECT_POOL_CACHE_SIZE, pool.allocated());
+}
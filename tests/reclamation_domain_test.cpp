@@ -0,0 +1,224 @@
+/**
+ * @file  reclamation_domain_test.cpp
+ * @brief Multi-threaded Unit Test of the reclamation_domain and guarded_ptr using Google Test library (SHARED_PTR_THREAD_SAFE).
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include "reclamation_domain.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+struct Node
+{
+    explicit Node(int aVal) :
+        mVal(aVal),
+        mCheck(aVal)
+    {
+        ++_mNbInstances;
+    }
+    ~Node(void)
+    {
+        mCheck = -1;
+        --_mNbInstances;
+    }
+
+    int                     mVal;
+    int                     mCheck; //!< Same as mVal as long as the object is alive
+    static std::atomic<int> _mNbInstances;
+};
+
+std::atomic<int> Node::_mNbInstances(0);
+
+// advance the epoch enough to reclaim everything that is not guarded anymore
+static void reclaim_all(void)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        reclamation_domain::reclaim();
+    }
+}
+
+
+TEST(reclamation_domain, retire)
+{
+    {
+        shared_ptr<Node> xPtr(new Node(1));
+        shared_ptr<Node> yPtr(xPtr);
+        weak_ptr<Node> wPtr(xPtr);
+
+        // The retired shared_ptr is reset, but its reference is still held by the domain
+        reclamation_domain::retire(xPtr);
+        EXPECT_EQ(false, xPtr);
+        EXPECT_EQ(2, yPtr.use_count());
+        reclaim_all();
+        EXPECT_EQ(1, yPtr.use_count());
+        EXPECT_EQ(1, Node::_mNbInstances);
+
+        // The last reference released by the domain destroys the object
+        reclamation_domain::retire(yPtr);
+        EXPECT_EQ(1, Node::_mNbInstances);
+        EXPECT_EQ(false, wPtr.expired());
+        reclaim_all();
+        EXPECT_EQ(0, Node::_mNbInstances);
+        EXPECT_EQ(true, wPtr.expired());
+
+        // An empty shared_ptr can be retired
+        shared_ptr<Node> emptyPtr;
+        reclamation_domain::retire(emptyPtr);
+        reclaim_all();
+    }
+    EXPECT_EQ(0, Node::_mNbInstances);
+}
+
+TEST(reclamation_domain, guarded_ptr)
+{
+    shared_ptr<Node> owner(new Node(2));
+    std::atomic<Node*> slot(owner.get());
+    {
+        // Loading a guarded_ptr does not touch the reference counter
+        guarded_ptr<Node> reader(slot);
+        EXPECT_EQ(true, reader);
+        EXPECT_EQ(owner.get(), reader.get());
+        EXPECT_EQ(2, reader->mVal);
+        EXPECT_EQ(1, owner.use_count());
+
+        // The object unlinked and retired is protected while guarded
+        slot.store(NULL);
+        reclamation_domain::retire(owner);
+        reclaim_all();
+        EXPECT_EQ(1, Node::_mNbInstances);
+        EXPECT_EQ(2, (*reader).mCheck);
+
+        // The copies and nested guards protect it as well
+        guarded_ptr<Node> copy(reader);
+        EXPECT_EQ(true, copy == reader);
+        reader.reset();
+        EXPECT_EQ(false, reader);
+        EXPECT_EQ(true, copy != reader);
+        {
+            reclamation_domain::guard nested;
+            copy.reset();
+            reclaim_all();
+            EXPECT_EQ(1, Node::_mNbInstances);
+        }
+        reclaim_all();
+        EXPECT_EQ(0, Node::_mNbInstances);
+
+        // Loading a NULL pointer does not pin the thread
+        guarded_ptr<Node> empty(slot);
+        EXPECT_EQ(false, empty);
+        shared_ptr<Node> other(new Node(3));
+        reclamation_domain::retire(other);
+        reclaim_all();
+        EXPECT_EQ(0, Node::_mNbInstances);
+    }
+}
+
+#ifdef SHARED_PTR_DEFERRED_RELEASE
+TEST(reclamation_domain, deferred_release)
+{
+    shared_ptr<Node> owner(new Node(4));
+    reclamation_domain::retire(owner);
+    {
+        // The last release made by reclaim() is deferred like any other
+        deferred_release::scope deferred;
+        reclaim_all();
+        EXPECT_EQ(1, Node::_mNbInstances);
+    }
+    EXPECT_EQ(1u, deferred_release::drain());
+    EXPECT_EQ(0, Node::_mNbInstances);
+}
+#endif
+
+TEST(reclamation_domain, thread_exit)
+{
+    shared_ptr<Node> owner(new Node(5));
+    std::atomic<Node*> slot(owner.get());
+    guarded_ptr<Node> reader(slot);
+
+    // The retirements still pending at the exit of a thread are handed to the other threads
+    std::thread writer([&owner, &slot]()
+    {
+        slot.store(NULL);
+        reclamation_domain::retire(owner);
+        reclamation_domain::reclaim();
+    });
+    writer.join();
+    reclaim_all();
+    EXPECT_EQ(1, Node::_mNbInstances);
+    EXPECT_EQ(5, reader->mCheck);
+
+    reader.reset();
+    reclaim_all();
+    EXPECT_EQ(0, Node::_mNbInstances);
+}
+
+TEST(reclamation_domain, threads)
+{
+    static const int NB_READERS = 4;
+    static const int NB_UPDATES = 20000;
+    {
+        shared_ptr<Node> current(new Node(0));
+        std::atomic<Node*> slot(current.get());
+        std::atomic<bool> bStop(false);
+        std::atomic<int> nbErrors(0);
+
+        // The readers never touch the reference counters, nor see a destroyed node
+        std::vector<std::thread> readers;
+        for (int r = 0; r < NB_READERS; ++r)
+        {
+            readers.push_back(std::thread([&slot, &bStop, &nbErrors]()
+            {
+                int previous = 0;
+                while (!bStop.load())
+                {
+                    guarded_ptr<Node> node(slot);
+                    if (!node || (node->mCheck != node->mVal) || (node->mVal < previous))
+                    {
+                        ++nbErrors;
+                    }
+                    else
+                    {
+                        previous = node->mVal;
+                    }
+                }
+            }));
+        }
+
+        // The writer publishes new versions, and retires the previous ones
+        std::thread writer([&current, &slot, &bStop]()
+        {
+            for (int i = 1; i <= NB_UPDATES; ++i)
+            {
+                shared_ptr<Node> next(new Node(i));
+                slot.store(next.get());
+                reclamation_domain::retire(current);
+                current = next;
+            }
+            bStop = true;
+        });
+        writer.join();
+        for (size_t i = 0; i < readers.size(); ++i)
+        {
+            readers[i].join();
+        }
+        EXPECT_EQ(0, nbErrors);
+        EXPECT_EQ(NB_UPDATES, current->mVal);
+        // reclaimed on the go, how much depending on the scheduling of the readers (a preempted reader delays the epoch)
+        EXPECT_GT(NB_UPDATES, Node::_mNbInstances.load());
+    }
+    reclaim_all();
+#ifdef SHARED_PTR_BIASED
+    // the references of the owner thread released by the writer are merged by the owner thread
+    biased_count::merge_queued();
+#endif
+    EXPECT_EQ(0, Node::_mNbInstances);
+}
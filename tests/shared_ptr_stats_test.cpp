@@ -0,0 +1,151 @@
+/**
+ * @file  shared_ptr_stats_test.cpp
+ * @brief Unit Test of the instrumentation of the reference counting of shared_ptr (SHARED_PTR_STATS) using Google Test library.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#ifndef SHARED_PTR_STATS
+#error "this test must be compiled with SHARED_PTR_STATS defined"
+#endif
+
+#include "shared_ptr.hpp"
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+// a different type for each test, so that their statistics do not mix
+template<int N>
+struct Tracked
+{
+    explicit Tracked(int aVal = 0) :
+        mVal(aVal)
+    {
+    }
+    int mVal;
+};
+
+
+TEST(shared_ptr_stats, counters)
+{
+    typedef Tracked<1> Type;
+    weak_ptr<Type> wPtr;
+    {
+        shared_ptr<Type> xPtr(new Type(1));
+        shared_ptr<Type> copyPtr(xPtr);
+        shared_ptr<Type> assignedPtr;
+        assignedPtr = xPtr;
+        wPtr = xPtr;
+        shared_ptr<Type> lockedPtr = wPtr.lock();
+        EXPECT_EQ(4, xPtr.use_count());
+
+        const shared_ptr_stats::counters values = shared_ptr_stats::get<Type>();
+        EXPECT_EQ(1, values.allocations);
+        EXPECT_EQ(1, values.live());
+        EXPECT_EQ(3, values.increments);
+        EXPECT_EQ(0, values.decrements);
+        EXPECT_EQ(4, values.peak_use_count);
+    }
+    EXPECT_EQ(false, wPtr.lock());
+
+    const shared_ptr_stats::counters values = shared_ptr_stats::get<Type>();
+    EXPECT_EQ(1, values.allocations);
+    EXPECT_EQ(1, values.expirations);
+    EXPECT_EQ(0, values.live());
+    EXPECT_EQ(3, values.increments);
+    EXPECT_EQ(4, values.decrements);
+    EXPECT_EQ(0, values.remote);
+    EXPECT_EQ(4, values.peak_use_count);
+    EXPECT_LE(0, values.max_lifetime);
+    EXPECT_LE(values.max_lifetime, values.total_lifetime);
+}
+
+TEST(shared_ptr_stats, leaks)
+{
+    // the objects still alive are reported for each way of creating them
+    typedef Tracked<2> Type;
+    shared_ptr<Type> xPtr(new Type);
+    shared_ptr<Type> yPtr = make_shared<Type>(2);
+    shared_ptr<Type> zPtr(new Type, std::default_delete<Type>());
+    shared_ptr<Type[]> arrayPtr = make_shared<Type[]>(4);
+    EXPECT_EQ(3, shared_ptr_stats::get<Type>().live());
+    EXPECT_EQ(1, shared_ptr_stats::get<Type[]>().live());
+    yPtr.reset();
+    arrayPtr.reset();
+    EXPECT_EQ(2, shared_ptr_stats::get<Type>().live());
+    EXPECT_EQ(0, shared_ptr_stats::get<Type[]>().live());
+}
+
+TEST(shared_ptr_stats, threads)
+{
+    typedef Tracked<3> Type;
+    shared_ptr<Type> xPtr(new Type);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i)
+    {
+        threads.push_back(std::thread([xPtr]()
+        {
+            // the copies of a shared object made by the other threads are remote
+            for (int j = 0; j < 100; ++j)
+            {
+                shared_ptr<Type> copyPtr(xPtr);
+            }
+            // the counters of the objects created by each thread are merged when it exits
+            for (int j = 0; j < 10; ++j)
+            {
+                shared_ptr<Type> localPtr(new Type(j));
+                shared_ptr<Type> copyPtr(localPtr);
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i].join();
+    }
+
+    const shared_ptr_stats::counters values = shared_ptr_stats::get<Type>();
+    EXPECT_EQ(41, values.allocations);
+    EXPECT_EQ(1,  values.live());
+    EXPECT_EQ(4 + 4 * 100 + 4 * 10, values.increments); // including the copies captured by the lambdas
+    EXPECT_EQ(4 + 4 * 100 + 4 * 10 * 2, values.decrements);
+    EXPECT_EQ(2 * (4 + 4 * 100) - 4, values.remote);    // the captures are copied by this thread, and released by the other ones
+}
+
+TEST(shared_ptr_stats, exited_thread)
+{
+    // the copies made by a thread reusing the storage of the exited thread that created the object are still remote
+    typedef Tracked<5> Type;
+    shared_ptr<Type> xPtr;
+    std::thread creator([&xPtr]()
+    {
+        xPtr.reset(new Type);
+    });
+    creator.join();
+    std::thread user([&xPtr]()
+    {
+        shared_ptr<Type> copyPtr(xPtr);
+    });
+    user.join();
+
+    const shared_ptr_stats::counters values = shared_ptr_stats::get<Type>();
+    EXPECT_EQ(1, values.increments);
+    EXPECT_EQ(1, values.decrements);
+    EXPECT_EQ(2, values.remote);
+}
+
+TEST(shared_ptr_stats, dump)
+{
+    typedef Tracked<4> Type;
+    shared_ptr<Type> xPtr(new Type);
+    std::ostringstream os;
+    shared_ptr_stats::dump(os);
+    EXPECT_NE(std::string::npos, os.str().find("shared_ptr_stats:"));
+    EXPECT_NE(std::string::npos, os.str().find("Tracked<4>"));
+}
@@ -11,6 +11,16 @@
 #include "shared_ptr.hpp"
 
 #include <vector>
+#include <iterator>
+#include <set>
+#include <map>
+#ifdef SHARED_PTR_CPP11
+#include <unordered_map>
+#include <unordered_set>
+#include <type_traits>
+#include <stdexcept>
+#include <thread>
+#endif
 
 #include <gtest/gtest.h>
 
@@ -419,6 +429,211 @@ TEST(shared_ptr, std_container)
     EXPECT_EQ(0, Struct::_mNbInstances);
 }
 
+TEST(shared_ptr, ptr_less)
+{
+    {
+        shared_ptr<Struct> xPtr(new Struct(123));
+        shared_ptr<Struct> yPtr(new Struct(234));
+        Struct* pX = xPtr.get();
+
+        // The raw-pointer comparators accept smart and raw pointers alike
+        EXPECT_EQ(true,  ptr_equal()(xPtr, pX));
+        EXPECT_EQ(true,  ptr_equal()(pX, xPtr));
+        EXPECT_EQ(false, ptr_equal()(yPtr, pX));
+        EXPECT_EQ(xPtr < yPtr, ptr_less()(xPtr, yPtr));
+        EXPECT_EQ(xPtr < yPtr, ptr_less()(pX, yPtr));
+        EXPECT_EQ(false, ptr_less()(xPtr, pX));
+        EXPECT_EQ(false, ptr_less()(pX, xPtr));
+        EXPECT_EQ(pX, get_pointer(xPtr));
+        EXPECT_EQ(pX, get_pointer(pX));
+
+        std::set<shared_ptr<Struct>, ptr_less> set;
+        set.insert(xPtr);
+        set.insert(yPtr);
+        set.insert(xPtr);
+        EXPECT_EQ(2u, set.size());
+#if (__cplusplus >= 201402L)
+        // Heterogeneous lookup by raw pointer, without building a temporary shared_ptr
+        EXPECT_EQ(xPtr, *set.find(pX));
+        EXPECT_EQ(1u, set.count(pX));
+        EXPECT_EQ(2, xPtr.use_count());
+#endif
+    }
+    EXPECT_EQ(0, Struct::_mNbInstances);
+}
+
+TEST(shared_ptr, owner_less)
+{
+    {
+        shared_ptr<Struct> xPtr(new Struct(123));
+        shared_ptr<Struct> yPtr(new Struct(234));
+        // aliasing a member of the object, sharing its ownership
+        shared_ptr<int> valPtr(xPtr, &xPtr->mVal);
+        weak_ptr<Struct> wPtr(xPtr);
+
+        // The pointers sharing the ownership of an object are equivalent, whatever they point to
+        EXPECT_EQ(false, owner_less()(xPtr, valPtr));
+        EXPECT_EQ(false, owner_less()(valPtr, xPtr));
+        EXPECT_EQ(false, owner_less()(wPtr, valPtr));
+        EXPECT_EQ(false, owner_less()(xPtr, wPtr));
+        EXPECT_EQ(true,  owner_equal()(xPtr, valPtr));
+        EXPECT_EQ(true,  owner_equal()(wPtr, xPtr));
+        EXPECT_EQ(false, owner_equal()(wPtr, yPtr));
+        EXPECT_NE(owner_less()(xPtr, yPtr), owner_less()(yPtr, wPtr));
+
+        std::map<weak_ptr<Struct>, int, owner_less> map;
+        map[wPtr] = 1;
+        map[weak_ptr<Struct>(yPtr)] = 2;
+        EXPECT_EQ(2u, map.size());
+#if (__cplusplus >= 201402L)
+        // Heterogeneous lookup by shared_ptr, without building a temporary weak_ptr
+        EXPECT_EQ(1, map.find(valPtr)->second);
+#endif
+
+        // A weak_ptr keeps its place after its object has expired
+        xPtr.reset();
+        valPtr.reset();
+        EXPECT_EQ(true, wPtr.expired());
+        EXPECT_EQ(1, map[wPtr]);
+        EXPECT_EQ(2u, map.size());
+    }
+    EXPECT_EQ(0, Struct::_mNbInstances);
+}
+
+#ifdef SHARED_PTR_CPP11
+TEST(shared_ptr, hash)
+{
+    {
+        shared_ptr<Struct> xPtr(new Struct(123));
+        shared_ptr<Struct> yPtr(new Struct(234));
+        Struct* pX = xPtr.get();
+
+        // std::hash of a shared_ptr is the one of its raw pointer, like ptr_hash
+        EXPECT_EQ(std::hash<Struct*>()(pX), std::hash<shared_ptr<Struct> >()(xPtr));
+        EXPECT_EQ(ptr_hash()(pX), ptr_hash()(xPtr));
+        EXPECT_EQ(std::hash<shared_ptr<Struct> >()(xPtr), ptr_hash()(xPtr));
+
+        std::unordered_map<shared_ptr<Struct>, int> map;
+        map[xPtr] = 1;
+        map[yPtr] = 2;
+        map[xPtr] = 3;
+        EXPECT_EQ(2u, map.size());
+        EXPECT_EQ(3, map[xPtr]);
+
+        std::unordered_set<shared_ptr<Struct>, ptr_hash, ptr_equal> set;
+        set.insert(xPtr);
+        set.insert(yPtr);
+        EXPECT_EQ(2u, set.size());
+#ifdef __cpp_lib_generic_unordered_lookup
+        // Heterogeneous lookup by raw pointer, without building a temporary shared_ptr
+        EXPECT_EQ(xPtr, *set.find(pX));
+#endif
+
+        // owner_hash is consistent with owner_equal
+        shared_ptr<int> valPtr(xPtr, &xPtr->mVal);
+        weak_ptr<Struct> wPtr(xPtr);
+        EXPECT_EQ(xPtr.owner_hash(), owner_hash()(valPtr));
+        EXPECT_EQ(xPtr.owner_hash(), owner_hash()(wPtr));
+        std::unordered_set<weak_ptr<Struct>, owner_hash, owner_equal> weakSet;
+        weakSet.insert(wPtr);
+        weakSet.insert(weak_ptr<Struct>(yPtr));
+        weakSet.insert(weak_ptr<Struct>(xPtr));
+        EXPECT_EQ(2u, weakSet.size());
+    }
+    EXPECT_EQ(0, Struct::_mNbInstances);
+}
+#endif
+
+TEST(shared_ptr, share_n)
+{
+    {
+        shared_ptr<Struct> xPtr(new Struct(123));
+        shared_ptr<Struct> yPtr(new Struct(234));
+
+        // The n copies are counted with a single update of the reference counter
+        std::vector<shared_ptr<Struct> > ptrs;
+        std::back_insert_iterator<std::vector<shared_ptr<Struct> > > out = share_n(xPtr, 3, std::back_inserter(ptrs));
+        out = share_n(yPtr, 2, out);
+        share_n(xPtr, 0, out);
+        EXPECT_EQ(5u, ptrs.size());
+        EXPECT_EQ(4, xPtr.use_count());
+        EXPECT_EQ(3, yPtr.use_count());
+        EXPECT_EQ(xPtr, ptrs[2]);
+        EXPECT_EQ(yPtr, ptrs[3]);
+
+        // Into an existing range
+        shared_ptr<Struct> array[4];
+        EXPECT_EQ(array + 4, share_n(yPtr, 4, array));
+        EXPECT_EQ(7, yPtr.use_count());
+        EXPECT_EQ(234, array[3]->mVal);
+
+        // The consecutive shared_ptr sharing a control block are released with a single update of the reference counter
+        ptrs.push_back(xPtr);
+        ptrs.push_back(shared_ptr<Struct>());
+        release_all(ptrs);
+        EXPECT_EQ(7u, ptrs.size());
+        for (size_t i = 0; i < ptrs.size(); ++i)
+        {
+            EXPECT_EQ(false, ptrs[i]);
+        }
+        EXPECT_EQ(1, xPtr.use_count());
+        EXPECT_EQ(5, yPtr.use_count());
+        release_all(array, array + 4);
+        EXPECT_EQ(true, yPtr.unique());
+
+        // The last references released in bulk destroy the object
+        share_n(xPtr, 2, std::back_inserter(ptrs));
+        xPtr.reset();
+        EXPECT_EQ(2, Struct::_mNbInstances);
+        release_all(ptrs);
+        EXPECT_EQ(1, Struct::_mNbInstances);
+    }
+    EXPECT_EQ(0, Struct::_mNbInstances);
+}
+
+// output iterator throwing after a number of copies
+struct ThrowingOutput
+{
+    ThrowingOutput(std::vector<shared_ptr<Struct> >& aPtrs, size_t aNbCopies) :
+        mPtrs(aPtrs),
+        mNbCopies(aNbCopies)
+    {
+    }
+    ThrowingOutput& operator*(void)
+    {
+        return *this;
+    }
+    ThrowingOutput& operator++(void)
+    {
+        return *this;
+    }
+    ThrowingOutput& operator=(const shared_ptr<Struct>& ptr)
+    {
+        if (mNbCopies <= mPtrs.size())
+        {
+            throw std::bad_alloc();
+        }
+        mPtrs.push_back(ptr);
+        return *this;
+    }
+
+    std::vector<shared_ptr<Struct> >&   mPtrs;
+    size_t                              mNbCopies;
+};
+
+TEST(shared_ptr, share_n_throw)
+{
+    {
+        shared_ptr<Struct> xPtr(new Struct(123));
+        std::vector<shared_ptr<Struct> > ptrs;
+        // The references not given to the output are released with the exception
+        EXPECT_THROW(share_n(xPtr, 5, ThrowingOutput(ptrs, 2)), std::bad_alloc);
+        EXPECT_EQ(2u, ptrs.size());
+        EXPECT_EQ(3, xPtr.use_count());
+    }
+    EXPECT_EQ(0, Struct::_mNbInstances);
+}
+
 TEST(shared_ptr, swap_ptr)
 {
     // Create a shared_ptr
@@ -647,3 +862,782 @@ TEST(shared_ptr, dyn_pointer_cast)
    EXPECT_EQ(0,     B::_mNbInstances);
 }
 
+
+TEST(shared_ptr, make_shared)
+{
+    {
+        // Create a shared_ptr and its object in a single allocation
+        shared_ptr<Struct> xPtr = make_shared<Struct>(123);
+
+        EXPECT_EQ(true, xPtr);
+        EXPECT_EQ(true, xPtr.unique());
+        EXPECT_EQ(1,    xPtr.use_count());
+        EXPECT_NE((void*)NULL, xPtr.get());
+        EXPECT_EQ(123,  xPtr->mVal);
+        EXPECT_EQ(1,    Struct::_mNbInstances);
+
+        // Copy construct the shared_ptr
+        shared_ptr<Struct> yPtr(xPtr);
+
+        EXPECT_EQ(xPtr,  yPtr);
+        EXPECT_EQ(false, xPtr.unique());
+        EXPECT_EQ(2,     xPtr.use_count());
+        EXPECT_EQ(2,     yPtr.use_count());
+        EXPECT_EQ(1,     Struct::_mNbInstances);
+
+        // Reset the original pointer, the object survives in the copy
+        xPtr.reset();
+
+        EXPECT_EQ(false, xPtr);
+        EXPECT_EQ(true,  yPtr.unique());
+        EXPECT_EQ(123,   yPtr->mVal);
+        EXPECT_EQ(1,     Struct::_mNbInstances);
+    }
+    // the last copy destroyed the object constructed in place
+    EXPECT_EQ(0, Struct::_mNbInstances);
+
+    {
+        // Create a derived object in place and convert it to a pointer to its base class
+        shared_ptr<A> aPtr = make_shared<B>();
+
+        EXPECT_EQ(true, aPtr);
+        EXPECT_EQ(true, aPtr.unique());
+        EXPECT_EQ(1,    A::_mNbInstances);
+        EXPECT_EQ(1,    B::_mNbInstances);
+
+        // dynamic cast back to the derived class, sharing the same control block
+        shared_ptr<B> bPtr = dynamic_pointer_cast<B>(aPtr);
+        EXPECT_EQ(true, bPtr);
+        EXPECT_EQ(2,    bPtr.use_count());
+    }
+    EXPECT_EQ(0, A::_mNbInstances);
+    EXPECT_EQ(0, B::_mNbInstances);
+}
+
+TEST(shared_ptr, array)
+{
+    {
+        // Manage an array allocated with new[]
+        shared_ptr<B[]> xPtr(new B[3]);
+
+        EXPECT_EQ(true, xPtr.unique());
+        EXPECT_EQ(3,    A::_mNbInstances);
+        EXPECT_EQ(3,    B::_mNbInstances);
+        EXPECT_EQ(&xPtr.get()[2], &xPtr[2]);
+
+        // Share it, and observe it with a weak_ptr
+        shared_ptr<B[]> yPtr(xPtr);
+        weak_ptr<B[]> wPtr(xPtr);
+        EXPECT_EQ(2,    xPtr.use_count());
+        EXPECT_EQ(xPtr, wPtr.lock());
+
+        // Reset with another array: the first one is deleted with delete[]
+        xPtr.reset(new B[2]);
+        yPtr.reset();
+        EXPECT_EQ(true, wPtr.expired());
+        EXPECT_EQ(2,    A::_mNbInstances);
+        EXPECT_EQ(2,    B::_mNbInstances);
+    }
+    EXPECT_EQ(0, A::_mNbInstances);
+    EXPECT_EQ(0, B::_mNbInstances);
+}
+
+TEST(shared_ptr, make_shared_array)
+{
+    {
+        // Create a shared_ptr and its array of value-initialized elements in a single allocation
+        shared_ptr<int[]> xPtr = make_shared<int[]>(1000);
+
+        EXPECT_EQ(true, xPtr.unique());
+        for (int i = 0; i < 1000; ++i)
+        {
+            EXPECT_EQ(0, xPtr[i]);
+            xPtr[i] = i;
+        }
+        EXPECT_EQ(999,  xPtr.get()[999]);
+
+        // Create an array of objects, destroyed with the last reference
+        shared_ptr<B[]> yPtr = make_shared<B[]>(4);
+        EXPECT_EQ(4,    A::_mNbInstances);
+        EXPECT_EQ(4,    B::_mNbInstances);
+        shared_ptr<B[]> zPtr(yPtr);
+        yPtr.reset();
+        EXPECT_EQ(4,    B::_mNbInstances);
+        zPtr.reset();
+        EXPECT_EQ(0,    A::_mNbInstances);
+        EXPECT_EQ(0,    B::_mNbInstances);
+
+        // An empty array is still a valid (but not dereferenceable) pointer
+        shared_ptr<int[]> emptyPtr = make_shared<int[]>(0);
+        EXPECT_EQ(true, emptyPtr);
+        EXPECT_NE((void*)NULL, emptyPtr.get());
+    }
+    EXPECT_EQ(0, A::_mNbInstances);
+}
+
+#ifdef SHARED_PTR_CPP11
+TEST(shared_ptr, move_ptr)
+{
+    {
+        shared_ptr<Struct> xPtr(new Struct(123));
+        Struct* pX = xPtr.get();
+
+        // Move construct the shared_ptr, stealing the ownership of the object
+        shared_ptr<Struct> yPtr(std::move(xPtr));
+
+        EXPECT_EQ(false, xPtr);
+        EXPECT_EQ(0,     xPtr.use_count());
+        EXPECT_EQ((void*)NULL, xPtr.get());
+        EXPECT_EQ(true,  yPtr);
+        EXPECT_EQ(true,  yPtr.unique());
+        EXPECT_EQ(pX,    yPtr.get());
+        EXPECT_EQ(1,     Struct::_mNbInstances);
+
+        // Move assign the shared_ptr, releasing the previous object
+        shared_ptr<Struct> zPtr(new Struct(234));
+        EXPECT_EQ(2,     Struct::_mNbInstances);
+        zPtr = std::move(yPtr);
+
+        EXPECT_EQ(false, yPtr);
+        EXPECT_EQ(0,     yPtr.use_count());
+        EXPECT_EQ(true,  zPtr.unique());
+        EXPECT_EQ(pX,    zPtr.get());
+        EXPECT_EQ(123,   zPtr->mVal);
+        EXPECT_EQ(1,     Struct::_mNbInstances);
+
+        // Move assign an empty shared_ptr, releasing the object
+        zPtr = std::move(xPtr);
+        EXPECT_EQ(false, zPtr);
+        EXPECT_EQ(0,     Struct::_mNbInstances);
+    }
+
+    {
+        // Move construct with conversion to the base class
+        shared_ptr<B> bPtr(new B);
+        shared_ptr<A> aPtr(std::move(bPtr));
+
+        EXPECT_EQ(false, bPtr);
+        EXPECT_EQ(true,  aPtr.unique());
+        EXPECT_EQ(1,     A::_mNbInstances);
+        EXPECT_EQ(1,     B::_mNbInstances);
+    }
+    EXPECT_EQ(0, A::_mNbInstances);
+    EXPECT_EQ(0, B::_mNbInstances);
+
+    {
+        shared_ptr<Struct> xPtr(new Struct(123));
+        std::vector<shared_ptr<Struct> > PtrList;
+
+        // Reallocating the container moves the shared_ptr it contains, since moving never throws
+        EXPECT_EQ(true, std::is_nothrow_move_constructible<shared_ptr<Struct> >::value);
+        for (int i = 0; i < 100; ++i)
+        {
+            PtrList.push_back(xPtr);
+            EXPECT_EQ(i + 2, xPtr.use_count());
+        }
+        PtrList.clear();
+        EXPECT_EQ(true, xPtr.unique());
+    }
+    EXPECT_EQ(0, Struct::_mNbInstances);
+}
+#endif
+
+#ifdef SHARED_PTR_CPP11
+// number of blocks currently allocated by all the (rebound) CountingAllocator
+static int _gNbAllocations = 0;
+
+// minimal allocator counting its allocations
+template<class T>
+struct CountingAllocator
+{
+    typedef T value_type;
+
+    CountingAllocator(void)
+    {
+    }
+    template<class U>
+    CountingAllocator(const CountingAllocator<U>&)
+    {
+    }
+    T* allocate(std::size_t n)
+    {
+        ++_gNbAllocations;
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T* p, std::size_t)
+    {
+        --_gNbAllocations;
+        ::operator delete(p);
+    }
+};
+
+struct Throwing
+{
+    Throwing(void)
+    {
+        throw std::runtime_error("Throwing");
+    }
+};
+
+// throws on the construction of the third element of an array
+struct ThrowingThird : public A
+{
+    ThrowingThird(void)
+    {
+        if (3 == ++_mNbConstructions)
+        {
+            throw std::runtime_error("ThrowingThird");
+        }
+    }
+    static int _mNbConstructions;
+};
+int ThrowingThird::_mNbConstructions = 0;
+
+TEST(shared_ptr, nullptr)
+{
+    // Construct, reset and compare with nullptr
+    shared_ptr<Struct> xPtr(nullptr);
+    EXPECT_EQ(true,  xPtr == nullptr);
+    EXPECT_EQ(true,  nullptr == xPtr);
+    EXPECT_EQ(false, xPtr != nullptr);
+    xPtr = make_shared<Struct>(123);
+    EXPECT_EQ(false, xPtr == nullptr);
+    EXPECT_EQ(true,  nullptr != xPtr);
+    xPtr = nullptr;
+    EXPECT_EQ(false, xPtr);
+    EXPECT_EQ(0,     Struct::_mNbInstances);
+
+    // The non-throwing operations are noexcept
+    EXPECT_EQ(true, noexcept(shared_ptr<Struct>()));
+    EXPECT_EQ(true, noexcept(shared_ptr<Struct>(xPtr)));
+    EXPECT_EQ(true, noexcept(xPtr.reset()));
+    EXPECT_EQ(true, noexcept(static_cast<bool>(xPtr)));
+    EXPECT_EQ(true, noexcept(xPtr.get()));
+    EXPECT_EQ(true, noexcept(xPtr.use_count()));
+    EXPECT_EQ(true, noexcept(weak_ptr<Struct>(xPtr).lock()));
+}
+
+TEST(shared_ptr, allocate_shared)
+{
+    {
+        // Create a shared_ptr and its object in a single allocation from a custom allocator
+        shared_ptr<Struct> xPtr = allocate_shared<Struct>(CountingAllocator<Struct>(), 123);
+
+        EXPECT_EQ(true, xPtr.unique());
+        EXPECT_EQ(123,  xPtr->mVal);
+        EXPECT_EQ(1,    Struct::_mNbInstances);
+        EXPECT_EQ(1,    _gNbAllocations);
+
+        shared_ptr<Struct> yPtr(xPtr);
+        EXPECT_EQ(2,    xPtr.use_count());
+        EXPECT_EQ(1,    _gNbAllocations);
+    }
+    // the control block is freed with the allocator
+    EXPECT_EQ(0, Struct::_mNbInstances);
+    EXPECT_EQ(0, _gNbAllocations);
+
+    // An exception thrown by the constructor frees the control block
+    EXPECT_THROW(allocate_shared<Throwing>(CountingAllocator<Throwing>()), std::runtime_error);
+    EXPECT_EQ(0, _gNbAllocations);
+
+    {
+        // Create a shared_ptr and its array of elements in a single allocation from a custom allocator
+        shared_ptr<A[]> xPtr = allocate_shared<A[]>(CountingAllocator<A>(), 100);
+        EXPECT_EQ(true, xPtr.unique());
+        EXPECT_EQ(100,  A::_mNbInstances);
+        EXPECT_EQ(1,    _gNbAllocations);
+    }
+    EXPECT_EQ(0, A::_mNbInstances);
+    EXPECT_EQ(0, _gNbAllocations);
+
+    // An exception thrown by the constructor of an element destroys the previous ones and frees the control block
+    EXPECT_THROW(allocate_shared<ThrowingThird[]>(CountingAllocator<ThrowingThird>(), 5), std::runtime_error);
+    EXPECT_EQ(0, A::_mNbInstances);
+    EXPECT_EQ(0, _gNbAllocations);
+}
+
+TEST(shared_ptr, pool_allocator)
+{
+    Struct* pX = NULL;
+    {
+        shared_ptr<Struct> xPtr = allocate_shared<Struct>(pool_allocator<Struct>(), 123);
+        EXPECT_EQ(true, xPtr.unique());
+        EXPECT_EQ(123,  xPtr->mVal);
+        pX = xPtr.get();
+    }
+    EXPECT_EQ(0, Struct::_mNbInstances);
+
+    // the control block is recycled by the per-thread pool
+    shared_ptr<Struct> yPtr = allocate_shared<Struct>(pool_allocator<Struct>(), 234);
+    EXPECT_EQ(pX,   yPtr.get());
+    EXPECT_EQ(234,  yPtr->mVal);
+}
+
+// objects copied concurrently by many threads: their counters are on their own cache line
+struct Contended
+{
+    explicit Contended(int aVal) :
+        mVal(aVal)
+    {
+    }
+    int mVal;
+};
+template<> struct shared_ptr_layout<Contended> { typedef padded_layout type; };
+
+TEST(shared_ptr, padded_layout)
+{
+    const std::size_t line_size = SHARED_PTR_CACHE_LINE_SIZE;
+    {
+        // The object starts on a cache line boundary, after the counters
+        shared_ptr<Struct> xPtr = make_shared_padded<Struct>(123);
+        EXPECT_EQ(true, xPtr.unique());
+        EXPECT_EQ(123,  xPtr->mVal);
+        EXPECT_EQ(1,    Struct::_mNbInstances);
+        EXPECT_EQ(0u,   reinterpret_cast<std::size_t>(xPtr.get()) % line_size);
+
+        weak_ptr<Struct> wPtr(xPtr);
+        shared_ptr<Struct> yPtr(xPtr);
+        EXPECT_EQ(2,    xPtr.use_count());
+        xPtr.reset();
+        yPtr.reset();
+        EXPECT_EQ(0,    Struct::_mNbInstances);
+        EXPECT_EQ(true, wPtr.expired());
+    }
+
+    // The layout selected for a type applies to make_shared() and allocate_shared()
+    shared_ptr<Contended> xPtr = make_shared<Contended>(1);
+    shared_ptr<Contended> yPtr = allocate_shared<Contended>(CountingAllocator<Contended>(), 2);
+    EXPECT_EQ(1,  xPtr->mVal);
+    EXPECT_EQ(2,  yPtr->mVal);
+    EXPECT_EQ(0u, reinterpret_cast<std::size_t>(xPtr.get()) % line_size);
+    EXPECT_EQ(0u, reinterpret_cast<std::size_t>(yPtr.get()) % line_size);
+    EXPECT_EQ(1,  _gNbAllocations);
+    yPtr.reset();
+    EXPECT_EQ(0,  _gNbAllocations);
+
+    // An exception thrown by the constructor frees the control block
+    EXPECT_THROW((allocate_shared_layout<Throwing, padded_layout>(CountingAllocator<Throwing>())), std::runtime_error);
+    EXPECT_EQ(0, _gNbAllocations);
+}
+#endif
+
+TEST(shared_ptr, weak_ptr)
+{
+    // Create an empty (ie. NULL) weak_ptr
+    weak_ptr<Struct> wPtr;
+    EXPECT_EQ(true,  wPtr.expired());
+    EXPECT_EQ(0,     wPtr.use_count());
+    EXPECT_EQ(false, wPtr.lock());
+
+    {
+        shared_ptr<Struct> xPtr(new Struct(123));
+
+        // Observe the shared_ptr without sharing its ownership
+        wPtr = xPtr;
+        EXPECT_EQ(false, wPtr.expired());
+        EXPECT_EQ(1,     wPtr.use_count());
+        EXPECT_EQ(true,  xPtr.unique());
+
+        // Lock the weak_ptr to get a new shared_ptr on the object
+        shared_ptr<Struct> yPtr = wPtr.lock();
+        EXPECT_EQ(xPtr,  yPtr);
+        EXPECT_EQ(2,     xPtr.use_count());
+        EXPECT_EQ(2,     wPtr.use_count());
+        EXPECT_EQ(123,   yPtr->mVal);
+
+        // Copy the weak_ptr
+        weak_ptr<Struct> w2Ptr(wPtr);
+        EXPECT_EQ(2,     w2Ptr.use_count());
+        EXPECT_EQ(1,     Struct::_mNbInstances);
+    }
+    // The object is destroyed with the last shared_ptr, even though the weak_ptr survives
+    EXPECT_EQ(0,     Struct::_mNbInstances);
+    EXPECT_EQ(true,  wPtr.expired());
+    EXPECT_EQ(0,     wPtr.use_count());
+    EXPECT_EQ(false, wPtr.lock());
+
+    // Reset the weak_ptr, destroying the control block
+    wPtr.reset();
+    EXPECT_EQ(true,  wPtr.expired());
+
+    {
+        // Observe an object created in place, and convert the weak_ptr to its base class
+        shared_ptr<B> bPtr = make_shared<B>();
+        weak_ptr<B> wbPtr(bPtr);
+        weak_ptr<A> waPtr(wbPtr);
+        EXPECT_EQ(false, waPtr.expired());
+        EXPECT_EQ(bPtr.get(), waPtr.lock().get());
+
+        // The object is destroyed, but its memory is kept by the weak_ptr along with the control block
+        bPtr.reset();
+        EXPECT_EQ(0,     A::_mNbInstances);
+        EXPECT_EQ(true,  waPtr.expired());
+        EXPECT_EQ(true,  wbPtr.expired());
+        EXPECT_EQ(false, waPtr.lock());
+    }
+}
+
+// stateless deleter, stored in the control block using the empty base optimization
+struct StructDeleter
+{
+    void operator()(Struct* p) const
+    {
+        ++_mNbCalls;
+        delete p;
+    }
+    static int _mNbCalls;
+};
+int StructDeleter::_mNbCalls = 0;
+
+// deleter throwing on its copies once their budget is exhausted
+struct ThrowingCopyDeleter
+{
+    ThrowingCopyDeleter(void)
+    {
+    }
+    ThrowingCopyDeleter(const ThrowingCopyDeleter&)
+    {
+        if (0 == _mNbCopiesLeft--)
+        {
+            throw std::runtime_error("ThrowingCopyDeleter");
+        }
+    }
+    void operator()(Struct* p) const
+    {
+        ++_mNbCalls;
+        delete p;
+    }
+    static int _mNbCopiesLeft;
+    static int _mNbCalls;
+};
+int ThrowingCopyDeleter::_mNbCopiesLeft = 0;
+int ThrowingCopyDeleter::_mNbCalls = 0;
+
+// function used as a deleter
+static void delete_struct_array(Struct* p)
+{
+    delete[] p;
+}
+
+TEST(shared_ptr, last_release)
+{
+#if (__cplusplus >= 201402L)
+    // The control blocks are final, so that their dispose() and destroy() are devirtualized
+    EXPECT_EQ(true, std::is_final<count_impl<Struct> >::value);
+    EXPECT_EQ(true, std::is_final<count_impl<Struct[]> >::value);
+    EXPECT_EQ(true, (std::is_final<count_impl_pd<Struct*, void(*)(Struct*)> >::value));
+    EXPECT_EQ(true, (std::is_final<count_inplace<Struct, std::allocator<Struct> > >::value));
+#endif
+    {
+        // Without weak_ptr, the last release destroys the object and frees the control block at once
+        shared_ptr<Struct> xPtr = make_shared<Struct>(123);
+        shared_ptr<Struct> yPtr(new Struct(234));
+        EXPECT_EQ(2, Struct::_mNbInstances);
+        xPtr.reset();
+        yPtr.reset();
+        EXPECT_EQ(0, Struct::_mNbInstances);
+
+        // With a weak_ptr, the control block is freed by the release of the last weak_ptr
+        xPtr = make_shared<Struct>(345);
+        weak_ptr<Struct> wPtr(xPtr);
+        xPtr.reset();
+        EXPECT_EQ(0, Struct::_mNbInstances);
+        EXPECT_EQ(true, wPtr.expired());
+    }
+    EXPECT_EQ(0, Struct::_mNbInstances);
+}
+
+TEST(shared_ptr, deleter)
+{
+    // a stateless deleter takes no space in the control block
+    EXPECT_EQ(sizeof(count_impl<Struct>), sizeof(count_impl_pd<Struct*, StructDeleter>));
+
+    {
+        // Create a shared_ptr with a custom deleter
+        shared_ptr<Struct> xPtr(new Struct(123), StructDeleter());
+        EXPECT_EQ(true, xPtr.unique());
+        EXPECT_EQ(123,  xPtr->mVal);
+        EXPECT_EQ(1,    Struct::_mNbInstances);
+
+        shared_ptr<Struct> yPtr(xPtr);
+        EXPECT_EQ(2,    xPtr.use_count());
+        EXPECT_EQ(0,    StructDeleter::_mNbCalls);
+    }
+    // the last shared_ptr called the deleter
+    EXPECT_EQ(0, Struct::_mNbInstances);
+    EXPECT_EQ(1, StructDeleter::_mNbCalls);
+
+    {
+        // Manage an array with a function calling delete[]
+        shared_ptr<Struct> xPtr(new Struct[3]{Struct(1), Struct(2), Struct(3)}, delete_struct_array);
+        EXPECT_EQ(3, Struct::_mNbInstances);
+
+        // reset it with another array
+        xPtr.reset(new Struct[2]{Struct(4), Struct(5)}, delete_struct_array);
+        EXPECT_EQ(2, Struct::_mNbInstances);
+        EXPECT_EQ(4, xPtr->mVal);
+    }
+    EXPECT_EQ(0, Struct::_mNbInstances);
+
+    {
+        // The pointer is deleted by the deleter if its copy into the control block throws
+        const ThrowingCopyDeleter deleter;
+        ThrowingCopyDeleter::_mNbCopiesLeft = 1; // the argument of the constructor
+        EXPECT_THROW((shared_ptr<Struct>(new Struct(6), deleter)), std::runtime_error);
+        EXPECT_EQ(0, Struct::_mNbInstances);
+        EXPECT_EQ(1, ThrowingCopyDeleter::_mNbCalls);
+
+        shared_ptr<Struct> xPtr(new Struct(7));
+        ThrowingCopyDeleter::_mNbCopiesLeft = 2; // the arguments of reset() and of the constructor
+        EXPECT_THROW(xPtr.reset(new Struct(8), deleter), std::runtime_error);
+        EXPECT_EQ(7, xPtr->mVal);
+        EXPECT_EQ(1, Struct::_mNbInstances);
+        EXPECT_EQ(2, ThrowingCopyDeleter::_mNbCalls);
+    }
+    EXPECT_EQ(0, Struct::_mNbInstances);
+}
+
+struct Pair
+{
+    Struct  first;
+    Struct  second;
+
+    Pair(int aFirst, int aSecond) :
+        first(aFirst),
+        second(aSecond)
+    {
+    }
+};
+
+TEST(shared_ptr, aliasing)
+{
+    shared_ptr<Struct> secondPtr;
+    {
+        shared_ptr<Pair> pairPtr(new Pair(1, 2));
+        EXPECT_EQ(2, Struct::_mNbInstances);
+
+        // Point to a member of the object while sharing the ownership of the whole object
+        shared_ptr<Struct> firstPtr(pairPtr, &pairPtr->first);
+        secondPtr = shared_ptr<Struct>(pairPtr, &pairPtr->second);
+        EXPECT_EQ(3, pairPtr.use_count());
+        EXPECT_EQ(3, firstPtr.use_count());
+        EXPECT_EQ(1, firstPtr->mVal);
+        EXPECT_EQ(2, secondPtr->mVal);
+    }
+    // the aliased pointer keeps the whole object alive
+    EXPECT_EQ(true, secondPtr.unique());
+    EXPECT_EQ(2,    secondPtr->mVal);
+    EXPECT_EQ(2,    Struct::_mNbInstances);
+
+    secondPtr.reset();
+    EXPECT_EQ(0,    Struct::_mNbInstances);
+
+    {
+        // An alias of a member of no object tests its stored pointer, not the reference counter
+        Struct unowned(3);
+        shared_ptr<Struct> aliasPtr(shared_ptr<Struct>(), &unowned);
+        EXPECT_EQ(true, aliasPtr);
+        EXPECT_EQ(0,    aliasPtr.use_count());
+
+        // and the reverse: a NULL alias sharing the ownership of an object
+        shared_ptr<Struct> xPtr(new Struct(4));
+        shared_ptr<Struct> nullPtr(xPtr, NULL);
+        EXPECT_EQ(false, nullPtr);
+        EXPECT_EQ(2,     xPtr.use_count());
+        shared_ptr<Struct> copyPtr(nullPtr);
+        EXPECT_EQ(3,     xPtr.use_count());
+    }
+    EXPECT_EQ(0, Struct::_mNbInstances);
+}
+
+struct Handler : public enable_shared_from_this<Handler>
+{
+    explicit Handler(int aVal = 0) :
+        mVal(aVal)
+    {
+        ++_mNbInstances;
+    }
+    Handler(const Handler& aOther) :
+        enable_shared_from_this<Handler>(aOther),
+        mVal(aOther.mVal)
+    {
+        ++_mNbInstances;
+    }
+    ~Handler(void)
+    {
+        --_mNbInstances;
+    }
+
+    int         mVal;
+    static int _mNbInstances;
+};
+
+int Handler::_mNbInstances = 0;
+
+struct DerivedHandler : public Handler
+{
+};
+
+TEST(shared_ptr, enable_shared_from_this)
+{
+    {
+        // Constructor from a raw pointer
+        shared_ptr<Handler> xPtr(new Handler(1));
+        shared_ptr<Handler> yPtr = xPtr->shared_from_this();
+        EXPECT_EQ(xPtr, yPtr);
+        EXPECT_EQ(2, xPtr.use_count());
+        EXPECT_EQ(false, xPtr->weak_from_this().expired());
+        const Handler& constRef = *xPtr;
+        shared_ptr<const Handler> constPtr = constRef.shared_from_this();
+        EXPECT_EQ(3, xPtr.use_count());
+        EXPECT_EQ(xPtr.get(), constPtr.get());
+
+        // make_shared
+        shared_ptr<Handler> zPtr = make_shared<Handler>(2);
+        EXPECT_EQ(zPtr, zPtr->shared_from_this());
+        EXPECT_EQ(1, zPtr.use_count());
+
+        // reset and custom deleter
+        zPtr.reset(new Handler(3));
+        EXPECT_EQ(zPtr, zPtr->shared_from_this());
+        zPtr.reset(new Handler(4), std::default_delete<Handler>());
+        EXPECT_EQ(zPtr, zPtr->shared_from_this());
+        EXPECT_EQ(2, Handler::_mNbInstances);
+
+        // From a derived class, through a shared_ptr to the derived class
+        shared_ptr<DerivedHandler> dPtr(new DerivedHandler);
+        shared_ptr<Handler> bPtr = dPtr->shared_from_this();
+        EXPECT_EQ(dPtr, bPtr);
+        EXPECT_EQ(2, dPtr.use_count());
+
+        // A copy of the object is not owned by any shared_ptr
+        Handler copy(*xPtr);
+        EXPECT_EQ(true, copy.weak_from_this().expired());
+
+        // An owner of another policy than the default one is not observed
+        shared_ptr<Handler, multi_threaded> multiPtr(new Handler(5));
+#ifdef SHARED_PTR_THREAD_SAFE
+        EXPECT_EQ(false, multiPtr->weak_from_this().expired());
+#else
+        EXPECT_EQ(true, multiPtr->weak_from_this().expired());
+        EXPECT_EQ(false, multiPtr->weak_from_this().lock());
+#endif
+        EXPECT_EQ(1, multiPtr.use_count());
+        shared_ptr<Handler, single_threaded> singlePtr(new Handler(6));
+#ifdef SHARED_PTR_THREAD_SAFE
+        EXPECT_EQ(true, singlePtr->weak_from_this().expired());
+#else
+        EXPECT_EQ(singlePtr, singlePtr->shared_from_this());
+#endif
+    }
+    EXPECT_EQ(0, Handler::_mNbInstances);
+}
+
+TEST(shared_ptr, threading_policy)
+{
+    {
+        // Each shared_ptr can select the cost of its reference counting
+        shared_ptr<Struct, single_threaded> localPtr(new Struct(1));
+        shared_ptr<Struct, single_threaded> copyPtr(localPtr);
+        EXPECT_EQ(2, localPtr.use_count());
+
+        // Explicit conversion to publish the object to other threads, sharing the same control block
+        shared_ptr<Struct, multi_threaded> sharedPtr(localPtr);
+        EXPECT_EQ(3, localPtr.use_count());
+        EXPECT_EQ(localPtr, sharedPtr);
+        EXPECT_EQ(false, localPtr.owner_before(sharedPtr));
+        EXPECT_EQ(false, sharedPtr.owner_before(localPtr));
+
+        // and back to the default policy
+        shared_ptr<Struct> defaultPtr(sharedPtr);
+        EXPECT_EQ(4, defaultPtr.use_count());
+        shared_ptr<Struct, default_threading> samePtr = defaultPtr;
+        EXPECT_EQ(5, defaultPtr.use_count());
+        EXPECT_EQ(1, Struct::_mNbInstances);
+
+        // Casts keep the policy
+        shared_ptr<const Struct, single_threaded> constPtr = static_pointer_cast<const Struct>(localPtr);
+        EXPECT_EQ(6, localPtr.use_count());
+
+        // The object lives until the last pointer is released, whatever its policy
+        localPtr.reset();
+        copyPtr.reset();
+        constPtr.reset();
+        defaultPtr.reset();
+        samePtr.reset();
+        EXPECT_EQ(1, sharedPtr.use_count());
+        EXPECT_EQ(1, Struct::_mNbInstances);
+    }
+    EXPECT_EQ(0, Struct::_mNbInstances);
+
+    {
+        // An immortal pointer to a static object has no control block, and is never counted
+        Struct unowned(2);
+        shared_ptr<Struct, immortal> staticPtr(&unowned);
+        shared_ptr<Struct, immortal> copyPtr(staticPtr);
+        EXPECT_EQ(true, staticPtr);
+        EXPECT_EQ(0,    staticPtr.use_count());
+        EXPECT_EQ(2,    copyPtr->mVal);
+        copyPtr.reset();
+        EXPECT_EQ(1,    Struct::_mNbInstances);
+
+        // Converted to a counted pointer, it is an alias without owner
+        shared_ptr<Struct> countedPtr(staticPtr);
+        EXPECT_EQ(&unowned, countedPtr.get());
+        EXPECT_EQ(0,        countedPtr.use_count());
+
+        // A counted object converted to an immortal pointer is kept alive forever
+        shared_ptr<Struct> ownerPtr(new Struct(3));
+        static shared_ptr<Struct, immortal>* const pPinnedPtr = new shared_ptr<Struct, immortal>(ownerPtr); // never destroyed
+        EXPECT_EQ(2, ownerPtr.use_count());
+        shared_ptr<Struct, immortal> pinnedCopyPtr(*pPinnedPtr);
+        EXPECT_EQ(2, ownerPtr.use_count());
+        ownerPtr.reset();
+        EXPECT_EQ(1, pinnedCopyPtr.use_count());
+        EXPECT_EQ(3, pinnedCopyPtr->mVal);
+        EXPECT_EQ(2, Struct::_mNbInstances);
+    }
+    --Struct::_mNbInstances; // the pinned object is never deleted
+
+#ifdef SHARED_PTR_CPP11
+    // The conversions between policies are explicit
+    EXPECT_EQ(true,  (std::is_convertible<shared_ptr<Struct, multi_threaded>, shared_ptr<const Struct, multi_threaded> >::value));
+    EXPECT_EQ(false, (std::is_convertible<shared_ptr<Struct, single_threaded>, shared_ptr<Struct, multi_threaded> >::value));
+    EXPECT_EQ(false, (std::is_convertible<shared_ptr<Struct, multi_threaded>, shared_ptr<Struct, single_threaded> >::value));
+    EXPECT_EQ(false, (std::is_convertible<shared_ptr<Struct, multi_threaded>, shared_ptr<Struct, immortal> >::value));
+    EXPECT_EQ(true,  (std::is_constructible<shared_ptr<Struct, immortal>, shared_ptr<Struct, multi_threaded> >::value));
+
+    {
+        // A multi_threaded pointer can be copied concurrently, even without SHARED_PTR_THREAD_SAFE
+        shared_ptr<Struct, multi_threaded> sharedPtr(new Struct(4));
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i)
+        {
+            threads.push_back(std::thread([sharedPtr]()
+            {
+                for (int j = 0; j < 10000; ++j)
+                {
+                    shared_ptr<Struct, multi_threaded> copyPtr(sharedPtr);
+                }
+            }));
+        }
+        for (size_t i = 0; i < threads.size(); ++i)
+        {
+            threads[i].join();
+        }
+        EXPECT_EQ(1, sharedPtr.use_count());
+    }
+    EXPECT_EQ(0, Struct::_mNbInstances);
+#endif
+}
+
+#if SHARED_ASSERT_LEVEL >= 1
+TEST(shared_ptr, assert_handler)
+{
+    // The preconditions of the API call the handler, which aborts by default (even if NDEBUG is defined)
+    shared_ptr<Struct> xPtr;
+    EXPECT_DEATH(xPtr->incr(), "Assertion `NULL != px' failed");
+    xPtr.reset(new Struct(1));
+    EXPECT_DEATH(xPtr.reset(xPtr.get()), "auto-reset|px != p");
+}
+#endif
@@ -0,0 +1,136 @@
+/**
+ * @file  shared_ptr_thread_test.cpp
+ * @brief Multi-threaded Unit Test of the thread-safe reference counting of shared_ptr (SHARED_PTR_THREAD_SAFE).
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#ifndef SHARED_PTR_THREAD_SAFE
+#error "this test must be compiled with SHARED_PTR_THREAD_SAFE defined"
+#endif
+
+#include "shared_ptr.hpp"
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+struct Counted
+{
+    Counted(void)
+    {
+        ++_mNbInstances;
+    }
+    ~Counted(void)
+    {
+        --_mNbInstances;
+    }
+
+    static int _mNbInstances;
+};
+
+int Counted::_mNbInstances = 0;
+
+static const int    NB_THREADS  = 8;
+static const int    NB_COPIES   = 10000;
+
+// copy and drop the provided shared_ptr many times
+static void copy_and_drop(shared_ptr<Counted> aPtr)
+{
+    for (int i = 0; i < NB_COPIES; ++i)
+    {
+        shared_ptr<Counted> copyPtr(aPtr);
+        shared_ptr<Counted> assignedPtr;
+        assignedPtr = copyPtr;
+    }
+}
+
+TEST(shared_ptr_thread, concurrent_copies)
+{
+    shared_ptr<Counted> xPtr(new Counted);
+    EXPECT_EQ(1, Counted::_mNbInstances);
+
+    {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < NB_THREADS; ++i)
+        {
+            threads.push_back(std::thread(copy_and_drop, xPtr));
+        }
+        for (size_t i = 0; i < threads.size(); ++i)
+        {
+            threads[i].join();
+        }
+    }
+
+    // all the copies made by the threads have been released
+    EXPECT_EQ(true, xPtr.unique());
+    EXPECT_EQ(1,    Counted::_mNbInstances);
+}
+
+TEST(shared_ptr_thread, concurrent_last_release)
+{
+    for (int iter = 0; iter < 100; ++iter)
+    {
+        std::vector<std::thread> threads;
+        {
+            // each thread holds a copy: the last one to finish will destroy the object
+            shared_ptr<Counted> xPtr = make_shared<Counted>();
+            for (int i = 0; i < NB_THREADS; ++i)
+            {
+                threads.push_back(std::thread(copy_and_drop, xPtr));
+            }
+        }
+        for (size_t i = 0; i < threads.size(); ++i)
+        {
+            threads[i].join();
+        }
+#ifdef SHARED_PTR_BIASED
+        // the references of the owner thread released by the other threads are merged by the owner thread
+        biased_count::merge_queued();
+#endif
+        EXPECT_EQ(0, Counted::_mNbInstances);
+    }
+}
+
+// lock the provided weak_ptr many times, until the object disappears
+static void lock_and_drop(weak_ptr<Counted> aPtr)
+{
+    for (int i = 0; i < NB_COPIES; ++i)
+    {
+        shared_ptr<Counted> lockedPtr = aPtr.lock();
+        if (lockedPtr)
+        {
+            EXPECT_LT(0, Counted::_mNbInstances);
+        }
+    }
+}
+
+TEST(shared_ptr_thread, concurrent_weak_lock)
+{
+    for (int iter = 0; iter < 100; ++iter)
+    {
+        std::vector<std::thread> threads;
+        {
+            shared_ptr<Counted> xPtr = make_shared<Counted>();
+            weak_ptr<Counted> wPtr(xPtr);
+            for (int i = 0; i < NB_THREADS; ++i)
+            {
+                threads.push_back(std::thread(lock_and_drop, wPtr));
+            }
+            // race the release of the last shared_ptr against the locks of the threads
+        }
+        for (size_t i = 0; i < threads.size(); ++i)
+        {
+            threads[i].join();
+        }
+#ifdef SHARED_PTR_BIASED
+        // the references of the owner thread released by the other threads are merged by the owner thread
+        biased_count::merge_queued();
+#endif
+        EXPECT_EQ(0, Counted::_mNbInstances);
+    }
+}
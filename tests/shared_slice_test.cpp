@@ -0,0 +1,185 @@
+/**
+ * @file  shared_slice_test.cpp
+ * @brief Unit Test of the shared_slice of shared arrays using Google Test library.
+ *
+ * Copyright (c) 2013-2019 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include "shared_slice.hpp"
+
+#include <vector>
+#ifdef SHARED_PTR_CPP11
+#include <thread>
+#endif
+
+#include <gtest/gtest.h>
+
+struct Element
+{
+    Element(void) :
+        mVal(0)
+    {
+        ++_mNbInstances;
+    }
+    ~Element(void)
+    {
+        --_mNbInstances;
+    }
+
+    int         mVal;
+    static int _mNbInstances;
+};
+
+int Element::_mNbInstances = 0;
+
+
+TEST(shared_slice, empty_slice)
+{
+    shared_slice<int> slice;
+    EXPECT_EQ(false, slice);
+    EXPECT_EQ(true, slice.empty());
+    EXPECT_EQ(0u, slice.size());
+    EXPECT_EQ(0, slice.use_count());
+    EXPECT_EQ((int*)NULL, slice.data());
+    EXPECT_EQ(slice.begin(), slice.end());
+
+    slice.reset();
+    EXPECT_EQ(false, slice);
+}
+
+TEST(shared_slice, slice)
+{
+    {
+        shared_ptr<Element[]> array = make_shared<Element[]>(16);
+        for (int i = 0; i < 16; ++i)
+        {
+            array[i].mVal = i;
+        }
+
+        shared_slice<Element> whole(array, 16);
+        EXPECT_EQ(16u, whole.size());
+        EXPECT_EQ(array.get(), whole.data());
+        EXPECT_EQ(2, array.use_count());
+
+        // Each sub-slice shares the control block of the array: no allocation, and no copy of the elements
+        shared_slice<Element> header = whole.slice(0, 4);
+        shared_slice<Element> payload = whole.slice(4);
+        EXPECT_EQ(4, array.use_count());
+        EXPECT_EQ(4u, header.size());
+        EXPECT_EQ(12u, payload.size());
+        EXPECT_EQ(&array[4], payload.data());
+        EXPECT_EQ(4, payload[0].mVal);
+        EXPECT_EQ(15, payload[11].mVal);
+        EXPECT_EQ(payload.data() + 12, payload.end());
+
+        // A slice of a slice is relative to its first element
+        shared_slice<Element> record = payload.slice(2, 3);
+        EXPECT_EQ(6, record[0].mVal);
+        EXPECT_EQ(3u, record.size());
+        int sum = 0;
+        for (shared_slice<Element>::iterator it = record.begin(); it != record.end(); ++it)
+        {
+            sum += it->mVal;
+        }
+        EXPECT_EQ(6 + 7 + 8, sum);
+
+        // Elements are modified in place, seen by all the slices
+        record[1].mVal = 123;
+        EXPECT_EQ(123, whole[7].mVal);
+
+        // The slices can be narrowed in place
+        record.remove_prefix(1);
+        record.remove_suffix(1);
+        EXPECT_EQ(1u, record.size());
+        EXPECT_EQ(123, record[0].mVal);
+        EXPECT_EQ(5, array.use_count());
+
+        // The array outlives the shared_ptr and the slices, until the last of them is released
+        array.reset();
+        whole.reset();
+        header.reset();
+        payload.reset();
+        EXPECT_EQ(16, Element::_mNbInstances);
+        EXPECT_EQ(1, record.use_count());
+        EXPECT_EQ(123, record.get_shared()[0].mVal);
+    }
+    EXPECT_EQ(0, Element::_mNbInstances);
+}
+
+TEST(shared_slice, const_slice)
+{
+    shared_slice<int> slice(make_shared<int[]>(8), 8);
+    slice[3] = 3;
+
+    // A read-only view of the same elements
+    shared_slice<const int> view = slice.slice(2, 4);
+    EXPECT_EQ(3, view[1]);
+    EXPECT_EQ(2, slice.use_count());
+    shared_slice<const int> copy = slice;
+    EXPECT_EQ(3, slice.use_count());
+    EXPECT_EQ(slice.data(), copy.data());
+
+    view.swap(copy);
+    EXPECT_EQ(8u, view.size());
+    EXPECT_EQ(4u, copy.size());
+}
+
+TEST(shared_slice, shared_buffer)
+{
+    // The frame is copied once into a buffer, allocated with its reference counter
+    const char frame[] = "HEADpayload";
+    shared_buffer buffer = make_shared_buffer(frame, sizeof(frame) - 1);
+    EXPECT_EQ(11u, buffer.size());
+    EXPECT_EQ(1, buffer.use_count());
+    EXPECT_EQ('H', buffer[0]);
+
+    // then parsed into records pointing into it
+    shared_buffer header = buffer.slice(0, 4);
+    shared_buffer payload = buffer.slice(4);
+    EXPECT_EQ(0, memcmp("HEAD", header.data(), header.size()));
+    EXPECT_EQ(0, memcmp("payload", payload.data(), payload.size()));
+    EXPECT_EQ(3, buffer.use_count());
+
+    shared_buffer zeros = make_shared_buffer(4);
+    EXPECT_EQ(0, zeros[0] + zeros[1] + zeros[2] + zeros[3]);
+}
+
+#ifdef SHARED_PTR_CPP11
+TEST(shared_slice, threads)
+{
+    {
+        typedef shared_slice<Element, multi_threaded> slice_type;
+        slice_type whole(slice_type::array_ptr(make_shared<Element[]>(64)), 64);
+
+        // The slices are handed to other threads without copying the elements
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+        {
+            slice_type quarter = whole.slice(static_cast<std::size_t>(t) * 16, 16);
+            threads.push_back(std::thread([quarter, t]()
+            {
+                for (int i = 0; i < 1000; ++i)
+                {
+                    slice_type record = quarter.slice(static_cast<std::size_t>(i % 16), 1);
+                    record[0].mVal += t;
+                }
+            }));
+        }
+        for (size_t i = 0; i < threads.size(); ++i)
+        {
+            threads[i].join();
+        }
+        EXPECT_EQ(1, whole.use_count());
+        int sum = 0;
+        for (slice_type::iterator it = whole.begin(); it != whole.end(); ++it)
+        {
+            sum += it->mVal;
+        }
+        EXPECT_EQ((0 + 1 + 2 + 3) * 1000, sum);
+    }
+    EXPECT_EQ(0, Element::_mNbInstances);
+}
+#endif
@@ -9,14 +9,21 @@
  */
 
 #include "unique_ptr.hpp"
+#include "shared_ptr.hpp" // ptr_less, ptr_hash
 
 #include <vector>
+#include <set>
+#ifdef SHARED_PTR_CPP11
+#include <type_traits>
+#include <unordered_set>
+using std::move;
+#endif
 
 #include <gtest/gtest.h>
 
 struct Struct2
 {
-    explicit Struct2(int aVal) :
+    explicit Struct2(int aVal = 0) :
         mVal(aVal)
     {
         ++_mNbInstances;
@@ -63,16 +70,16 @@ TEST(unique_ptr, empty_ptr)
 
     // sub-scope
     {
-        // Copy construct the empty (ie. NULL) unique_ptr
-        unique_ptr<Struct2> yPtr(xPtr);
+        // Move construct the empty (ie. NULL) unique_ptr
+        unique_ptr<Struct2> yPtr(move(xPtr));
 
         EXPECT_EQ(false, xPtr);
         EXPECT_EQ((void*)NULL,  xPtr.get());
         EXPECT_EQ((void*)NULL,  yPtr.get());
 
-        // Assign the empty (ie. NULL) unique_ptr
+        // Move assign the empty (ie. NULL) unique_ptr
         unique_ptr<Struct2> zPtr;
-        zPtr = xPtr;
+        zPtr = move(xPtr);
 
         EXPECT_EQ(false, xPtr);
         EXPECT_EQ((void*)NULL,  xPtr.get());
@@ -107,8 +114,8 @@ TEST(unique_ptr, basic_ptr)
             xPtr->decr();
             xPtr->decr();
 
-            // Copy construct the unique_ptr, transferring ownership
-            unique_ptr<Struct2> yPtr(xPtr);
+            // Move construct the unique_ptr, transferring ownership
+            unique_ptr<Struct2> yPtr(move(xPtr));
 
             EXPECT_NE(xPtr,  yPtr);
             EXPECT_EQ(false, xPtr);
@@ -121,8 +128,8 @@ TEST(unique_ptr, basic_ptr)
             if (yPtr)
             {
                 unique_ptr<Struct2> zPtr;
-                // Assign the unique_ptr, transferring ownership
-                zPtr = yPtr;
+                // Move assign the unique_ptr, transferring ownership
+                zPtr = move(yPtr);
 
                 EXPECT_NE(yPtr,  zPtr);
                 EXPECT_EQ(false, yPtr);
@@ -175,8 +182,8 @@ TEST(unique_ptr, reset_ptr)
     EXPECT_EQ(1,    Struct2::_mNbInstances);
     EXPECT_NE(pX,   xPtr.get());
 
-    // Copy-construct a new unique_ptr to the same object, transferring ownership
-    unique_ptr<Struct2> yPtr(xPtr);
+    // Move-construct a new unique_ptr to the same object, transferring ownership
+    unique_ptr<Struct2> yPtr(move(xPtr));
 
     EXPECT_NE(xPtr,  yPtr);
     EXPECT_EQ(false,  xPtr);
@@ -301,3 +308,265 @@ TEST(unique_ptr, std_container)
     EXPECT_EQ(0, Struct2::_mNbInstances);
 }
 
+
+TEST(unique_ptr, ptr_less)
+{
+    {
+        std::set<unique_ptr<Struct2>, ptr_less> set;
+        Struct2* pX = new Struct2(123);
+        set.insert(unique_ptr<Struct2>(pX));
+        set.insert(unique_ptr<Struct2>(new Struct2(234)));
+        EXPECT_EQ(2u, set.size());
+        EXPECT_EQ(true, ptr_less()(*set.begin(), get_pointer(*set.rbegin())));
+        EXPECT_EQ(true, ptr_equal()(pX, pX));
+#if (__cplusplus >= 201402L)
+        // Heterogeneous lookup by raw pointer, without building a temporary unique_ptr (which would delete the object)
+        EXPECT_EQ(pX, set.find(pX)->get());
+        EXPECT_EQ(1u, set.count(pX));
+#endif
+    }
+    EXPECT_EQ(0, Struct2::_mNbInstances);
+}
+
+#ifdef SHARED_PTR_CPP11
+TEST(unique_ptr, hash)
+{
+    {
+        unique_ptr<Struct2> xPtr(new Struct2(123));
+        Struct2* pX = xPtr.get();
+
+        // std::hash of a unique_ptr is the one of its raw pointer, like ptr_hash
+        EXPECT_EQ(std::hash<Struct2*>()(pX), std::hash<unique_ptr<Struct2> >()(xPtr));
+        EXPECT_EQ(ptr_hash()(pX), ptr_hash()(xPtr));
+
+        std::unordered_set<unique_ptr<Struct2> > set;
+        set.insert(move(xPtr));
+        set.insert(unique_ptr<Struct2>(new Struct2(234)));
+        EXPECT_EQ(2u, set.size());
+        EXPECT_EQ(2, Struct2::_mNbInstances);
+    }
+    EXPECT_EQ(0, Struct2::_mNbInstances);
+}
+#endif
+
+// stateless deleter counting the objects given back to a "pool"
+struct PoolDeleter
+{
+    void operator()(Struct2* p) const
+    {
+        ++_mNbReleases;
+        delete p;
+    }
+    static int _mNbReleases;
+};
+int PoolDeleter::_mNbReleases = 0;
+
+// stateful deleter, counting the objects it releases
+struct CountingDeleter
+{
+    explicit CountingDeleter(int* apNbReleases = NULL) :
+        mpNbReleases(apNbReleases)
+    {
+    }
+    void operator()(Struct2* p) const
+    {
+        ++(*mpNbReleases);
+        delete p;
+    }
+    int* mpNbReleases;
+};
+
+static void releaseStruct2(Struct2* p)
+{
+    ++PoolDeleter::_mNbReleases;
+    delete p;
+}
+
+TEST(unique_ptr, deleter)
+{
+    // A stateless deleter takes no space
+    EXPECT_EQ(sizeof(Struct2*), sizeof(unique_ptr<Struct2>));
+    EXPECT_EQ(sizeof(Struct2*), sizeof(unique_ptr<Struct2, PoolDeleter>));
+
+    {
+        unique_ptr<Struct2, PoolDeleter> xPtr(new Struct2(123));
+        EXPECT_EQ(123, xPtr->mVal);
+
+        // The deleter is not called for an empty pointer
+        unique_ptr<Struct2, PoolDeleter> yPtr;
+        yPtr.reset();
+        EXPECT_EQ(0, PoolDeleter::_mNbReleases);
+
+        // Reset calls the deleter
+        xPtr.reset(new Struct2(234));
+        EXPECT_EQ(1, PoolDeleter::_mNbReleases);
+        EXPECT_EQ(1, Struct2::_mNbInstances);
+    }
+    EXPECT_EQ(2, PoolDeleter::_mNbReleases);
+    EXPECT_EQ(0, Struct2::_mNbInstances);
+
+    {
+        // A function pointer deleter
+        unique_ptr<Struct2, void(*)(Struct2*)> xPtr(new Struct2(123), releaseStruct2);
+        EXPECT_EQ(&releaseStruct2, xPtr.get_deleter());
+    }
+    EXPECT_EQ(3, PoolDeleter::_mNbReleases);
+    EXPECT_EQ(0, Struct2::_mNbInstances);
+
+    {
+        // A stateful deleter is transferred with the ownership
+        int nbReleases = 0;
+        unique_ptr<Struct2, CountingDeleter> xPtr(new Struct2(123), CountingDeleter(&nbReleases));
+        unique_ptr<Struct2, CountingDeleter> yPtr(move(xPtr));
+        EXPECT_EQ(false, xPtr);
+        EXPECT_EQ(&nbReleases, yPtr.get_deleter().mpNbReleases);
+
+        // Swap exchanges the deleters
+        int nbOtherReleases = 0;
+        unique_ptr<Struct2, CountingDeleter> zPtr(new Struct2(234), CountingDeleter(&nbOtherReleases));
+        yPtr.swap(zPtr);
+        EXPECT_EQ(234, yPtr->mVal);
+        yPtr.reset();
+        EXPECT_EQ(0, nbReleases);
+        EXPECT_EQ(1, nbOtherReleases);
+        zPtr.reset();
+        EXPECT_EQ(1, nbReleases);
+    }
+    EXPECT_EQ(0, Struct2::_mNbInstances);
+}
+
+#ifdef SHARED_PTR_CPP11
+TEST(unique_ptr, move_ptr)
+{
+    // A real move-only type, that the standard containers can move safely
+    EXPECT_EQ(false, std::is_copy_constructible<unique_ptr<Struct2> >::value);
+    EXPECT_EQ(false, std::is_copy_assignable<unique_ptr<Struct2> >::value);
+    EXPECT_EQ(true,  std::is_nothrow_move_constructible<unique_ptr<Struct2> >::value);
+    EXPECT_EQ(true,  std::is_nothrow_move_assignable<unique_ptr<Struct2> >::value);
+
+    {
+        std::vector<unique_ptr<Struct2> > PtrList;
+        for (int i = 0; i < 100; ++i)
+        {
+            // the reallocations of the vector move the pointers
+            PtrList.push_back(unique_ptr<Struct2>(new Struct2(i)));
+        }
+        EXPECT_EQ(100, Struct2::_mNbInstances);
+        for (int i = 0; i < 100; ++i)
+        {
+            EXPECT_EQ(i, PtrList[static_cast<size_t>(i)]->mVal);
+        }
+
+        // Move assign from a temporary, destroying the previous object
+        PtrList.front() = unique_ptr<Struct2>(new Struct2(-1));
+        EXPECT_EQ(-1,  PtrList.front()->mVal);
+        EXPECT_EQ(100, Struct2::_mNbInstances);
+
+        // Self move assignment keeps the object
+        unique_ptr<Struct2>& frontPtr = PtrList.front();
+        frontPtr = move(frontPtr);
+        EXPECT_EQ(-1,  PtrList.front()->mVal);
+
+        // release() gives back the ownership
+        Struct2* pX = PtrList.back().release();
+        EXPECT_EQ(false, PtrList.back());
+        EXPECT_EQ(99,    pX->mVal);
+        delete pX;
+    }
+    EXPECT_EQ(0, Struct2::_mNbInstances);
+}
+
+struct Base2
+{
+    virtual ~Base2(void)
+    {
+    }
+};
+
+struct Derived3 : public Base2
+{
+    Derived3(void)
+    {
+        ++_mNbInstances;
+    }
+    virtual ~Derived3(void)
+    {
+        --_mNbInstances;
+    }
+    static int _mNbInstances;
+};
+
+int Derived3::_mNbInstances = 0;
+
+TEST(unique_ptr, move_derived_to_base)
+{
+    {
+        // Move a unique_ptr<Derived> to a unique_ptr<Base>, converting the default deleter
+        unique_ptr<Base2> basePtr(move(unique_ptr<Derived3>(new Derived3)));
+        EXPECT_EQ(true, basePtr);
+        EXPECT_EQ(1, Derived3::_mNbInstances);
+
+        unique_ptr<Derived3> derivedPtr(new Derived3);
+        Derived3* pDerived = derivedPtr.get();
+        basePtr = unique_ptr<Base2>(move(derivedPtr));
+        EXPECT_EQ(false, derivedPtr);
+        EXPECT_EQ(pDerived, basePtr.get());
+        EXPECT_EQ(1, Derived3::_mNbInstances);
+
+        // Adding a const qualifier is a conversion as well
+        unique_ptr<const Struct2> constPtr(unique_ptr<Struct2>(new Struct2(3)));
+        EXPECT_EQ(3, constPtr->mVal);
+    }
+    EXPECT_EQ(0, Derived3::_mNbInstances);
+    EXPECT_EQ(0, Struct2::_mNbInstances);
+
+    // No conversion between unrelated types, nor between an array and an object
+    EXPECT_EQ(true,  (std::is_constructible<unique_ptr<Base2>, unique_ptr<Derived3>&&>::value));
+    EXPECT_EQ(false, (std::is_constructible<unique_ptr<Derived3>, unique_ptr<Base2>&&>::value));
+    EXPECT_EQ(false, (std::is_constructible<unique_ptr<Base2>, unique_ptr<Derived3[]>&&>::value));
+    EXPECT_EQ(false, (std::is_constructible<unique_ptr<Base2[]>, unique_ptr<Derived3[]>&&>::value));
+    EXPECT_EQ(false, (std::is_constructible<unique_ptr<Base2[]>, unique_ptr<Derived3>&&>::value));
+    EXPECT_EQ(true,  (std::is_constructible<unique_ptr<const Base2[]>, unique_ptr<Base2[]>&&>::value));
+}
+
+TEST(unique_ptr, nullptr)
+{
+    // Construct, assign and compare with nullptr
+    unique_ptr<Struct2> xPtr(nullptr);
+    EXPECT_EQ(true,  xPtr == nullptr);
+    EXPECT_EQ(false, nullptr != xPtr);
+    xPtr.reset(new Struct2(123));
+    EXPECT_EQ(true,  xPtr != nullptr);
+    EXPECT_EQ(false, nullptr == xPtr);
+    xPtr = nullptr;
+    EXPECT_EQ(false, xPtr);
+    EXPECT_EQ(0,     Struct2::_mNbInstances);
+
+    // The non-throwing operations are noexcept
+    EXPECT_EQ(true, noexcept(unique_ptr<Struct2>()));
+    EXPECT_EQ(true, noexcept(xPtr.reset()));
+    EXPECT_EQ(true, noexcept(static_cast<bool>(xPtr)));
+    EXPECT_EQ(true, noexcept(xPtr.get()));
+}
+#endif
+
+TEST(unique_ptr, array)
+{
+    {
+        // Manage an array allocated with new[]
+        unique_ptr<Struct2[]> xPtr(new Struct2[3]);
+
+        EXPECT_EQ(true, xPtr);
+        EXPECT_EQ(3, Struct2::_mNbInstances);
+        xPtr[2].incr();
+        EXPECT_EQ(1, xPtr.get()[2].mVal);
+
+        // Transfer it, and reset with another array: the first one is deleted with delete[]
+        unique_ptr<Struct2[]> yPtr = move(xPtr);
+        EXPECT_EQ(false, xPtr);
+        EXPECT_EQ(1, yPtr[2].mVal);
+        yPtr.reset(new Struct2[2]);
+        EXPECT_EQ(2, Struct2::_mNbInstances);
+    }
+    EXPECT_EQ(0, Struct2::_mNbInstances);
+}